@@ -0,0 +1,346 @@
+/* add_noise.c                                          jlong@jimlong.org
+ *
+ * add simple noise to synthetic microarray data, a time series from COPASI
+ * or from nemo2sbml -S; a native, streaming version of add_noise.r, with the
+ * same output: for each data row the values of every column but the first
+ * (time), each with noise added and followed by a space.
+ *
+ * The noise on a value x is drawn from a normal distribution with mean 0 and
+ * standard deviation 0.1*x, clamped so it changes x by no more than CLAMP*x.
+ * Like add_noise.r, a draw beyond the clamp is scaled by the smallest power
+ * of 0.95 that brings it inside, but the power is computed, not looped for.
+ * Each draw is keyed on the seed, row and column, so the output does not
+ * depend on the number of threads.
+ *
+ * compile: gcc -O2 -o add_noise add_noise.c -lm -lpthread
+ *
+ * usage ./add_noise [options] [<input file>] > <output file>
+ *                   -c <clamp> max change, as a fraction of the value, default 0.25
+ *                   -h --help
+ *                   -j <threads> add the noise to the columns on this many threads, default 1
+ *                   -s <seedval> set the seed, default 123456789
+ *                   -v print version
+ *
+ * The input (stdin if no file is given) has commented-out header lines,
+ * starting with #, followed by whitespace separated data, first column time.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BLOCK   (1<<20) /* values read before the noise is added, about */
+#define CLAMP    0.25
+#define VERSION "1.0"
+
+typedef struct
+{
+  char   *buf;     /* a thread's formatted columns, all rows of the block */
+  size_t  len, sz;
+  size_t *off;     /* row r is buf[off[r]] .. buf[off[r+1]-1] */
+  int     c0, c1;  /* its columns */
+} SEGMENT;
+
+double gauss(long, int);
+double noise(long, int, double);
+void add_noise(int);
+void * worker(void *);
+
+int done=0, ncols=0, nrows, numThreads=1, rowsSz;
+long row0=0, seedval=123456789;
+double clamp=CLAMP, *block;
+SEGMENT *seg;
+pthread_barrier_t start, finish;
+
+int main(int argc, char **argv)
+{
+  char *line=0x0, *p, *q;
+  int c, i, option, r, t;
+  long row;
+  size_t lineSz=0;
+  FILE *in = stdin;
+  pthread_t *tid;
+
+  /* options parsing */
+  while((option = getopt(argc, argv, "c:j:s:hv")) > 0)
+  {
+    switch(option)
+    {
+      case 'c':
+        clamp = strtod(optarg, &p);
+        if(*p || clamp < 0.0)
+        {
+          fprintf(stderr, "add_noise: -c: \"%s\" must be a number >= 0, returning...\n", optarg);
+          return 1;
+        }
+        break;
+
+      case 'h':
+        printf("add clamped normal noise to a time series, writing every column but time\n");
+        printf("usage: add_noise [options] [<input file>] > <output file>\n");
+        printf("                 -c <clamp> max change, as a fraction of the value, default %g\n", CLAMP);
+        printf("                 -h --help\n");
+        printf("                 -j <threads> add the noise to the columns on this many threads, default 1\n");
+        printf("                 -s <seedval> set the seed, default 123456789\n");
+        printf("                 -v print version\n");
+        return 0;
+
+      case 'j':
+        numThreads = atoi(optarg);
+        for(i=0; i<strlen(optarg); i++)
+          if(!isdigit(optarg[i]))
+            numThreads = 0;
+        if(numThreads < 1)
+        {
+          fprintf(stderr, "add_noise: -j: \"%s\" must be an integer argument > 0, returning...\n", optarg);
+          return 1;
+        }
+        break;
+
+      case 's':
+        for(i=0; i<strlen(optarg); i++)
+          if(!isdigit(optarg[i]))
+          {
+            fprintf(stderr, "add_noise: the \"seedval\" argument (%s) must be a number, returning...\n", optarg);
+            return 1;
+          }
+        seedval = atol(optarg);
+        break;
+
+      case 'v':
+        printf("ver %s\n", VERSION);
+        return 0;
+
+      default:
+        break;
+    }
+  }
+
+  if(argv[optind] != NULL && (in = fopen(argv[optind], "r")) == NULL)
+  {
+    fprintf(stderr, "add_noise: unable to open input file %s...\n", argv[optind]);
+    return 1;
+  }
+
+  seg = (SEGMENT *) calloc(numThreads, sizeof(SEGMENT));
+  tid = (pthread_t *) malloc(numThreads*sizeof(pthread_t));
+  if(!seg || !tid)
+  {
+    fprintf(stderr, "add_noise: malloc error, returning...\n");
+    return 1;
+  }
+
+  /* read a block of rows, add the noise on all threads, write it */
+  nrows = 0;
+  for(row=1; ; row++)
+  {
+    if(getline(&line, &lineSz, in) < 0)
+      c = -1;
+    else
+    {
+      for(p=line; isspace(*p); p++) ;
+      if(*p == '#' || *p == 0x0)
+        continue;
+
+      /* the columns, counted on the first data row */
+      if(ncols == 0)
+      {
+        for(q=p; *q; )
+        {
+          while(isspace(*q)) q++;
+          if(*q == 0x0) break;
+          ncols++;
+          while(*q && !isspace(*q)) q++;
+        }
+
+        rowsSz = BLOCK/ncols + 1;
+        block = (double *) malloc(rowsSz*ncols*sizeof(double));
+        if(!block)
+        {
+          fprintf(stderr, "add_noise: malloc error, returning...\n");
+          return 1;
+        }
+
+        for(t=0; t<numThreads; t++)
+        {
+          seg[t].c0  = 1 + (long)(ncols-1)*t/numThreads;
+          seg[t].c1  = 1 + (long)(ncols-1)*(t+1)/numThreads;
+          seg[t].sz  = 16*rowsSz*(seg[t].c1 - seg[t].c0) + 1;
+          seg[t].buf = (char *) malloc(seg[t].sz);
+          seg[t].off = (size_t *) malloc((rowsSz+1)*sizeof(size_t));
+          if(!seg[t].buf || !seg[t].off)
+          {
+            fprintf(stderr, "add_noise: malloc error, returning...\n");
+            return 1;
+          }
+        }
+
+        pthread_barrier_init(&start, NULL, numThreads);
+        pthread_barrier_init(&finish, NULL, numThreads);
+        for(t=1; t<numThreads; t++)
+          if(pthread_create(&tid[t], NULL, worker, (void *)(long)t))
+          {
+            fprintf(stderr, "add_noise: can't create thread %d, returning...\n", t);
+            return 1;
+          }
+      }
+
+      for(c=0; c<ncols; c++)
+      {
+        block[nrows*ncols + c] = strtod(p, &q);
+        if(q == p)
+          break;
+        p = q;
+      }
+      while(isspace(*p)) p++;
+      if(c < ncols || *p)
+      {
+        fprintf(stderr, "add_noise: line %ld doesn't have %d numbers, returning...\n", row, ncols);
+        return 1;
+      }
+      nrows++;
+    }
+
+    if(nrows == rowsSz || (c < 0 && nrows > 0))
+    {
+      if(numThreads > 1)
+        pthread_barrier_wait(&start);
+      add_noise(0);
+      if(numThreads > 1)
+        pthread_barrier_wait(&finish);
+
+      for(r=0; r<nrows; r++)
+      {
+        for(t=0; t<numThreads; t++)
+          fwrite(seg[t].buf + seg[t].off[r], 1, seg[t].off[r+1] - seg[t].off[r], stdout);
+        putchar('\n');
+      }
+      row0 += nrows;
+      nrows = 0;
+    }
+
+    if(c < 0)
+      break;
+  }
+
+  if(ncols && numThreads > 1)
+  {
+    done = 1;
+    pthread_barrier_wait(&start);
+    for(t=1; t<numThreads; t++)
+      pthread_join(tid[t], NULL);
+  }
+
+  if(fflush(stdout) || ferror(stdout))
+  {
+    fprintf(stderr, "add_noise: write error, returning...\n");
+    return 1;
+  }
+  return 0;
+}
+
+/* thread t's share of each block, see main() */
+void * worker(void *arg)
+{
+  int t = (int)(long) arg;
+
+  for(;;)
+  {
+    pthread_barrier_wait(&start);
+    if(done)
+      return NULL;
+    add_noise(t);
+    pthread_barrier_wait(&finish);
+  }
+}
+
+/* add the noise to thread t's columns of the block, formatted as add_noise.r's cat() did */
+void add_noise(int t)
+{
+  int c, r;
+  double v;
+  SEGMENT *s = &seg[t];
+  char *tmp;
+
+  s->len = 0;
+  for(r=0; r<nrows; r++)
+  {
+    s->off[r] = s->len;
+    for(c=s->c0; c<s->c1; c++)
+    {
+      if(s->len + 32 > s->sz)
+      {
+        tmp = (char *) realloc(s->buf, 2*s->sz);
+        if(!tmp)
+        {
+          fprintf(stderr, "add_noise: malloc error, exiting...\n");
+          exit(1);
+        }
+        s->buf = tmp;
+        s->sz *= 2;
+      }
+      v = block[r*ncols + c];
+      s->len += sprintf(s->buf + s->len, "%.7g ", v + noise(row0 + r, c, v));
+    }
+  }
+  s->off[nrows] = s->len;
+}
+
+/*
+ Standard normal number for the value in row, col: Box-Muller from two
+ uniform numbers hashed from (seed, row, col) with the splitmix64 finalizer,
+ as nemo2sbml keys its parameters.
+*/
+double gauss(long row, int col)
+{
+  int i, k;
+  unsigned long long key[2], x;
+  double u[2];
+
+  key[0] = (unsigned long long)row;
+  key[1] = (unsigned long long)col;
+  for(k=0; k<2; k++)
+  {
+    x = (unsigned long long)seedval;
+    for(i=0; i<2; i++)
+    {
+      x ^= key[i] << 1 | k;
+      x += 0x9e3779b97f4a7c15ULL;
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+      x ^= x >> 31;
+    }
+    u[k] = (x >> 11) * (1.0/9007199254740992.0); /* top 53 bits */
+  }
+
+  return sqrt(-2.0*log(1.0 - u[0])) * cos(2.0*M_PI*u[1]);
+}
+
+/* the noise for value v in row, col; none for v <= 0, as rnorm() with sd 0 */
+double noise(long row, int col, double v)
+{
+  double lim, z;
+
+  if(!(v > 0.0))
+    return 0.0;
+
+  z   = 0.1*v*gauss(row, col);
+  lim = clamp*v;
+  if(fabs(z) > lim)
+  {
+    /* the k add_noise.r's loop of z *= 0.95 stopped at */
+    z *= pow(0.95, ceil(log(lim/fabs(z))/log(0.95)));
+    if(fabs(z) > lim) /* rounding */
+      z *= 0.95;
+  }
+  return z;
+}
@@ -0,0 +1,336 @@
+/* cache.c
+ *
+ * The content-addressed output cache of nemo2sbml, -C <dir>; see cache.h.
+ *
+ * The key of a run is its input, with each run of white space made a single
+ * space, and a line of the settings that change what is written (version,
+ * seed, output prefix and options). An entry is the directory
+ * <dir>/out_<hash>, with <hash> the 64 bit FNV-1a hash of the key; it holds
+ * the key itself, so that a collision is never taken for a hit, a manifest of
+ * the paths the run wrote, and the files, named 0, 1, ... in manifest order.
+ * Entries are built under a temporary name and renamed into place, so a run
+ * never sees half of one. <dir>/stats counts the hits and misses of all runs.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "cache.h"
+
+#define BUFSZ 256
+
+static int put_file(const char *, const char *);
+static int key_matches(const char *);
+static int write_key(const char *);
+
+/* the run being cached, process-wide: only nemo2sbml -C has one, see nemo.h */
+static char *cacheDir, *norm, *settings, entry[2*BUFSZ];
+static size_t normLen;
+static char **notes;
+static int numNotes=0, notesSz=0;
+
+/* all of in, NUL terminated, or NULL on a read or malloc error */
+char * oc_read(FILE *in, size_t *len)
+{
+  char *s, *t;
+  size_t n, sz=65536;
+
+  s = (char *) malloc(sz);
+  if(!s)
+    return NULL;
+
+  *len = 0;
+  while((n = fread(s + *len, 1, sz-1 - *len, in)) > 0)
+  {
+    *len += n;
+    if(*len == sz-1)
+    {
+      t = (char *) realloc(s, 2*sz);
+      if(!t)
+      {
+        free(s);
+        return NULL;
+      }
+      s = t;
+      sz *= 2;
+    }
+  }
+
+  if(ferror(in))
+  {
+    free(s);
+    return NULL;
+  }
+  s[*len] = 0x0;
+  return s;
+}
+
+/*
+ Look up the run of text[0..len-1] with these settings in dir. On a hit the
+ files of the entry are put in place and 1 is returned; on a miss, 0, and
+ the outputs of the run are to be given to oc_note() as they are written, and
+ the entry made by oc_store() when it is done.
+*/
+int oc_lookup(const char *dir, const char *text, size_t len, const char *set)
+{
+  int i, n;
+  char *line=0x0, path[3*BUFSZ];
+  unsigned long long hash = 14695981039346656037ULL;
+  size_t j, lineSz=0;
+  FILE *fp;
+
+  cacheDir = (char *) dir;
+  settings = (char *) set;
+
+  norm = (char *) malloc(len+1);
+  if(norm == NULL)
+  {
+    fprintf(stderr, "oc_lookup: malloc error, not using the cache...\n");
+    cacheDir = 0x0;
+    return 0;
+  }
+  for(j=normLen=0; j<len; j++)
+  {
+    if(isspace((unsigned char)text[j]))
+    {
+      while(j+1 < len && isspace((unsigned char)text[j+1])) j++;
+      if(normLen == 0 || j+1 == len)
+        continue;
+      norm[normLen++] = ' ';
+    }
+    else
+      norm[normLen++] = text[j];
+  }
+  norm[normLen] = 0x0;
+
+  for(j=0; settings[j]; j++)
+    hash = (hash ^ (unsigned char)settings[j]) * 1099511628211ULL;
+  for(j=0; j<normLen; j++)
+    hash = (hash ^ (unsigned char)norm[j]) * 1099511628211ULL;
+  snprintf(entry, sizeof(entry), "%s/out_%016llx", dir, hash);
+
+  sprintf(path, "%s/key", entry);
+  if(!key_matches(path))
+    return 0;
+
+  sprintf(path, "%s/manifest", entry);
+  if(!(fp = fopen(path, "r")))
+    return 0;
+
+  for(n=0; getline(&line, &lineSz, fp) > 0; n++)
+  {
+    line[strcspn(line, "\n")] = 0x0;
+    sprintf(path, "%s/%d", entry, n);
+    if(!put_file(path, line))
+    {
+      fprintf(stderr, "oc_lookup: unable to restore %s from %s, compiling...\n", line, entry);
+      break;
+    }
+    printf("document restored from cache: %s\n", line);
+  }
+  i = !ferror(fp) && feof(fp);
+  fclose(fp);
+  free(line);
+  return i;
+}
+
+/* a file the run wrote, to go in its entry */
+void oc_note(const char *path)
+{
+  char **t;
+
+  if(!cacheDir)
+    return;
+
+  if(numNotes == notesSz)
+  {
+    t = (char **) realloc(notes, (notesSz+BUFSZ)*sizeof(char *));
+    if(!t)
+    {
+      fprintf(stderr, "oc_note: realloc error, not caching this run...\n");
+      cacheDir = 0x0;
+      return;
+    }
+    notes = t;
+    notesSz += BUFSZ;
+  }
+  if(!(notes[numNotes] = strdup(path)))
+  {
+    fprintf(stderr, "oc_note: malloc error, not caching this run...\n");
+    cacheDir = 0x0;
+    return;
+  }
+  numNotes++;
+}
+
+/* make the entry of this run from the files noted, return 0 on failure */
+int oc_store(void)
+{
+  int i, ok=1;
+  char path[3*BUFSZ], tmp[2*BUFSZ+32];
+  FILE *fp;
+
+  if(!cacheDir)
+    return 0;
+
+  sprintf(tmp, "%s.%ld.tmp", entry, (long) getpid());
+  if(mkdir(tmp, 0777))
+  {
+    fprintf(stderr, "oc_store: unable to make %s (%s), not caching this run...\n", tmp, strerror(errno));
+    return 0;
+  }
+
+  sprintf(path, "%s/key", tmp);
+  ok = write_key(path);
+
+  sprintf(path, "%s/manifest", tmp);
+  if(ok && (fp = fopen(path, "w")))
+  {
+    for(i=0; i<numNotes; i++)
+      fprintf(fp, "%s\n", notes[i]);
+    ok = !fclose(fp);
+  }
+  else
+    ok = 0;
+
+  for(i=0; ok && i<numNotes; i++)
+  {
+    sprintf(path, "%s/%d", tmp, i);
+    ok = put_file(notes[i], path);
+  }
+
+  /* another run may have made the entry first, which is as good */
+  if(!ok || rename(tmp, entry))
+  {
+    if(!ok)
+      fprintf(stderr, "oc_store: unable to fill %s, not caching this run...\n", tmp);
+    for(i=0; i<numNotes; i++)
+    {
+      sprintf(path, "%s/%d", tmp, i);
+      unlink(path);
+    }
+    sprintf(path, "%s/key", tmp);
+    unlink(path);
+    sprintf(path, "%s/manifest", tmp);
+    unlink(path);
+    rmdir(tmp);
+  }
+  return ok;
+}
+
+/* count a hit or a miss in <dir>/stats, and report the counts so far */
+void oc_stats(int hit)
+{
+  long hits=0, misses=0;
+  char path[2*BUFSZ];
+  FILE *fp;
+
+  if(!cacheDir)
+    return;
+
+  snprintf(path, sizeof(path), "%s/stats", cacheDir);
+  if(!(fp = fopen(path, "a+")))
+    return;
+
+  flock(fileno(fp), LOCK_EX);
+  rewind(fp);
+  if(fscanf(fp, "hits %ld misses %ld", &hits, &misses) != 2)
+    hits = misses = 0;
+  if(hit)
+    hits++;
+  else
+    misses++;
+
+  /* a+ only appends, so empty the file through its name, still under the lock */
+  if(truncate(path, 0) == 0)
+  {
+    fseek(fp, 0, SEEK_END);
+    fprintf(fp, "hits %ld misses %ld\n", hits, misses);
+    fflush(fp);
+  }
+  flock(fileno(fp), LOCK_UN);
+  fclose(fp);
+
+  printf("output cache %s: %s, %ld hits, %ld misses in all\n", cacheDir, hit ? "hit" : "miss", hits, misses);
+}
+
+/* is the key in path this run's? */
+static int key_matches(const char *path)
+{
+  int c;
+  size_t j;
+  FILE *fp;
+
+  if(!(fp = fopen(path, "r")))
+    return 0;
+
+  for(j=0; settings[j]; j++)
+    if(getc(fp) != (unsigned char)settings[j])
+      break;
+  if(settings[j] || getc(fp) != '\n')
+  {
+    fclose(fp);
+    return 0;
+  }
+  for(j=0; j<normLen; j++)
+    if(getc(fp) != (unsigned char)norm[j])
+      break;
+  c = (j == normLen) && getc(fp) == EOF;
+  fclose(fp);
+  return c;
+}
+
+static int write_key(const char *path)
+{
+  FILE *fp;
+
+  if(!(fp = fopen(path, "w")))
+    return 0;
+  fprintf(fp, "%s\n", settings);
+  if(fwrite(norm, 1, normLen, fp) != normLen)
+  {
+    fclose(fp);
+    return 0;
+  }
+  return !fclose(fp);
+}
+
+/* make to a hard link to from, or a copy of from if it can't be linked; return 0 on failure */
+static int put_file(const char *from, const char *to)
+{
+  char buf[65536];
+  int ok=1;
+  size_t n;
+  FILE *in, *out;
+
+  unlink(to);
+  if(!link(from, to))
+    return 1;
+
+  if(!(in = fopen(from, "rb")))
+    return 0;
+  if(!(out = fopen(to, "wb")))
+  {
+    fclose(in);
+    return 0;
+  }
+  while(ok && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+    ok = fwrite(buf, 1, n, out) == n;
+  if(ferror(in))
+    ok = 0;
+  fclose(in);
+  if(fclose(out))
+    ok = 0;
+  return ok;
+}
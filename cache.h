@@ -0,0 +1,25 @@
+/* cache.h
+ *
+ * The content-addressed output cache of nemo2sbml, -C: the files a run
+ * writes are kept under a hash of its normalized input and settings, and a
+ * later run with the same input and settings links (or copies) them into
+ * place instead of compiling.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+
+char * oc_read(FILE *, size_t *);
+int oc_lookup(const char *, const char *, size_t, const char *);
+void oc_note(const char *);
+int oc_store(void);
+void oc_stats(int);
+
+#endif
@@ -0,0 +1,34 @@
+/* census.h
+ *
+ * Motif census of a network, -M: the signed regulation graph nemo2sbml has
+ * just parsed, whatever motifs it was written with, is searched for
+ * autoregulation, feedback cycles, feed-forward loops and single input
+ * modules.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#ifndef CENSUS_H
+#define CENSUS_H
+
+#define C_ACT 0 /* signs, as bits of an edge's sign mask */
+#define C_REP 1
+
+/* the counts; [0] positive, [1] negative for the loops */
+typedef struct
+{
+  long genes, edges, act, rep;   /* distinct regulations, one counted once per sign */
+  long autoreg[2];
+  long cycle2[2], cycle3[2];     /* by the sign of the loop */
+  long ffl[8];                   /* by sign of X->Y, Y->Z, X->Z: bit 2, 1, 0 set for repression */
+  long sims, simGenes, simLargest;
+} CENSUS;
+
+void census_edge(long, long, int);
+int census_count(CENSUS *);
+void census_reset(void);
+
+#endif
@@ -0,0 +1,196 @@
+/* ensemble.c
+ *
+ * Simulate a compiled network (see network.h) for many parameter sets on a
+ * pool of threads, and reduce the time courses to their mean and standard
+ * deviation at each output time.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "network.h"
+
+typedef struct
+{
+  const NETWORK  *net;
+  int             nsamples, nout;
+  double          tEnd, dt;
+  NETSAMPLE       sample;
+  void           *arg;
+
+  int             next;     /* next sample to simulate */
+  int             merged;   /* samples merged so far, in order */
+  int             n;        /* of them, those that ran to tEnd */
+  int             err;
+  double         *mean, *m2;
+  pthread_mutex_t lock;
+  pthread_cond_t  done;
+} ENSEMBLE;
+
+typedef struct
+{
+  ENSEMBLE *ens;
+  double   *traj;           /* nout rows of nspecies */
+  int       rows;
+} ENSTHREAD;
+
+static int ens_row(void *, double, const double *);
+static void * ens_worker(void *);
+
+/* keep the state at each output time, see net_simulate() */
+static int ens_row(void *arg, double t, const double *y)
+{
+  int i;
+  ENSTHREAD *th = (ENSTHREAD *) arg;
+  const NETWORK *net = th->ens->net;
+
+  if(th->rows == th->ens->nout)
+    return 0;
+
+  for(i=0; i<net->nspecies; i++)
+    th->traj[th->rows*net->nspecies + i] = y[i];
+  th->rows++;
+  return 0;
+}
+
+/*
+ Take samples in turn, simulate each with its own parameter set and copy of
+ the Hill laws, and merge the time courses into the running mean and sum of
+ squares (Welford) strictly in sample order, so the result does not depend on
+ the number of threads or on which thread ran which sample.
+*/
+static void * ens_worker(void *arg)
+{
+  int i, k, len, ok;
+  double d, *param;
+  ENSEMBLE *ens = (ENSEMBLE *) arg;
+  const NETWORK *net = ens->net;
+  ENSTHREAD th;
+  HILLSET *hs = NULL;
+
+  len = ens->nout*net->nspecies;
+  th.ens  = ens;
+  th.traj = (double *) malloc((len+1)*sizeof(double));
+  param   = (double *) malloc((net->nparams+1)*sizeof(double));
+  if(net->hill)
+    hs = hill_copy(net->hill);
+
+  if(!th.traj || !param || (net->hill && !hs))
+  {
+    fprintf(stderr, "net_ensemble: malloc error, returning...\n");
+    pthread_mutex_lock(&ens->lock);
+    ens->err = 1;
+    pthread_cond_broadcast(&ens->done);
+    pthread_mutex_unlock(&ens->lock);
+    free(th.traj); free(param); hill_free(hs);
+    return NULL;
+  }
+
+  for(;;)
+  {
+    pthread_mutex_lock(&ens->lock);
+    k = ens->err ? ens->nsamples : ens->next++;
+    pthread_mutex_unlock(&ens->lock);
+    if(k >= ens->nsamples)
+      break;
+
+    ens->sample(ens->arg, k, param);
+    if(hs)
+      hill_set_params(hs, param);
+    th.rows = 0;
+    ok = !net_simulate(net, hs, param, ens->tEnd, ens->dt, ens_row, &th) && th.rows == ens->nout;
+
+    pthread_mutex_lock(&ens->lock);
+    while(ens->merged != k && !ens->err)
+      pthread_cond_wait(&ens->done, &ens->lock);
+    if(ok && !ens->err)
+    {
+      ens->n++;
+      for(i=0; i<len; i++)
+      {
+        d = th.traj[i] - ens->mean[i];
+        ens->mean[i] += d/ens->n;
+        ens->m2[i]   += d*(th.traj[i] - ens->mean[i]);
+      }
+    }
+    ens->merged++;
+    pthread_cond_broadcast(&ens->done);
+    pthread_mutex_unlock(&ens->lock);
+  }
+
+  free(th.traj); free(param); hill_free(hs);
+  return NULL;
+}
+
+/*
+ Simulate net from 0 to tEnd for nsamples parameter sets, set k filled in by
+ sample(arg, k, param), on nthreads threads (sample must be safe to call from
+ several at once). *mean and *sd get malloc'd arrays of the mean and sample
+ standard deviation of each species at t = 0, dt, 2dt, ... (row by row,
+ nspecies a row), over the samples that ran to tEnd; *failed gets the number
+ that stopped early. Returns 0 on success, -1 on error.
+*/
+int net_ensemble(const NETWORK *net, int nsamples, int nthreads, double tEnd, double dt,
+                 NETSAMPLE sample, void *arg, double **mean, double **sd, int *failed)
+{
+  int i, len, nt;
+  ENSEMBLE ens;
+  pthread_t *tid;
+
+  ens.net      = net;
+  ens.nsamples = nsamples;
+  ens.nout     = (int) floor(tEnd/dt + 1e-9) + 1;
+  ens.tEnd     = tEnd;
+  ens.dt       = dt;
+  ens.sample   = sample;
+  ens.arg      = arg;
+  ens.next = ens.merged = ens.n = ens.err = 0;
+
+  len = ens.nout*net->nspecies;
+  ens.mean = (double *) calloc(len+1, sizeof(double));
+  ens.m2   = (double *) calloc(len+1, sizeof(double));
+  tid      = (pthread_t *) malloc(nthreads*sizeof(pthread_t));
+  if(!ens.mean || !ens.m2 || !tid)
+  {
+    fprintf(stderr, "net_ensemble: malloc error, returning...\n");
+    free(ens.mean); free(ens.m2); free(tid);
+    return -1;
+  }
+  pthread_mutex_init(&ens.lock, NULL);
+  pthread_cond_init(&ens.done, NULL);
+
+  if(nthreads > nsamples)
+    nthreads = nsamples;
+
+  /* this thread is one of the pool */
+  for(nt=0; nt<nthreads-1; nt++)
+    if(pthread_create(&tid[nt], NULL, ens_worker, &ens))
+      break;
+  ens_worker(&ens);
+  for(i=0; i<nt; i++)
+    pthread_join(tid[i], NULL);
+
+  pthread_cond_destroy(&ens.done);
+  pthread_mutex_destroy(&ens.lock);
+  free(tid);
+
+  if(ens.err)
+  {
+    free(ens.mean); free(ens.m2);
+    return -1;
+  }
+
+  for(i=0; i<len; i++)
+    ens.m2[i] = ens.n > 1 ? sqrt(ens.m2[i]/(ens.n-1)) : 0.0;
+
+  *mean   = ens.mean;
+  *sd     = ens.m2;
+  *failed = nsamples - ens.n;
+  return 0;
+}
@@ -0,0 +1,467 @@
+/* expr.c
+ *
+ * Build, fold and write out the syntax trees of user kinetic laws, see
+ * expr.h, and keep the symbol tables their proteins are resolved through.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "expr.h"
+
+/* a growable string */
+typedef struct
+{
+  char   *s;
+  size_t  len, sz;
+  int     err;
+} EBUF;
+
+static EXPR * node(int);
+static EXPR * folded(double, EXPR *, EXPR *);
+static int is_const(const EXPR *, double);
+static int prec(const EXPR *);
+static void put(EBUF *, const char *);
+static void emit(EBUF *, const EXPR_SYMS *, const EXPR *, int);
+static unsigned int sym_hash(const EXPR_SYMS *, const char *);
+
+/* function names as NEMO writes them, by F_ code */
+static const char *fname[] = {"abs", "arccos", "arcsin", "arctan", "ceiling", "cos", "cosh", "exp",
+                              "floor", "ln", "log10", "sin", "sinh", "sqrt", "tan", "tanh"};
+
+static EXPR * node(int op)
+{
+  EXPR *e;
+
+  e = (EXPR *) calloc(1, sizeof(EXPR));
+  if(e == NULL)
+    return NULL;
+  e->op  = op;
+  e->sym = -1;
+  return e;
+}
+
+/* a literal, DIGITS or DIGITS.DIGITS */
+EXPR * expr_const(const char *text)
+{
+  EXPR *e;
+
+  if((e = node(OP_CONST)) == NULL)
+    return NULL;
+  e->value = atof(text);
+  e->text  = strdup(text);
+  if(e->text == NULL)
+  {
+    free(e);
+    return NULL;
+  }
+  return e;
+}
+
+/* a protein, resolved through the symbol table t */
+EXPR * expr_symbol(EXPR_SYMS *t, const char *name)
+{
+  EXPR *e;
+
+  if((e = node(OP_SPECIES)) == NULL)
+    return NULL;
+  if((e->sym = expr_intern(t, name)) < 0)
+  {
+    free(e);
+    return NULL;
+  }
+  return e;
+}
+
+void expr_free(EXPR *e)
+{
+  if(e == NULL)
+    return;
+
+  expr_free(e->l);
+  expr_free(e->r);
+  free(e->text);
+  free(e);
+}
+
+/* l and r, replaced by the constant v */
+static EXPR * folded(double v, EXPR *l, EXPR *r)
+{
+  expr_free(l);
+  expr_free(r);
+  l = node(OP_CONST);
+  if(l)
+    l->value = v;
+  return l;
+}
+
+static int is_const(const EXPR *e, double v)
+{
+  return e->op == OP_CONST && e->value == v;
+}
+
+int expr_is_zero(const EXPR *e)
+{
+  return e && is_const(e, 0.0);
+}
+
+/*
+ Binary operation op on l and r (OP_ADD .. OP_POW, OP_LOGB and OP_ROOT, with
+ the base or degree as l), or OP_NEG on l. Constant operands are folded, as
+ are x+0, x-0, x*1, x/1, power(x,1) and -(-x); a result that is not finite is
+ left unfolded. Takes ownership of l and r, returns NULL on malloc error.
+*/
+EXPR * expr_op(int op, EXPR *l, EXPR *r)
+{
+  double v=0.0;
+  char *text;
+  EXPR *e;
+
+  if(l == NULL || (op != OP_NEG && r == NULL))
+  {
+    expr_free(l);
+    expr_free(r);
+    return NULL;
+  }
+
+  if(op == OP_NEG)
+  {
+    if(l->op == OP_NEG) /* -(-x) */
+    {
+      e = l->l;
+      free(l);
+      return e;
+    }
+
+    if(l->op == OP_CONST)
+    {
+      l->value = -l->value;
+      if(l->text) /* keep the literal, -2.0 */
+      {
+        text = (char *) malloc(strlen(l->text) + 2);
+        if(text == NULL)
+        {
+          expr_free(l);
+          return NULL;
+        }
+        text[0] = l->text[0] == '-' ? 0x0 : '-';
+        strcpy(text + (text[0] != 0x0), l->text + (l->text[0] == '-'));
+        free(l->text);
+        l->text = text;
+      }
+      return l;
+    }
+  }
+  else if(l->op == OP_CONST && r->op == OP_CONST)
+  {
+    switch(op)
+    {
+      case OP_ADD:  v = l->value + r->value; break;
+      case OP_SUB:  v = l->value - r->value; break;
+      case OP_MUL:  v = l->value * r->value; break;
+      case OP_DIV:  v = l->value / r->value; break;
+      case OP_POW:  v = pow(l->value, r->value); break;
+      case OP_LOGB: v = log(r->value)/log(l->value); break;
+      case OP_ROOT: v = pow(r->value, 1.0/l->value); break;
+    }
+    if(isfinite(v))
+      return folded(v, l, r);
+  }
+  else if(((op == OP_ADD || op == OP_SUB) && is_const(r, 0.0)) ||
+          ((op == OP_MUL || op == OP_DIV || op == OP_POW) && is_const(r, 1.0)))
+  {
+    expr_free(r);
+    return l;
+  }
+  else if((op == OP_ADD && is_const(l, 0.0)) || (op == OP_MUL && is_const(l, 1.0)))
+  {
+    expr_free(l);
+    return r;
+  }
+
+  if((e = node(op)) == NULL)
+  {
+    expr_free(l);
+    expr_free(r);
+    return NULL;
+  }
+  e->l = l;
+  e->r = op == OP_NEG ? NULL : r;
+  return e;
+}
+
+/* one argument function f, an F_ code, of a; folded if a is constant */
+EXPR * expr_func(int f, EXPR *a)
+{
+  double v;
+  EXPR *e;
+
+  if(a == NULL)
+    return NULL;
+
+  if(a->op == OP_CONST)
+  {
+    switch(f)
+    {
+      case F_ABS:     v = fabs(a->value);  break;
+      case F_ARCCOS:  v = acos(a->value);  break;
+      case F_ARCSIN:  v = asin(a->value);  break;
+      case F_ARCTAN:  v = atan(a->value);  break;
+      case F_CEILING: v = ceil(a->value);  break;
+      case F_COS:     v = cos(a->value);   break;
+      case F_EXP:     v = exp(a->value);   break;
+      case F_FLOOR:   v = floor(a->value); break;
+      case F_LN:      v = log(a->value);   break;
+      case F_SIN:     v = sin(a->value);   break;
+      case F_TAN:     v = tan(a->value);   break;
+      default:        v = NAN;             break;
+    }
+    if(isfinite(v))
+      return folded(v, a, NULL);
+  }
+
+  if((e = node(OP_FUNC)) == NULL)
+  {
+    expr_free(a);
+    return NULL;
+  }
+  e->arg = f;
+  e->l   = a;
+  return e;
+}
+
+/* binding strength of e's top operation, for parentheses */
+static int prec(const EXPR *e)
+{
+  switch(e->op)
+  {
+    case OP_ADD:
+    case OP_SUB:
+    case OP_NEG:   return 1;
+    case OP_MUL:
+    case OP_DIV:   return 2;
+    case OP_CONST: return e->text ? (e->text[0] == '-' ? 1 : 3) : (e->value < 0.0 ? 1 : 3);
+  }
+  return 3;
+}
+
+static void put(EBUF *b, const char *s)
+{
+  size_t n = strlen(s);
+  char *t;
+
+  if(b->err)
+    return;
+
+  if(b->len + n + 1 > b->sz)
+  {
+    t = (char *) realloc(b->s, 2*(b->len + n) + 64);
+    if(t == NULL)
+    {
+      b->err = 1;
+      return;
+    }
+    b->s  = t;
+    b->sz = 2*(b->len + n) + 64;
+  }
+  memcpy(b->s + b->len, s, n+1);
+  b->len += n;
+}
+
+/* e, parenthesized if it binds less tightly than p */
+static void emit(EBUF *b, const EXPR_SYMS *t, const EXPR *e, int p)
+{
+  char num[32];
+  int i, q = prec(e);
+
+  if(q < p)
+    put(b, "(");
+
+  switch(e->op)
+  {
+    case OP_CONST:
+      if(e->text)
+        put(b, e->text);
+      else
+      {
+        /* the shortest that reads back the same */
+        for(i=15; i<17; i++)
+        {
+          sprintf(num, "%.*g", i, e->value);
+          if(atof(num) == e->value)
+            break;
+        }
+        if(i == 17)
+          sprintf(num, "%.17g", e->value);
+        put(b, num);
+      }
+      break;
+
+    case OP_SPECIES:
+      put(b, t->name[e->sym]);
+      break;
+
+    case OP_NEG:
+      put(b, "-");
+      emit(b, t, e->l, 3);
+      break;
+
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+      /* a right operand of the same strength keeps its parentheses, a+(b+c) */
+      emit(b, t, e->l, q);
+      put(b, e->op == OP_ADD ? "+" : e->op == OP_SUB ? "-" : e->op == OP_MUL ? "*" : "/");
+      emit(b, t, e->r, q+1);
+      break;
+
+    case OP_POW:
+    case OP_LOGB:
+    case OP_ROOT:
+      put(b, e->op == OP_POW ? "power(" : e->op == OP_LOGB ? "log(" : "root(");
+      emit(b, t, e->l, 0);
+      put(b, ",");
+      emit(b, t, e->r, 0);
+      put(b, ")");
+      break;
+
+    case OP_FUNC:
+      put(b, fname[e->arg]);
+      put(b, "(");
+      emit(b, t, e->l, 0);
+      put(b, ")");
+      break;
+  }
+
+  if(q < p)
+    put(b, ")");
+}
+
+/* the formula of e, its proteins named by t, malloc'd, NULL on malloc error */
+char * expr_formula(const EXPR_SYMS *t, const EXPR *e)
+{
+  EBUF b = {NULL, 0, 0, 0};
+
+  emit(&b, t, e, 0);
+  if(b.err)
+  {
+    free(b.s);
+    return NULL;
+  }
+  return b.s;
+}
+
+/* FNV-1a, a slot of t->hash */
+static unsigned int sym_hash(const EXPR_SYMS *t, const char *s)
+{
+  unsigned int h = 2166136261u;
+
+  while(*s)
+    h = (h ^ (unsigned char)*s++) * 16777619u;
+  return h % t->hashSz;
+}
+
+/* the id of name, entered if new; -1 on malloc error */
+int expr_intern(EXPR_SYMS *t, const char *name)
+{
+  int i, id, *h;
+  char **n;
+  unsigned int x;
+
+  if((id = expr_lookup(t, name)) >= 0)
+    return id;
+
+  if(t->num == t->sz)
+  {
+    n = (char **) realloc(t->name, (2*t->sz+64)*sizeof(char *));
+    if(n == NULL)
+      return -1;
+    t->name = n;
+    h = (int *) realloc(t->mark, (2*t->sz+64)*sizeof(int));
+    if(h == NULL)
+      return -1;
+    t->mark = h;
+    t->sz = 2*t->sz+64;
+  }
+
+  /* keep the hash at most half full */
+  if(2*(t->num+1) > t->hashSz)
+  {
+    h = (int *) malloc(2*(t->hashSz+64)*sizeof(int));
+    if(h == NULL)
+      return -1;
+    free(t->hash);
+    t->hash = h;
+    t->hashSz  = 2*(t->hashSz+64);
+    for(i=0; i<t->hashSz; i++)
+      t->hash[i] = -1;
+    for(id=0; id<t->num; id++)
+    {
+      for(x=sym_hash(t, t->name[id]); t->hash[x] >= 0; x=(x+1)%t->hashSz) ;
+      t->hash[x] = id;
+    }
+  }
+
+  if((t->name[t->num] = strdup(name)) == NULL)
+    return -1;
+  t->mark[t->num] = 0;
+
+  for(x=sym_hash(t, name); t->hash[x] >= 0; x=(x+1)%t->hashSz) ;
+  t->hash[x] = t->num;
+  return t->num++;
+}
+
+/* the id of name, -1 if it has none */
+int expr_lookup(const EXPR_SYMS *t, const char *name)
+{
+  unsigned int x;
+
+  if(t->hashSz == 0)
+    return -1;
+
+  for(x=sym_hash(t, name); t->hash[x] >= 0; x=(x+1)%t->hashSz)
+    if(!strcmp(t->name[t->hash[x]], name))
+      return t->hash[x];
+  return -1;
+}
+
+const char * expr_name(const EXPR_SYMS *t, int id)
+{
+  return t->name[id];
+}
+
+/* mark each symbol in e with m, see expr_marked() */
+void expr_mark(EXPR_SYMS *t, const EXPR *e, int m)
+{
+  for(; e; e=e->r)
+  {
+    if(e->op == OP_SPECIES)
+      t->mark[e->sym] = m;
+    expr_mark(t, e->l, m);
+  }
+}
+
+/* was symbol id marked with m by the last expr_mark() that reached it */
+int expr_marked(const EXPR_SYMS *t, int id, int m)
+{
+  return id >= 0 && t->mark[id] == m;
+}
+
+/* empty the symbol table; no tree may be used after this */
+void expr_reset(EXPR_SYMS *t)
+{
+  int i;
+
+  for(i=0; i<t->num; i++)
+    free(t->name[i]);
+  free(t->name); free(t->mark); free(t->hash);
+  t->name = NULL; t->mark = t->hash = NULL;
+  t->num = t->sz = t->hashSz = 0;
+}
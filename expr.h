@@ -0,0 +1,55 @@
+/* expr.h
+ *
+ * Typed syntax trees for the user kinetic laws of NEMO, the F(...)
+ * expressions. Proteins are resolved to symbol ids when they are parsed, and
+ * constant subexpressions are folded as the tree is built, so a law is
+ * written out in its reduced form and its proteins can be checked without
+ * scanning its text. Each parse has a symbol table of its own, EXPR_SYMS, so
+ * parses may run at once.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#ifndef EXPR_H
+#define EXPR_H
+
+#include "network.h"
+
+/* a node; op is one of network.h's OP_ codes, with arg an F_ code for OP_FUNC */
+typedef struct EXPR
+{
+  int          op, arg;
+  int          sym;    /* OP_SPECIES: symbol id */
+  double       value;  /* OP_CONST */
+  char        *text;   /* OP_CONST: the literal as written, NULL if folded */
+  struct EXPR *l, *r;  /* operands, r only for binary operations */
+} EXPR;
+
+/* a symbol table: open addressing hash of names to ids, ids in order of first use; zeroed when empty */
+typedef struct
+{
+  char **name;  /* by id */
+  int   *mark;  /* by id, see expr_mark() */
+  int   *hash;  /* slot -> id, -1 if empty */
+  int    num, sz, hashSz;
+} EXPR_SYMS;
+
+EXPR * expr_const(const char *);
+EXPR * expr_symbol(EXPR_SYMS *, const char *);
+EXPR * expr_op(int, EXPR *, EXPR *);
+EXPR * expr_func(int, EXPR *);
+void expr_free(EXPR *);
+int expr_is_zero(const EXPR *);
+char * expr_formula(const EXPR_SYMS *, const EXPR *);
+
+int expr_intern(EXPR_SYMS *, const char *);
+int expr_lookup(const EXPR_SYMS *, const char *);
+const char * expr_name(const EXPR_SYMS *, int);
+void expr_mark(EXPR_SYMS *, const EXPR *, int);
+int expr_marked(const EXPR_SYMS *, int, int);
+void expr_reset(EXPR_SYMS *);
+
+#endif
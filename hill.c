@@ -0,0 +1,297 @@
+/* hill.c
+ *
+ * Structure-of-arrays batch evaluator for generalized Hill rate laws, see
+ * hill.h. network.c recognizes the laws of this form in a compiled network
+ * and hands them to a HILLSET, so simulation evaluates them here instead of
+ * through the general stack programs.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hill.h"
+
+static int grow(void **, int, int, size_t);
+
+/* make room for one more of n items of size sz, in *a of *cap */
+static int grow(void **a, int n, int cap, size_t sz)
+{
+  void *t;
+
+  if(n < cap)
+    return cap;
+
+  t = realloc(*a, (2*cap+64)*sz);
+  if(t == NULL)
+    return -1;
+  *a = t;
+  return 2*cap+64;
+}
+
+HILLSET * hill_create(int nspecies)
+{
+  HILLSET *hs;
+
+  hs = (HILLSET *) calloc(1, sizeof(HILLSET));
+  if(hs == NULL)
+    return NULL;
+
+  hs->nspecies = nspecies;
+  hs->r_num = (int *) malloc(sizeof(int));
+  hs->t_off = (int *) malloc(sizeof(int));
+  if(!hs->r_num || !hs->t_off)
+  {
+    hill_free(hs);
+    return NULL;
+  }
+  hs->r_num[0] = hs->t_off[0] = 0;
+  return hs;
+}
+
+/* a copy, e.g. for each thread to load with its own parameter values */
+HILLSET * hill_copy(const HILLSET *hs)
+{
+  HILLSET *cp;
+
+  cp = (HILLSET *) calloc(1, sizeof(HILLSET));
+  if(cp == NULL)
+    return NULL;
+
+  cp->nspecies   = hs->nspecies;
+  cp->nreactions = cp->reactionsSz = hs->nreactions;
+  cp->nterms     = cp->termsSz     = hs->nterms;
+  cp->nfactors   = cp->factorsSz   = hs->nfactors;
+
+#define HILL_COPY(a, n) \
+  if((cp->a = malloc((n)*sizeof(*hs->a) + 1)) == NULL) { hill_free(cp); return NULL; } \
+  memcpy(cp->a, hs->a, (n)*sizeof(*hs->a));
+
+  HILL_COPY(r_id,    hs->nreactions)
+  HILL_COPY(r_num,   hs->nreactions+1)
+  HILL_COPY(r_den,   hs->nreactions)
+  HILL_COPY(r_sub,   hs->nreactions)
+  HILL_COPY(r_c0,    hs->nreactions)
+  HILL_COPY(t_off,   hs->nterms+1)
+  HILL_COPY(t_c,     hs->nterms)
+  HILL_COPY(t_cval,  hs->nterms)
+  HILL_COPY(t_cp,    hs->nterms)
+  HILL_COPY(f_sp,    hs->nfactors)
+  HILL_COPY(f_n,     hs->nfactors)
+  HILL_COPY(f_nlogK, hs->nfactors)
+  HILL_COPY(f_K,     hs->nfactors)
+  HILL_COPY(f_nval,  hs->nfactors)
+  HILL_COPY(f_Kp,    hs->nfactors)
+  HILL_COPY(f_np,    hs->nfactors)
+#undef HILL_COPY
+
+  return cp;
+}
+
+void hill_free(HILLSET *hs)
+{
+  if(hs == NULL)
+    return;
+
+  free(hs->r_id);  free(hs->r_num);  free(hs->r_den);  free(hs->r_sub);  free(hs->r_c0);
+  free(hs->t_off); free(hs->t_c);    free(hs->t_cval); free(hs->t_cp);
+  free(hs->f_sp);  free(hs->f_n);    free(hs->f_nlogK);
+  free(hs->f_K);   free(hs->f_nval); free(hs->f_Kp);   free(hs->f_np);
+  free(hs);
+}
+
+/* start the law of reaction id; its terms go to the numerator until hill_denominator() */
+int hill_reaction(HILLSET *hs, int id)
+{
+  int sz, r = hs->nreactions;
+
+  if(r+1 >= hs->reactionsSz)
+  {
+    sz = hs->reactionsSz;
+    if(grow((void **)&hs->r_id,  r+1, sz, sizeof(int))    < 0 ||
+       grow((void **)&hs->r_num, r+1, sz, sizeof(int))    < 0 ||
+       grow((void **)&hs->r_den, r+1, sz, sizeof(int))    < 0 ||
+       grow((void **)&hs->r_sub, r+1, sz, sizeof(int))    < 0 ||
+       grow((void **)&hs->r_c0,  r+1, sz, sizeof(double)) < 0)
+      return 0;
+    hs->reactionsSz = 2*sz+64;
+  }
+
+  hs->r_id[r]  = id;
+  hs->r_num[r] = hs->r_den[r] = hs->r_sub[r] = hs->nterms;
+  hs->r_c0[r]  = 1.0; /* no denominator */
+  hs->r_hasden = hs->r_hassub = 0;
+  hs->nreactions++;
+  hs->r_num[hs->nreactions] = hs->nterms;
+  return 1;
+}
+
+/* the terms that follow are the denominator's, c0 + sum */
+int hill_denominator(HILLSET *hs, double c0)
+{
+  hs->r_c0[hs->nreactions-1] = c0;
+  hs->r_hasden = 1;
+  return 1;
+}
+
+/* the terms that follow are subtracted from the law */
+int hill_subtract(HILLSET *hs)
+{
+  hs->r_hassub = 1;
+  return 1;
+}
+
+/* start a term, coefficient c, times parameter cp if cp >= 0 */
+int hill_term(HILLSET *hs, double c, int cp)
+{
+  int sz, t = hs->nterms;
+
+  if(t+1 >= hs->termsSz)
+  {
+    sz = hs->termsSz;
+    if(grow((void **)&hs->t_off,  t+1, sz, sizeof(int))    < 0 ||
+       grow((void **)&hs->t_c,    t+1, sz, sizeof(double)) < 0 ||
+       grow((void **)&hs->t_cval, t+1, sz, sizeof(double)) < 0 ||
+       grow((void **)&hs->t_cp,   t+1, sz, sizeof(int))    < 0)
+      return 0;
+    hs->termsSz = 2*sz+64;
+  }
+
+  hs->t_c[t]    = c;
+  hs->t_cval[t] = c;
+  hs->t_cp[t]   = cp;
+  hs->t_off[t]  = hs->nfactors;
+  hs->nterms++;
+  hs->t_off[hs->nterms] = hs->nfactors;
+
+  hs->r_num[hs->nreactions] = hs->nterms;
+  if(!hs->r_hasden && !hs->r_hassub)
+    hs->r_den[hs->nreactions-1] = hs->nterms;
+  if(!hs->r_hassub)
+    hs->r_sub[hs->nreactions-1] = hs->nterms;
+  return 1;
+}
+
+/* multiply the current term by (species/K)^n, K and n literal or parameters Kp, np */
+int hill_factor(HILLSET *hs, int sp, double K, int Kp, double n, int np)
+{
+  int sz, f = hs->nfactors;
+
+  if(f >= hs->factorsSz)
+  {
+    sz = hs->factorsSz;
+    if(grow((void **)&hs->f_sp,    f, sz, sizeof(int))    < 0 ||
+       grow((void **)&hs->f_n,     f, sz, sizeof(double)) < 0 ||
+       grow((void **)&hs->f_nlogK, f, sz, sizeof(double)) < 0 ||
+       grow((void **)&hs->f_K,     f, sz, sizeof(double)) < 0 ||
+       grow((void **)&hs->f_nval,  f, sz, sizeof(double)) < 0 ||
+       grow((void **)&hs->f_Kp,    f, sz, sizeof(int))    < 0 ||
+       grow((void **)&hs->f_np,    f, sz, sizeof(int))    < 0)
+      return 0;
+    hs->factorsSz = 2*sz+64;
+  }
+
+  hs->f_sp[f]    = sp;
+  hs->f_K[f]     = K;
+  hs->f_Kp[f]    = Kp;
+  hs->f_nval[f]  = n;
+  hs->f_np[f]    = np;
+  hs->f_n[f]     = n;
+  hs->f_nlogK[f] = n*log(K);
+  hs->nfactors++;
+  hs->t_off[hs->nterms] = hs->nfactors;
+  return 1;
+}
+
+/* forget the reaction being built, e.g. when its law turns out not to fit */
+void hill_drop(HILLSET *hs)
+{
+  if(hs->nreactions == 0)
+    return;
+
+  hs->nreactions--;
+  hs->nterms   = hs->r_num[hs->nreactions];
+  hs->nfactors = hs->t_off[hs->nterms];
+  hs->r_hasden = hs->r_hassub = 0;
+}
+
+/* take the parameter valued coefficients, K's and n's from param */
+void hill_set_params(HILLSET *hs, const double *param)
+{
+  int f, t;
+  double K;
+
+  for(t=0; t<hs->nterms; t++)
+    hs->t_c[t] = hs->t_cp[t] >= 0 ? hs->t_cval[t]*param[hs->t_cp[t]] : hs->t_cval[t];
+
+  for(f=0; f<hs->nfactors; f++)
+  {
+    K = hs->f_Kp[f] >= 0 ? param[hs->f_Kp[f]] : hs->f_K[f];
+    hs->f_n[f]     = hs->f_np[f] >= 0 ? param[hs->f_np[f]] : hs->f_nval[f];
+    hs->f_nlogK[f] = hs->f_n[f]*log(K);
+  }
+}
+
+/* doubles of work space hill_rates() needs */
+int hill_worksize(const HILLSET *hs)
+{
+  return hs->nspecies + hs->nfactors + hs->nterms;
+}
+
+/*
+ Rates of all the laws at state y, into v[id] for each reaction id given to
+ hill_reaction(). Concentrations are clamped below at DBL_MIN, so the kernel
+ stays finite (and vectorizable with -ffinite-math-only) and a zero
+ concentration gives a term of ~0.
+*/
+void hill_rates(const HILLSET *hs, const double *y, double *v, double *work)
+{
+  int f, r, t;
+  double den, num, sub;
+  double *restrict logy = work;
+  double *restrict e    = logy + hs->nspecies;
+  double *restrict tv   = e + hs->nfactors;
+  const int    *restrict sp    = hs->f_sp;
+  const double *restrict n     = hs->f_n;
+  const double *restrict nlogK = hs->f_nlogK;
+  const double *restrict c     = hs->t_c;
+
+  for(f=0; f<hs->nspecies; f++)
+    logy[f] = log(y[f] > DBL_MIN ? y[f] : DBL_MIN);
+
+  for(f=0; f<hs->nfactors; f++)
+    e[f] = n[f]*logy[sp[f]] - nlogK[f];
+
+  for(t=0; t<hs->nterms; t++)
+  {
+    tv[t] = 0.0;
+    for(f=hs->t_off[t]; f<hs->t_off[t+1]; f++)
+      tv[t] += e[f];
+  }
+
+  for(t=0; t<hs->nterms; t++)
+    tv[t] = c[t]*exp(tv[t]);
+
+  for(r=0; r<hs->nreactions; r++)
+  {
+    num = 0.0;
+    for(t=hs->r_num[r]; t<hs->r_den[r]; t++)
+      num += tv[t];
+
+    den = hs->r_c0[r];
+    for(t=hs->r_den[r]; t<hs->r_sub[r]; t++)
+      den += tv[t];
+
+    sub = 0.0;
+    for(t=hs->r_sub[r]; t<hs->r_num[r+1]; t++)
+      sub += tv[t];
+
+    v[hs->r_id[r]] = num/den - sub;
+  }
+}
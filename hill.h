@@ -0,0 +1,68 @@
+/* hill.h
+ *
+ * Batch evaluation of generalized Hill rate laws, the form
+ * randomGeneralizedHill() writes:
+ *
+ *   rate = (sum of terms) / (c0 + sum of terms),   term = c * prod (P/K)^n
+ *
+ * (degradation, c * P, is the same form with no denominator), less a sum of
+ * terms after hill_subtract(), as for -n's net synthesis. All factors of
+ * all laws are held in structure-of-arrays layout, and a term is evaluated as
+ * c * exp(sum(n*log(P) - n*log(K))), so a whole network costs one log per
+ * species and one exp per term, in plain loops the compiler can vectorize
+ * (e.g. gcc -O3 -ffast-math, which uses glibc's vector exp and log).
+ *
+ * Build a HILLSET with hill_create(), then for each law hill_reaction(),
+ * and for each of its terms hill_term() and hill_factor()s. A value given
+ * with a parameter index >= 0 is taken from the parameter vector by
+ * hill_set_params(), otherwise the literal value is used.
+ * Concentrations are taken as >= 0.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#ifndef HILL_H
+#define HILL_H
+
+typedef struct hillset
+{
+  int     nspecies;
+
+  int     nreactions, reactionsSz;
+  int    *r_id;        /* caller's reaction number */
+  int    *r_num;       /* numerator terms r_num[r] .. r_den[r]-1 */
+  int    *r_den;       /* denominator terms r_den[r] .. r_num[r+1]-1 */
+  int    *r_sub;       /* subtracted terms r_sub[r] .. r_num[r+1]-1, the denominator ends at r_sub[r] */
+  double *r_c0;        /* constant of the denominator, 0 if there is none */
+  int     r_hasden;    /* set while the current reaction's denominator is built */
+  int     r_hassub;    /* and its subtracted terms */
+
+  int     nterms, termsSz;
+  int    *t_off;       /* factors t_off[t] .. t_off[t+1]-1 */
+  double *t_c, *t_cval;
+  int    *t_cp;
+
+  int     nfactors, factorsSz;
+  int    *f_sp;        /* species */
+  double *f_n, *f_nlogK;
+  double *f_K, *f_nval;
+  int    *f_Kp, *f_np;
+} HILLSET;
+
+HILLSET * hill_create(int);
+HILLSET * hill_copy(const HILLSET *);
+void hill_free(HILLSET *);
+int hill_reaction(HILLSET *, int);
+int hill_denominator(HILLSET *, double);
+int hill_subtract(HILLSET *);
+int hill_term(HILLSET *, double, int);
+int hill_factor(HILLSET *, int, double, int, double, int);
+void hill_drop(HILLSET *);
+void hill_set_params(HILLSET *, const double *);
+int hill_worksize(const HILLSET *);
+void hill_rates(const HILLSET *, const double *, double *, double *);
+
+#endif
@@ -0,0 +1,561 @@
+/* jacobian.c
+ *
+ * The Jacobian of dy/dt of a compiled network (see network.h). Its pattern
+ * follows from the regulation structure alone: the row of a species has a
+ * column for every species read by the kinetic law of a reaction that makes
+ * or uses it. Each non-zero can also be given as a formula, the sum over
+ * those reactions of stoichiometry times the partial derivative of the law,
+ * differentiated symbolically from libsbml's parse of the law.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sbml/SBMLTypes.h>
+#include <sbml/math/FormulaFormatter.h>
+#include <sbml/math/FormulaParser.h>
+#include "network.h"
+
+static int cmp_int(const void *, const void *);
+static ASTNode_t * num(double);
+static int is_num(const ASTNode_t *, double *);
+static ASTNode_t * op(char, ASTNode_t *, ASTNode_t *);
+static ASTNode_t * fn(ASTNodeType_t, ASTNode_t *);
+static ASTNode_t * power(ASTNode_t *, ASTNode_t *);
+static ASTNode_t * copy(const ASTNode_t *);
+static ASTNode_t * diff(const ASTNode_t *, const char *, int *);
+
+static int cmp_int(const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+/* a literal, an integer if it is one, so it prints as 2 rather than 2.0 */
+static ASTNode_t * num(double v)
+{
+  ASTNode_t *n = ASTNode_create();
+
+  if(v == floor(v) && fabs(v) < 1e9)
+    ASTNode_setInteger(n, (long) v);
+  else
+    ASTNode_setReal(n, v);
+  return n;
+}
+
+static int is_num(const ASTNode_t *n, double *v)
+{
+  switch(ASTNode_getType(n))
+  {
+    case AST_INTEGER:
+      *v = (double) ASTNode_getInteger(n);
+      return 1;
+    case AST_REAL:
+    case AST_REAL_E:
+    case AST_RATIONAL:
+      *v = ASTNode_getReal(n);
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/*
+ a c b for c one of + - * /, taking ownership of a and b (b may be NULL for
+ unary minus), folding literals and dropping the 0s and 1s differentiation
+ leaves everywhere
+*/
+static ASTNode_t * op(char c, ASTNode_t *a, ASTNode_t *b)
+{
+  int na, nb;
+  double va=0.0, vb=0.0;
+  ASTNode_t *n;
+
+  if(a == NULL || (b == NULL && c != '-'))
+  {
+    ASTNode_free(a);
+    ASTNode_free(b);
+    return NULL;
+  }
+
+  if(b == NULL) /* unary minus */
+  {
+    if(is_num(a, &va))
+    {
+      ASTNode_free(a);
+      return num(-va);
+    }
+    if(ASTNode_getType(a) == AST_MINUS && ASTNode_getNumChildren(a) == 1)
+    {
+      n = copy(ASTNode_getChild(a, 0));
+      ASTNode_free(a);
+      return n;
+    }
+    n = ASTNode_create();
+    ASTNode_setCharacter(n, '-');
+    ASTNode_addChild(n, a);
+    return n;
+  }
+
+  na = is_num(a, &va);
+  nb = is_num(b, &vb);
+  if(na && nb && !(c == '/' && vb == 0.0))
+  {
+    ASTNode_free(a);
+    ASTNode_free(b);
+    switch(c)
+    {
+      case '+': return num(va + vb);
+      case '-': return num(va - vb);
+      case '*': return num(va * vb);
+      default:  return num(va / vb);
+    }
+  }
+
+  if((c == '+' && na && va == 0.0) || (c == '*' && na && va == 1.0))
+  {
+    ASTNode_free(a);
+    return b;
+  }
+  if(((c == '+' || c == '-') && nb && vb == 0.0) || ((c == '*' || c == '/') && nb && vb == 1.0))
+  {
+    ASTNode_free(b);
+    return a;
+  }
+  if(c == '-' && na && va == 0.0)
+  {
+    ASTNode_free(a);
+    return op('-', b, NULL);
+  }
+  if((c == '*' && ((na && va == 0.0) || (nb && vb == 0.0))) || (c == '/' && na && va == 0.0))
+  {
+    ASTNode_free(a);
+    ASTNode_free(b);
+    return num(0.0);
+  }
+  if(c == '*' && na && va == -1.0)
+  {
+    ASTNode_free(a);
+    return op('-', b, NULL);
+  }
+  if(c == '*' && nb && vb == -1.0)
+  {
+    ASTNode_free(b);
+    return op('-', a, NULL);
+  }
+
+  n = ASTNode_create();
+  ASTNode_setCharacter(n, c);
+  ASTNode_addChild(n, a);
+  ASTNode_addChild(n, b);
+  return n;
+}
+
+/* f(a), a builtin function of one argument */
+static ASTNode_t * fn(ASTNodeType_t type, ASTNode_t *a)
+{
+  ASTNode_t *n;
+
+  if(a == NULL)
+    return NULL;
+
+  n = ASTNode_createWithType(type);
+  ASTNode_addChild(n, a);
+  return n;
+}
+
+/* power(a, b), a^1 is a */
+static ASTNode_t * power(ASTNode_t *a, ASTNode_t *b)
+{
+  double v;
+  ASTNode_t *n;
+
+  if(a == NULL || b == NULL)
+  {
+    ASTNode_free(a);
+    ASTNode_free(b);
+    return NULL;
+  }
+
+  if(is_num(b, &v) && v == 1.0)
+  {
+    ASTNode_free(b);
+    return a;
+  }
+
+  n = ASTNode_createWithType(AST_FUNCTION_POWER);
+  ASTNode_addChild(n, a);
+  ASTNode_addChild(n, b);
+  return n;
+}
+
+static ASTNode_t * copy(const ASTNode_t *n)
+{
+  return ASTNode_deepCopy(n);
+}
+
+/*
+ d node / d var, simplified as it is built. Sets *err, and returns NULL, for
+ anything net_compile() would not have compiled.
+*/
+static ASTNode_t * diff(const ASTNode_t *node, const char *var, int *err)
+{
+  int i, k, n = ASTNode_getNumChildren(node);
+  double v;
+  ASTNode_t *a=0x0, *b=0x0, *d, *da, *db, *sum, *term;
+
+  if(n >= 1) a = ASTNode_getChild(node, 0);
+  if(n >= 2) b = ASTNode_getChild(node, 1);
+
+  switch(ASTNode_getType(node))
+  {
+    case AST_INTEGER:
+    case AST_REAL:
+    case AST_REAL_E:
+    case AST_RATIONAL:
+    case AST_CONSTANT_E:
+    case AST_CONSTANT_PI:
+    case AST_NAME_TIME:
+      return num(0.0);
+
+    case AST_NAME:
+      return num(strcmp(ASTNode_getName(node), var) ? 0.0 : 1.0);
+
+    case AST_PLUS:
+      sum = num(0.0);
+      for(i=0; i<n; i++)
+        sum = op('+', sum, diff(ASTNode_getChild(node, i), var, err));
+      return sum;
+
+    case AST_MINUS:
+      if(n == 1)
+        return op('-', diff(a, var, err), NULL);
+      if(n == 2)
+        return op('-', diff(a, var, err), diff(b, var, err));
+      break;
+
+    case AST_TIMES: /* product rule */
+      sum = num(0.0);
+      for(i=0; i<n; i++)
+      {
+        term = diff(ASTNode_getChild(node, i), var, err);
+        for(k=0; k<n && term; k++)
+          if(k != i)
+            term = op('*', term, copy(ASTNode_getChild(node, k)));
+        sum = op('+', sum, term);
+      }
+      return sum;
+
+    case AST_DIVIDE:
+      if(n != 2)
+        break;
+      da = diff(a, var, err);
+      db = diff(b, var, err);
+      if(db && is_num(db, &v) && v == 0.0)
+      {
+        ASTNode_free(db);
+        return op('/', da, copy(b));
+      }
+      return op('/', op('-', op('*', da, copy(b)), op('*', copy(a), db)), power(copy(b), num(2.0)));
+
+    case AST_POWER:
+    case AST_FUNCTION_POWER:
+      if(n != 2)
+        break;
+      da = diff(a, var, err);
+      db = diff(b, var, err);
+      if(db && is_num(db, &v) && v == 0.0) /* b a^(b-1) da */
+      {
+        ASTNode_free(db);
+        return op('*', op('*', copy(b), power(copy(a), op('-', copy(b), num(1.0)))), da);
+      }
+      /* a^b (db ln(a) + b da/a) */
+      return op('*', power(copy(a), copy(b)),
+                     op('+', op('*', db, fn(AST_FUNCTION_LN, copy(a))), op('/', op('*', copy(b), da), copy(a))));
+
+    case AST_FUNCTION_EXP:
+      if(n == 1)
+        return op('*', copy(node), diff(a, var, err));
+      break;
+
+    case AST_FUNCTION_LN:
+      if(n == 1)
+        return op('/', diff(a, var, err), copy(a));
+      break;
+
+    case AST_FUNCTION_LOG: /* log(base, x), log10 if there is no base */
+      if(n == 1)
+        return op('/', diff(a, var, err), op('*', copy(a), fn(AST_FUNCTION_LN, num(10.0))));
+      if(n != 2)
+        break;
+      db = diff(b, var, err);
+      d  = diff(a, var, err);
+      if(d && is_num(d, &v) && v == 0.0)
+      {
+        ASTNode_free(d);
+        return op('/', db, op('*', copy(b), fn(AST_FUNCTION_LN, copy(a))));
+      }
+      ASTNode_free(d);
+      ASTNode_free(db);
+      break;
+
+    case AST_FUNCTION_ROOT: /* root(degree, x), sqrt if there is no degree */
+      if(n == 1)
+        return op('/', diff(a, var, err), op('*', num(2.0), copy(node)));
+      if(n != 2)
+        break;
+      d = diff(a, var, err);
+      if(d && is_num(d, &v) && v == 0.0) /* x^(1/k - 1) / k dx */
+      {
+        ASTNode_free(d);
+        return op('*', op('/', power(copy(b), op('-', op('/', num(1.0), copy(a)), num(1.0))), copy(a)),
+                       diff(b, var, err));
+      }
+      ASTNode_free(d);
+      break;
+
+    case AST_FUNCTION_ABS:
+      if(n == 1)
+        return op('*', op('/', copy(a), copy(node)), diff(a, var, err));
+      break;
+
+    case AST_FUNCTION_CEILING:
+    case AST_FUNCTION_FLOOR:
+      if(n == 1)
+        return num(0.0);
+      break;
+
+    case AST_FUNCTION_SIN:
+      if(n == 1)
+        return op('*', fn(AST_FUNCTION_COS, copy(a)), diff(a, var, err));
+      break;
+
+    case AST_FUNCTION_COS:
+      if(n == 1)
+        return op('-', op('*', fn(AST_FUNCTION_SIN, copy(a)), diff(a, var, err)), NULL);
+      break;
+
+    case AST_FUNCTION_TAN:
+      if(n == 1)
+        return op('/', diff(a, var, err), power(fn(AST_FUNCTION_COS, copy(a)), num(2.0)));
+      break;
+
+    case AST_FUNCTION_SINH:
+      if(n == 1)
+        return op('*', fn(AST_FUNCTION_COSH, copy(a)), diff(a, var, err));
+      break;
+
+    case AST_FUNCTION_COSH:
+      if(n == 1)
+        return op('*', fn(AST_FUNCTION_SINH, copy(a)), diff(a, var, err));
+      break;
+
+    case AST_FUNCTION_TANH:
+      if(n == 1)
+        return op('/', diff(a, var, err), power(fn(AST_FUNCTION_COSH, copy(a)), num(2.0)));
+      break;
+
+    case AST_FUNCTION_ARCSIN:
+    case AST_FUNCTION_ARCCOS:
+      if(n != 1)
+        break;
+      d = op('/', diff(a, var, err), fn(AST_FUNCTION_ROOT, op('-', num(1.0), power(copy(a), num(2.0)))));
+      return ASTNode_getType(node) == AST_FUNCTION_ARCCOS ? op('-', d, NULL) : d;
+
+    case AST_FUNCTION_ARCTAN:
+      if(n == 1)
+        return op('/', diff(a, var, err), op('+', num(1.0), power(copy(a), num(2.0))));
+      break;
+
+    default:
+      break;
+  }
+
+  *err = 1;
+  return NULL;
+}
+
+/*
+ Write the Jacobian of dy/dt of net with puts, one non-zero a line, "row
+ column", or with partials, "row column formula", rows and columns being the
+ species that are not fixed (those -S writes). Returns 0 on success, -1 on
+ error, or puts' return value if that is non-zero.
+*/
+int net_jacobian(const NETWORK *net, int partials, NETPUTS puts, void *arg)
+{
+  char buf[64], *formula;
+  int c, err=0, i, j, k, n = net->nspecies, nr = net->nreactions, nnz, p, r, ret=0;
+  int *af_off=0x0, *af=0x0, *cnt=0x0, *jp=0x0, *jc=0x0, *mark=0x0, *rd_off=0x0, *rd=0x0, *strx=0x0;
+  double coef;
+  const NETOP *o;
+  ASTNode_t **laws=0x0, *d, *entry;
+
+  rd_off = (int *) calloc(nr+2, sizeof(int));
+  af_off = (int *) calloc(n+2, sizeof(int));
+  cnt    = (int *) calloc(n+nr+2, sizeof(int));
+  mark   = (int *) malloc((n+1)*sizeof(int));
+  jp     = (int *) malloc((n+1)*sizeof(int));
+  strx   = (int *) malloc((net->st_off[nr]+1)*sizeof(int));
+  if(!rd_off || !af_off || !cnt || !mark || !jp || !strx)
+    goto malloc_error;
+
+  /* the reaction of each stoichiometry entry */
+  for(r=0; r<nr; r++)
+    for(p=net->st_off[r]; p<net->st_off[r+1]; p++)
+      strx[p] = r;
+
+  /* the species each law reads, once each */
+  for(i=0; i<n; i++)
+    mark[i] = -1;
+  for(k=0; k<2; k++)
+  {
+    for(r=0; r<nr; r++)
+    {
+      for(o=net->code+net->code_off[r]; o<net->code+net->code_off[r+1]; o++)
+      {
+        if(o->op != OP_SPECIES || mark[o->arg] == k*nr + r)
+          continue;
+        mark[o->arg] = k*nr + r;
+        if(k == 0)
+          rd_off[r+1]++;
+        else
+          rd[rd_off[r] + cnt[r]++] = o->arg;
+      }
+    }
+    if(k == 0)
+    {
+      for(r=0; r<nr; r++)
+        rd_off[r+1] += rd_off[r];
+      if(!(rd = (int *) malloc((rd_off[nr]+1)*sizeof(int))))
+        goto malloc_error;
+    }
+  }
+
+  /* the stoichiometry entries of each species, by species */
+  for(p=0; p<net->st_off[nr]; p++)
+    af_off[net->st_species[p]+1]++;
+  for(i=0; i<n; i++)
+    af_off[i+1] += af_off[i];
+  if(!(af = (int *) malloc((af_off[n]+1)*sizeof(int))))
+    goto malloc_error;
+  memset(cnt, 0, (n+1)*sizeof(int));
+  for(p=0; p<net->st_off[nr]; p++)
+    af[af_off[net->st_species[p]] + cnt[net->st_species[p]]++] = p;
+
+  /* the pattern, row by row */
+  for(k=0; k<2; k++)
+  {
+    for(i=0; i<n; i++)
+      mark[i] = -1;
+    for(i=0, nnz=0; i<n; i++)
+    {
+      jp[i] = nnz;
+      if(net->fixed[i])
+        continue;
+      for(p=af_off[i]; p<af_off[i+1]; p++)
+      {
+        r = strx[af[p]];
+        for(c=rd_off[r]; c<rd_off[r+1]; c++)
+        {
+          j = rd[c];
+          if(net->fixed[j] || mark[j] == i)
+            continue;
+          mark[j] = i;
+          if(k == 1)
+            jc[nnz] = j;
+          nnz++;
+        }
+      }
+      if(k == 1)
+        qsort(jc + jp[i], nnz - jp[i], sizeof(int), cmp_int);
+    }
+    jp[n] = nnz;
+    if(k == 0 && !(jc = (int *) malloc((nnz+1)*sizeof(int))))
+      goto malloc_error;
+  }
+
+  if(partials && !(laws = (ASTNode_t **) calloc(nr+1, sizeof(ASTNode_t *))))
+    goto malloc_error;
+
+  for(i=0, k=0; i<n; i++)
+    k += !net->fixed[i];
+  sprintf(buf, "# %d species, %d non-zeros\n", k, nnz);
+  if((ret = puts(arg, "# Jacobian of dy/dt: d(row)/dt depends on column\n")) || (ret = puts(arg, buf)) ||
+     (ret = puts(arg, partials ? "# row\tcolumn\tpartial derivative\n" : "# row\tcolumn\n")))
+    goto done;
+
+  for(i=0; i<n; i++)
+  {
+    for(c=jp[i]; c<jp[i+1]; c++)
+    {
+      j = jc[c];
+      if((ret = puts(arg, net->species[i])) || (ret = puts(arg, "\t")) || (ret = puts(arg, net->species[j])))
+        goto done;
+
+      if(partials)
+      {
+        /* sum over the reactions of i that read j of stoichiometry * d law / d j; on failure r is the reaction */
+        entry = num(0.0);
+        for(p=af_off[i]; p<af_off[i+1] && entry && !err; p++)
+        {
+          r = strx[af[p]];
+          for(k=rd_off[r]; k<rd_off[r+1] && rd[k] != j; k++) ;
+          if(k == rd_off[r+1])
+            continue;
+
+          if(laws[r] == NULL && (laws[r] = SBML_parseFormula(net->laws[r])) == NULL)
+          {
+            fprintf(stderr, "net_jacobian: can't parse kinetic law %s of %s, returning...\n", net->laws[r], net->reactions[r]);
+            ASTNode_free(entry);
+            ret = -1;
+            goto done;
+          }
+
+          d = diff(laws[r], net->species[j], &err);
+          coef = net->st_coef[af[p]];
+          if(coef < 0)
+            entry = op('-', entry, op('*', num(-coef), d));
+          else
+            entry = op('+', entry, op('*', num(coef), d));
+        }
+
+        if(entry == NULL || err)
+        {
+          ASTNode_free(entry);
+          fprintf(stderr, "net_jacobian: can't differentiate kinetic law %s of %s, returning...\n", net->laws[r], net->reactions[r]);
+          ret = -1;
+          goto done;
+        }
+        formula = SBML_formulaToString(entry);
+        ASTNode_free(entry);
+        if(formula == NULL)
+          goto malloc_error;
+        if(!(ret = puts(arg, "\t")))
+          ret = puts(arg, formula);
+        free(formula);
+        if(ret)
+          goto done;
+      }
+
+      if((ret = puts(arg, "\n")))
+        goto done;
+    }
+  }
+  goto done;
+
+malloc_error:
+  fprintf(stderr, "net_jacobian: malloc error, returning...\n");
+  ret = -1;
+done:
+  if(laws)
+    for(r=0; r<nr; r++)
+      ASTNode_free(laws[r]);
+  free(laws);
+  free(rd_off); free(rd); free(af_off); free(af); free(cnt); free(mark); free(jp); free(jc); free(strx);
+  return ret;
+}
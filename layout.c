@@ -0,0 +1,638 @@
+/* layout.c
+ *
+ * Graph layout of the XGMML of a network, see layout.h.
+ *
+ * The genes are given as they are parsed, and the regulations between them;
+ * once the network is done one of two layouts is computed.
+ *
+ * force: Fruchterman-Reingold, each gene pushing every other away and each
+ * regulation pulling its two genes together, under a temperature that cools
+ * to zero. The pushes are summed with a Barnes-Hut quadtree, a far cell
+ * acting as one body at its center of mass, O(n log n) a step instead of
+ * O(n^2). The tree is built once a step, and the forces on the genes are
+ * summed on nthreads threads, each gene's from the same positions, so the
+ * layout is the same whatever the number of threads. The genes start at
+ * places hashed from their numbers, so a network is always laid out alike.
+ * Each LAYOUT holds its own network, so several may be laid out at once.
+ *
+ * tree: the master regulators (genes no other gene regulates) are the top
+ * layer, and each gene is a layer below the nearest of them, found by
+ * breadth first search; a cycle out of reach of any of them is entered at
+ * its gene of most targets. Each layer is ordered by the mean place of the
+ * neighbors of its genes in the layers above, then below, and so on, so the
+ * regulations mostly run straight. This is O(m + n log n) a pass, and is not
+ * threaded.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "layout.h"
+
+#define K        100.0 /* ideal regulation length */
+#define GRAVITY  0.1   /* pull to the origin, keeps pieces of the graph together */
+#define STEPS    200
+#define THETA    1.0   /* a cell of size s at distance d is one body if s < THETA*d */
+#define MAXDEPTH 40    /* deeper genes, at (nearly) the same place, share a cell */
+#define LAYER_X  80.0  /* tree: spacing in a layer, and of the layers */
+#define LAYER_Y  150.0
+#define SWEEPS   8     /* tree: passes up and down, ordering the layers */
+
+/* a cell of the quadtree: a leaf holds body (or, at MAXDEPTH, several bodies) */
+typedef struct
+{
+  double cx, cy, half; /* center and half width */
+  double mx, my;       /* center of mass */
+  int    mass, body, child[4];
+} QCELL;
+
+/* a gene number and its index, for looking up the ends of the regulations */
+typedef struct
+{
+  long g;
+  int  i;
+} NODEKEY;
+
+/* a gene and its sort key, for ordering the roots and the layers of a tree */
+typedef struct
+{
+  double v;
+  int    i;
+} RANK;
+
+struct LAYOUT
+{
+  long *gene, *edges;   /* edges: src, dst pairs of gene numbers */
+  int n, genesSz, numEdges, edgesSz;
+  double *x, *y;
+
+  int m, *src, *dst;                  /* the regulations between genes of the network, by index, no self loops */
+  int *outStart, *out, *inStart, *in; /* their targets and regulators */
+
+  QCELL *cells;
+  int numCells, cellsSz;
+  double *dispX, *dispY;
+  int nextChunk;
+  pthread_mutex_t chunkLock;
+};
+
+static int build_tree(LAYOUT *);
+static int new_cell(LAYOUT *, double, double, double);
+static int add_leaf(LAYOUT *, int, int, int);
+static void * force_worker(void *);
+static void force_on(LAYOUT *, int);
+static int force_layout(LAYOUT *, int);
+static int tree_layout(LAYOUT *);
+static void place_layer(LAYOUT *, int *, int, int);
+static int cmp_key(const void *, const void *);
+static int cmp_rank(const void *, const void *);
+static double hash_unit(unsigned long long);
+
+/* an empty layout, NULL on a malloc error */
+LAYOUT * layout_new(void)
+{
+  LAYOUT *lay;
+
+  lay = (LAYOUT *) calloc(1, sizeof(LAYOUT));
+  if(lay)
+    pthread_mutex_init(&lay->chunkLock, NULL);
+  return lay;
+}
+
+void layout_free(LAYOUT *lay)
+{
+  if(!lay)
+    return;
+  free(lay->gene); free(lay->edges); free(lay->x); free(lay->y);
+  pthread_mutex_destroy(&lay->chunkLock);
+  free(lay);
+}
+
+/* gene g, in the order the genes are to be written */
+void layout_node(LAYOUT *lay, long g)
+{
+  long *t;
+
+  if(lay->n == lay->genesSz)
+  {
+    t = (long *) realloc(lay->gene, (lay->genesSz+4096)*sizeof(long));
+    if(!t)
+    {
+      fprintf(stderr, "layout_node: realloc error, the layout will be short...\n");
+      return;
+    }
+    lay->gene = t;
+    lay->genesSz += 4096;
+  }
+  lay->gene[lay->n++] = g;
+}
+
+/* gene src's protein regulates gene dst */
+void layout_edge(LAYOUT *lay, long s, long d)
+{
+  long *t;
+
+  if(lay->numEdges == lay->edgesSz)
+  {
+    t = (long *) realloc(lay->edges, 2*(lay->edgesSz+4096)*sizeof(long));
+    if(!t)
+    {
+      fprintf(stderr, "layout_edge: realloc error, the layout will be short...\n");
+      return;
+    }
+    lay->edges = t;
+    lay->edgesSz += 4096;
+  }
+  lay->edges[2*lay->numEdges]   = s;
+  lay->edges[2*lay->numEdges+1] = d;
+  lay->numEdges++;
+}
+
+/* forget the genes and regulations given so far, for the next network */
+void layout_reset(LAYOUT *lay)
+{
+  lay->n = lay->numEdges = 0;
+  free(lay->x); free(lay->y);
+  lay->x = lay->y = 0x0;
+}
+
+int layout_count(LAYOUT *lay)
+{
+  return lay->n;
+}
+
+/* the number of the i-th gene given, and its place; (0, 0) until laid out */
+long layout_get(LAYOUT *lay, int i, double *px, double *py)
+{
+  *px = lay->x ? lay->x[i] : 0.0;
+  *py = lay->y ? lay->y[i] : 0.0;
+  return lay->gene[i];
+}
+
+/* lay out the genes given so far, kind LAYOUT_FORCE or LAYOUT_TREE; return 0 on a malloc error */
+int layout_compute(LAYOUT *lay, int kind, int nthreads)
+{
+  int i, ok=0;
+  NODEKEY key, *keys=0x0, *a, *b;
+
+  free(lay->x); free(lay->y);
+  lay->x = (double *) calloc(lay->n+1, sizeof(double));
+  lay->y = (double *) calloc(lay->n+1, sizeof(double));
+  keys          = (NODEKEY *) malloc((lay->n+1)*sizeof(NODEKEY));
+  lay->src      = (int *) malloc((lay->numEdges+1)*sizeof(int));
+  lay->dst      = (int *) malloc((lay->numEdges+1)*sizeof(int));
+  lay->outStart = (int *) calloc(lay->n+2, sizeof(int));
+  lay->out      = (int *) malloc((lay->numEdges+1)*sizeof(int));
+  lay->inStart  = (int *) calloc(lay->n+2, sizeof(int));
+  lay->in       = (int *) malloc((lay->numEdges+1)*sizeof(int));
+  if(!lay->x || !lay->y || !keys || !lay->src || !lay->dst || !lay->outStart || !lay->out || !lay->inStart || !lay->in)
+    goto done;
+
+  /* the regulations by index; an end that is not a gene of this network is dropped */
+  for(i=0; i<lay->n; i++)
+  {
+    keys[i].g = lay->gene[i];
+    keys[i].i = i;
+  }
+  qsort(keys, lay->n, sizeof(NODEKEY), cmp_key);
+  for(i=lay->m=0; i<lay->numEdges; i++)
+  {
+    key.g = lay->edges[2*i];
+    a = (NODEKEY *) bsearch(&key, keys, lay->n, sizeof(NODEKEY), cmp_key);
+    key.g = lay->edges[2*i+1];
+    b = (NODEKEY *) bsearch(&key, keys, lay->n, sizeof(NODEKEY), cmp_key);
+    if(!a || !b || a->i == b->i)
+      continue;
+    lay->src[lay->m] = a->i;
+    lay->dst[lay->m] = b->i;
+    lay->m++;
+  }
+
+  for(i=0; i<lay->m; i++)
+  {
+    lay->outStart[lay->src[i]+2]++;
+    lay->inStart[lay->dst[i]+2]++;
+  }
+  for(i=0; i<lay->n; i++)
+  {
+    lay->outStart[i+2] += lay->outStart[i+1];
+    lay->inStart[i+2]  += lay->inStart[i+1];
+  }
+  for(i=0; i<lay->m; i++)
+  {
+    lay->out[lay->outStart[lay->src[i]+1]++] = lay->dst[i];
+    lay->in[lay->inStart[lay->dst[i]+1]++]   = lay->src[i];
+  }
+
+  if(kind == LAYOUT_TREE)
+    ok = tree_layout(lay);
+  else
+  {
+    for(i=0; i<lay->n; i++)
+    {
+      lay->x[i] = K*sqrt((double)lay->n) * (hash_unit(2*(unsigned long long)lay->gene[i]) - 0.5);
+      lay->y[i] = K*sqrt((double)lay->n) * (hash_unit(2*(unsigned long long)lay->gene[i]+1) - 0.5);
+    }
+    ok = force_layout(lay, nthreads);
+  }
+
+done:
+  if(!ok)
+  {
+    fprintf(stderr, "layout_compute: malloc error, the genes are not laid out...\n");
+    free(lay->x); free(lay->y);
+    lay->x = lay->y = 0x0;
+  }
+  free(keys); free(lay->src); free(lay->dst); free(lay->outStart); free(lay->out); free(lay->inStart); free(lay->in);
+  return ok;
+}
+
+static int force_layout(LAYOUT *lay, int nthreads)
+{
+  int i, j, step, started;
+  double len, s, t, t0;
+  pthread_t *tid=0x0;
+
+  lay->dispX = (double *) malloc((lay->n+1)*sizeof(double));
+  lay->dispY = (double *) malloc((lay->n+1)*sizeof(double));
+  if(!lay->dispX || !lay->dispY)
+  {
+    free(lay->dispX); free(lay->dispY);
+    return 0;
+  }
+  if(nthreads > 1)
+    tid = (pthread_t *) malloc((nthreads-1)*sizeof(pthread_t));
+
+  t0 = K*sqrt((double)lay->n)/10;
+  for(step=0; step<STEPS; step++)
+  {
+    if(!build_tree(lay))
+    {
+      free(lay->dispX); free(lay->dispY); free(tid); free(lay->cells);
+      lay->cells = 0x0;
+      lay->cellsSz = 0;
+      return 0;
+    }
+
+    lay->nextChunk = 0;
+    for(started=0; tid && started<nthreads-1; started++)
+      if(pthread_create(&tid[started], NULL, force_worker, lay))
+        break;
+    force_worker(lay);
+    for(j=0; j<started; j++)
+      pthread_join(tid[j], NULL);
+
+    /* move each gene along its force, no further than the temperature */
+    t = t0*(1.0 - (double)step/STEPS);
+    for(i=0; i<lay->n; i++)
+    {
+      len = sqrt(lay->dispX[i]*lay->dispX[i] + lay->dispY[i]*lay->dispY[i]);
+      if(len > 0.0)
+      {
+        s = (len < t ? len : t)/len;
+        lay->x[i] += lay->dispX[i]*s;
+        lay->y[i] += lay->dispY[i]*s;
+      }
+    }
+  }
+
+  free(lay->dispX); free(lay->dispY); free(tid); free(lay->cells);
+  lay->cells = 0x0;
+  lay->cellsSz = 0;
+  return 1;
+}
+
+/* the forces on the genes of chunks of 256, until there are none left */
+static void * force_worker(void *arg)
+{
+  LAYOUT *lay = (LAYOUT *) arg;
+  int i, lo;
+
+  for(;;)
+  {
+    pthread_mutex_lock(&lay->chunkLock);
+    lo = lay->nextChunk;
+    lay->nextChunk += 256;
+    pthread_mutex_unlock(&lay->chunkLock);
+
+    if(lo >= lay->n)
+      break;
+    for(i=lo; i<lo+256 && i<lay->n; i++)
+      force_on(lay, i);
+  }
+
+  return NULL;
+}
+
+/* the force on gene i, into dispX[i], dispY[i] */
+static void force_on(LAYOUT *lay, int i)
+{
+  int c, j, q, top, stack[4*MAXDEPTH+8];
+  double dx, dy, d2, f, fx=0.0, fy=0.0;
+  QCELL *cell;
+
+  /* pushed by all the genes, the far ones by cells */
+  stack[0] = 0;
+  top = 1;
+  while(top > 0)
+  {
+    cell = &lay->cells[stack[--top]];
+    dx = lay->x[i] - cell->mx;
+    dy = lay->y[i] - cell->my;
+    d2 = dx*dx + dy*dy;
+    if(cell->body >= 0 || 4*cell->half*cell->half < THETA*THETA*d2)
+    {
+      if(d2 > 1e-12)
+      {
+        f = K*K*cell->mass/d2;
+        fx += dx*f;
+        fy += dy*f;
+      }
+    }
+    else
+      for(q=0; q<4; q++)
+        if((c = cell->child[q]) >= 0)
+          stack[top++] = c;
+  }
+
+  /* pulled by the genes it regulates or is regulated by */
+  for(j=lay->outStart[i]; j<lay->outStart[i+1]; j++)
+  {
+    dx = lay->x[i] - lay->x[lay->out[j]];
+    dy = lay->y[i] - lay->y[lay->out[j]];
+    f = sqrt(dx*dx + dy*dy)/K;
+    fx -= dx*f;
+    fy -= dy*f;
+  }
+  for(j=lay->inStart[i]; j<lay->inStart[i+1]; j++)
+  {
+    dx = lay->x[i] - lay->x[lay->in[j]];
+    dy = lay->y[i] - lay->y[lay->in[j]];
+    f = sqrt(dx*dx + dy*dy)/K;
+    fx -= dx*f;
+    fy -= dy*f;
+  }
+
+  lay->dispX[i] = fx - GRAVITY*lay->x[i];
+  lay->dispY[i] = fy - GRAVITY*lay->y[i];
+}
+
+/* the quadtree of the genes where they are now, return 0 on a realloc error */
+static int build_tree(LAYOUT *lay)
+{
+  int c, b, depth, i, q;
+  double lo=0.0, hi=0.0;
+
+  for(i=0; i<lay->n; i++)
+  {
+    if(i == 0 || lay->x[i] < lo) lo = lay->x[i];
+    if(i == 0 || lay->y[i] < lo) lo = lay->y[i];
+    if(i == 0 || lay->x[i] > hi) hi = lay->x[i];
+    if(i == 0 || lay->y[i] > hi) hi = lay->y[i];
+  }
+  lay->numCells = 0;
+  if(new_cell(lay, (lo+hi)/2, (lo+hi)/2, (hi-lo)/2 + 1.0) < 0)
+    return 0;
+
+  for(i=0; i<lay->n; i++)
+  {
+    c = 0;
+    for(depth=0; ; depth++)
+    {
+      lay->cells[c].mass++;
+      lay->cells[c].mx += lay->x[i];
+      lay->cells[c].my += lay->y[i];
+      if(lay->cells[c].mass == 1) /* the empty root */
+      {
+        lay->cells[c].body = i;
+        break;
+      }
+      if(lay->cells[c].body >= 0)
+      {
+        if(depth >= MAXDEPTH)
+          break;
+        /* a leaf: move its body down a level */
+        b = lay->cells[c].body;
+        lay->cells[c].body = -1;
+        q = (lay->x[b] >= lay->cells[c].cx) | (lay->y[b] >= lay->cells[c].cy) << 1;
+        if(!add_leaf(lay, c, q, b))
+          return 0;
+      }
+
+      q = (lay->x[i] >= lay->cells[c].cx) | (lay->y[i] >= lay->cells[c].cy) << 1;
+      if(lay->cells[c].child[q] < 0)
+      {
+        if(!add_leaf(lay, c, q, i))
+          return 0;
+        break;
+      }
+      c = lay->cells[c].child[q];
+    }
+  }
+
+  for(c=0; c<lay->numCells; c++)
+    if(lay->cells[c].mass > 1)
+    {
+      lay->cells[c].mx /= lay->cells[c].mass;
+      lay->cells[c].my /= lay->cells[c].mass;
+    }
+  return 1;
+}
+
+/* a leaf of body i as quadrant q of cell c, return 0 on a realloc error */
+static int add_leaf(LAYOUT *lay, int c, int q, int i)
+{
+  int l;
+  double h = lay->cells[c].half/2;
+
+  l = new_cell(lay, lay->cells[c].cx + (q & 1 ? h : -h), lay->cells[c].cy + (q & 2 ? h : -h), h); /* may move cells */
+  if(l < 0)
+    return 0;
+  lay->cells[c].child[q] = l;
+  lay->cells[l].mass = 1;
+  lay->cells[l].mx   = lay->x[i];
+  lay->cells[l].my   = lay->y[i];
+  lay->cells[l].body = i;
+  return 1;
+}
+
+/* an empty cell, its index or -1 on a realloc error */
+static int new_cell(LAYOUT *lay, double cx, double cy, double half)
+{
+  QCELL *t;
+
+  if(lay->numCells == lay->cellsSz)
+  {
+    t = (QCELL *) realloc(lay->cells, (2*lay->cellsSz+1024)*sizeof(QCELL));
+    if(!t)
+      return -1;
+    lay->cells = t;
+    lay->cellsSz = 2*lay->cellsSz+1024;
+  }
+  t = &lay->cells[lay->numCells];
+  t->cx = cx;
+  t->cy = cy;
+  t->half = half;
+  t->mx = t->my = 0.0;
+  t->mass = 0;
+  t->body = -1;
+  t->child[0] = t->child[1] = t->child[2] = t->child[3] = -1;
+  return lay->numCells++;
+}
+
+static int tree_layout(LAYOUT *lay)
+{
+  int cnt, e, head, i, j, k, l, next=-1, numLayers, ok=0, pass, tail, *layer=0x0, *order=0x0, *queue=0x0, *start=0x0;
+  double bary;
+  RANK *roots=0x0, *rank=0x0;
+
+  layer = (int *) malloc((lay->n+1)*sizeof(int));
+  order = (int *) malloc((lay->n+1)*sizeof(int));
+  queue = (int *) malloc((lay->n+1)*sizeof(int));
+  rank  = (RANK *) malloc((lay->n+1)*sizeof(RANK));
+  if(!layer || !order || !queue || !rank)
+    goto done;
+
+  /* the layers, from the master regulators down, then from the cycles no master regulator reaches */
+  head = tail = 0;
+  for(i=0; i<lay->n; i++)
+  {
+    layer[i] = lay->inStart[i] == lay->inStart[i+1] ? 0 : -1;
+    if(layer[i] == 0)
+      queue[tail++] = i;
+  }
+  for(;;)
+  {
+    while(head < tail)
+    {
+      i = queue[head++];
+      for(j=lay->outStart[i]; j<lay->outStart[i+1]; j++)
+        if(layer[lay->out[j]] < 0)
+        {
+          layer[lay->out[j]] = layer[i]+1;
+          queue[tail++] = lay->out[j];
+        }
+    }
+    if(tail == lay->n)
+      break;
+
+    /* enter the next cycle at its unplaced gene of most targets; the genes are sorted so once */
+    if(next < 0)
+    {
+      roots = (RANK *) malloc((lay->n+1)*sizeof(RANK));
+      if(!roots)
+        goto done;
+      for(i=0; i<lay->n; i++)
+      {
+        roots[i].v = -(lay->outStart[i+1] - lay->outStart[i]); /* most targets first */
+        roots[i].i = i;
+      }
+      qsort(roots, lay->n, sizeof(RANK), cmp_rank);
+      next = 0;
+    }
+    while(layer[roots[next].i] >= 0)
+      next++;
+    layer[roots[next].i] = 0;
+    queue[tail++] = roots[next].i;
+  }
+
+  /* the genes of each layer, in index order */
+  for(i=numLayers=0; i<lay->n; i++)
+    if(layer[i] >= numLayers)
+      numLayers = layer[i]+1;
+  start = (int *) calloc(numLayers+2, sizeof(int));
+  if(!start)
+    goto done;
+  for(i=0; i<lay->n; i++)
+    start[layer[i]+2]++;
+  for(l=0; l<numLayers; l++)
+    start[l+2] += start[l+1];
+  for(i=0; i<lay->n; i++)
+    order[start[layer[i]+1]++] = i;
+
+  /* each layer in index order, then ordered by the mean place of its genes'
+   * neighbors in the layers above, then below, and so on (Sugiyama's barycenters)
+   */
+  for(l=0; l<numLayers; l++)
+    place_layer(lay, order+start[l], start[l+1]-start[l], l);
+  for(pass=0; pass<SWEEPS; pass++)
+    for(k=0; k<numLayers-1; k++)
+    {
+      l = pass & 1 ? numLayers-2-k : k+1;
+      for(j=start[l]; j<start[l+1]; j++)
+      {
+        i = order[j];
+        bary = 0.0;
+        cnt = 0;
+        for(e=lay->outStart[i]; e<lay->outStart[i+1]; e++)
+          if(pass & 1 ? layer[lay->out[e]] > l : layer[lay->out[e]] < l)
+          {
+            bary += lay->x[lay->out[e]];
+            cnt++;
+          }
+        for(e=lay->inStart[i]; e<lay->inStart[i+1]; e++)
+          if(pass & 1 ? layer[lay->in[e]] > l : layer[lay->in[e]] < l)
+          {
+            bary += lay->x[lay->in[e]];
+            cnt++;
+          }
+        rank[j-start[l]].v = cnt ? bary/cnt : lay->x[i];
+        rank[j-start[l]].i = i;
+      }
+      qsort(rank, start[l+1]-start[l], sizeof(RANK), cmp_rank);
+      for(j=start[l]; j<start[l+1]; j++)
+        order[j] = rank[j-start[l]].i;
+      place_layer(lay, order+start[l], start[l+1]-start[l], l);
+    }
+  ok = 1;
+
+done:
+  free(layer); free(order); free(queue); free(roots); free(rank); free(start);
+  return ok;
+}
+
+/* the genes of layer l, in order, at their places */
+static void place_layer(LAYOUT *lay, int *genes, int cnt, int l)
+{
+  int k;
+
+  for(k=0; k<cnt; k++)
+  {
+    lay->x[genes[k]] = (k - (cnt-1)/2.0)*LAYER_X;
+    lay->y[genes[k]] = l*LAYER_Y;
+  }
+}
+
+static int cmp_key(const void *a, const void *b)
+{
+  long s = ((const NODEKEY *) a)->g, t = ((const NODEKEY *) b)->g;
+
+  return s < t ? -1 : s > t;
+}
+
+/* genes by v, then index */
+static int cmp_rank(const void *a, const void *b)
+{
+  const RANK *r = (const RANK *) a, *t = (const RANK *) b;
+
+  if(r->v != t->v)
+    return r->v < t->v ? -1 : 1;
+  return r->i - t->i;
+}
+
+/* uniform in [0, 1) hashed from v, the splitmix64 finalizer */
+static double hash_unit(unsigned long long v)
+{
+  v += 0x9e3779b97f4a7c15ULL;
+  v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  v = (v ^ (v >> 27)) * 0x94d049bb133111ebULL;
+  v ^= v >> 31;
+  return (v >> 11) * (1.0/9007199254740992.0);
+}
@@ -0,0 +1,31 @@
+/* layout.h
+ *
+ * Graph layout of a network's XGMML, -L: the genes are placed by nemo2sbml,
+ * and their places written as <graphics x= y=> of each node, so Cytoscape
+ * need not run a layout of its own on a large network.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#define LAYOUT_NONE  0
+#define LAYOUT_FORCE 1 /* force-directed, Barnes-Hut */
+#define LAYOUT_TREE  2 /* in layers down from the master regulators */
+
+typedef struct LAYOUT LAYOUT; /* the genes and regulations of a network, and their places */
+
+LAYOUT * layout_new(void);
+void layout_free(LAYOUT *);
+void layout_node(LAYOUT *, long);
+void layout_edge(LAYOUT *, long, long);
+int layout_compute(LAYOUT *, int, int);
+int layout_count(LAYOUT *);
+long layout_get(LAYOUT *, int, double *, double *);
+void layout_reset(LAYOUT *);
+
+#endif
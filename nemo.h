@@ -0,0 +1,53 @@
+/* nemo.h
+ *
+ * libnemo: compile NEMO text into SBML (and XGMML) in-process, without
+ * nemo2sbml's files. Build nemo.y with -DNEMO_LIBRARY to leave out its
+ * main(), and link lex.yy.c, y.tab.c and the other .c files of nemo2sbml.
+ *
+ * nemo_compile() may be called any number of times, from any thread. Each
+ * call has a parser, scanner and network state of its own, so calls made at
+ * once run in parallel. That holds for what NEMO_OPTIONS can ask for; the -T
+ * timing, -C cache, -M census and -P partition of nemo2sbml are process-wide,
+ * and only nemo2sbml itself uses them, never under -d.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#ifndef NEMO_H
+#define NEMO_H
+
+#include <stdio.h>
+
+/* the nemo2sbml options a compile takes; zero for the defaults, except seed */
+typedef struct
+{
+  long        seed;           /* -s */
+  int         threads;        /* -j, 0 for 1 */
+  int         legacyRand;     /* -l */
+  int         kineticLawInfo; /* -k, to sinks->info */
+  int         parseInfo;      /* -p, on stdout */
+  int         xgmml;          /* -x */
+  int         netReactions;   /* -n */
+  int         layout;         /* -L, with xgmml: 0 none, 1 force, 2 tree */
+  const char *prefix;         /* model ids are <prefix>_<n>, or NULL for regulatoryNetwork_<genes>genes_<n> */
+} NEMO_OPTIONS;
+
+/* where each network goes; a sink returns 0 on failure, and may be NULL */
+typedef struct
+{
+  int  (*sbml)(void *arg, int network, const char *id, const char *text);
+  int  (*xgmml)(void *arg, int network, const char *id, const char *text);
+  void  *arg;
+  FILE  *err;  /* the errors in the text, NULL for stderr */
+  FILE  *info; /* kineticLawInfo's laws, NULL for stdout */
+} NEMO_SINKS;
+
+#define NEMO_SEED 123456789 /* nemo2sbml's default -s */
+
+int nemo_compile(const char *, size_t, const NEMO_OPTIONS *, const NEMO_SINKS *);
+int nemo_serve(const char *, const char *, int);
+
+#endif
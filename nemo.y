@@ -54,862 +54,1001 @@
 #define VERSION "1.7"
 
 #include <ctype.h>
+#include <float.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sbml/SBMLTypes.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <regex.h>
 #include <unistd.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "cache.h"
+#include "census.h"
+#include "expr.h"
+#include "nemo.h"
+#include "network.h"
+#include "layout.h"
+#include "partition.h"
+#include "timing.h"
 
 
 #define BUFSZ      256
+#define CYTO_FLUSH 65536 /* XGMML bytes held in cytoBuf before going to the body file */
 #define GENES    16384
 #define NLT_SZ    8192
 #define NON_LINEAR     /* comment this out if you don't want non-linear terms in the Hill function */
 #define RES          2 /* the max number of regex subexpressions allowed */
 #define SBML_LEVEL   2
 #define SBML_VERSION 1
+#define R_DC         0 /* parameter kinds, keys for param_rand() */
+#define R_B          1
+#define R_K          2
+#define R_N          3
+#define R_NL_K       4
+#define R_NL_N       5
+#define R_SAMPLE     6 /* -E ensemble samples */
+#define P_LOCAL      0 /* where the parameters go, see -g */
+#define P_CSV        1
+#define P_BIN        2
+#define Z_NONE       0 /* output compression, see -z */
+#define Z_GZIP       1
+#define Z_ZSTD       2
+
+/* an output file, written plain or through a streaming compressor */
+typedef struct
+{
+  FILE      *fp;
+#ifdef HAVE_ZLIB
+  gzFile     gz;
+#endif
+#ifdef HAVE_ZSTD
+  ZSTD_CCtx *zc;
+  char      *zbuf;
+  size_t     zbufSz;
+#endif
+  int        zformat;  /* the -z format it was opened in */
+  int        err;
+} OUTFILE;
+
+/* a growable string, so that long kinetic laws are built in linear time */
+typedef struct
+{
+  char   *s;
+  size_t  len, sz;
+  int     err;
+} STRBUF;
+
+/* a gene of a multi_out's pg list, with its F() law if it has one */
+typedef struct
+{
+  char *gene;
+  EXPR *law;
+} PGENE;
+
+/* a parameter of a queued kinetic law, named prefix<index> */
+typedef struct
+{
+  char   *prefix;
+  int     index;
+  double  value;
+  int     kind;                   /* R_xx, and the key of param_rand(), for -K */
+  unsigned long long key[3];
+} HILLPARAM;
+
+/* a kinetic law queued by randomGeneralizedHill(), built by hill_formula() */
+typedef struct
+{
+  KineticLaw_t *kl, *dl;          /* synthesis and degradation laws */
+  char         *gene, *tfs;
+  int           index;            /* parameterIndex at the start of this law */
+  HILLPARAM    *params;           /* dc_, then the synthesis parameters in order */
+  int           nparams, paramsSz, err;
+  int           cached;           /* the law came from the -c cache, see law_cache_load() */
+  STRBUF        formula;
+} HILLJOB;
+
+/* a random parameter of the network, to be drawn again for each -K variant */
+typedef struct
+{
+  char   id[32];
+  int    kind;
+  unsigned long long key[3];
+} SWEEPPARAM;
+
+/* a DOR, GLIST or TMLIST of the network, and the laws queued for it, for -c */
+typedef struct
+{
+  char   *text;                   /* its text, without white space */
+  unsigned long long hash;
+  int     first, num, hit;        /* hillJobs[first .. first+num-1] */
+} LAWITEM;
 
-int check_dor(char *);
-void mark_neighbors(int);
-char * randomGeneralizedHill(char *, char *);
-char * insertNonLinearTerms(char *, char *);
-char * explicitKineticLaw(char *, char *, char *);
-void xgmmlXML(char *, char *);
-
-int cytoBufSz, firstP=1, kineticLawInfo=0, num_files=0, num_genes, num_sgn=0,
-    parameterIndex=0, parseInfo=0, rand_func=0, tot_genes=0, user_func=0, xgmml=0;
-char *cytoBuf, docbuf[64], genes[GENES][BUFSZ], followingGene[BUFSZ], *kineticLawString, *kLSp,
-     marked[GENES], modelname[BUFSZ], output[BUFSZ], *p, *pt, *pgp, pg[BUFSZ], protein[BUFSZ],
-     returnString[NLT_SZ], sgn0, sgn1, sgn2, temp[BUFSZ], *tmp, tmpCytoBuf[BUFSZ], 
-     transcriptionFactors[8*BUFSZ], xgmmlTmp[BUFSZ];
-
-extern FILE *yyin, *yyout;
-FILE *cyto_graph;
-const char *sid = "Cell"; /* compartment name */
-regex_t preg;
-
-/* SBML */
-Compartment_t              *compart;
-KineticLaw_t               *kl;
-Model_t                    *model;
-ModifierSpeciesReference_t *msr;
-Parameter_t                *dparam;
-Parameter_t                *param;
-Reaction_t                 *react;
-SBMLDocument_t             *doc;
-Species_t                  *species;
-SpeciesReference_t         *reactant;
-Unit_t                     *unit;
-UnitDefinition_t           *unitdef;
 %}
 
+%code requires
+{
+#include <stdio.h>
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+/* the scanner's state, its yyextra, see nemo.lex */
+typedef struct NEMO_LEX
+{
+  int          lineNum, colNum;  /* where the next character is */
+  int          tokLine, tokCol;  /* where the last token starts */
+  int          dorLine, dorCol;  /* where the last DOR starts, for DOR graph errors */
+  int          numErrors;
+  FILE        *errOut;           /* where errors go, NULL for stderr, see nemo_compile() */
+  struct node *list;             /* the genes and proteins of the network so far */
+} NEMO_LEX;
+
+typedef struct NEMO_CTX NEMO_CTX; /* a parse, see below */
+}
+
+%define api.pure full
+%lex-param   {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {NEMO_CTX *ctx}
+
 %union
 {
   char string[32];
   char *string_pt;
+  struct EXPR *expr_pt; /* see expr.h */
 }
 
+%{
+/* the state of a parse: nemo2sbml's options, and the network being built;
+ * each nemo_compile() has its own, so compiles may run at once
+ */
+struct NEMO_CTX
+{
+  NEMO_LEX lex;
+
+  /* options */
+  int      jacobian, kineticLawInfo, layoutKind, legacyRand, memInfo, motifCensus, netReactions, numParts,
+           numSamples, numThreads, numTrajectories, numVariants, paramTable, parseInfo, steadyState, xgmml,
+           zformat, zlevel;
+  long     seedval;
+  double   simDt, simEnd, ssaOmega;
+  char     cacheDir[BUFSZ], output[BUFSZ];
+  const NEMO_SINKS *sinks;        /* libnemo, see nemo_compile() */
+  FILE    *infoOut;               /* -k, NULL for stdout */
+  unsigned short xsubi[3];        /* -l: the drand48() stream, see legacy_seed() */
+
+  /* the network */
+  int      edgeId, errorsBefore, firstP, num_files, num_sgn, parameterIndex, rand_func, tot_genes, user_func;
+  char     docbuf[2*BUFSZ], *fText[2], *kLSp, modelname[BUFSZ], *pt, protein[BUFSZ], sgn0, sgn1, sgn2,
+           temp[BUFSZ], *tmp, tmpCytoBuf[BUFSZ], transcriptionFactors[8*BUFSZ], xgmmlTmp[8*BUFSZ];
+  PGENE   *pgGenes, *pgn;
+  int      numPgGenes, pgGenesSz;
+  KineticLaw_t   *kl;
+  Model_t        *model;
+  Reaction_t     *react;
+  SBMLDocument_t *doc;
+  EXPR_SYMS syms;                 /* the proteins of the F() laws */
+  LAYOUT  *layout;                /* -L */
+  int      lawMark;               /* see explicitKineticLaw() */
+
+  /* XGMML */
+  char    *cytoBuf;
+  size_t   cytoBufSz, cytoLen;
+  FILE    *cyto_body;
+  OUTFILE *cyto_graph;
+
+  /* check_dor() */
+  char     genes[GENES][BUFSZ], marked[GENES];
+  int      num_genes, cacheHits, cacheMisses;
+  regex_t  preg;
+
+  /* -c: the laws of each DOR, GLIST and TMLIST, see law_cache_note() */
+  LAWITEM *lawItems;
+  int      numLawItems, lawItemsSz, itemJob, lawHits, lawMisses;
+
+  /* the kinetic laws of the network, see build_kinetic_laws() */
+  HILLJOB *hillJobs;
+  int      numHillJobs, hillJobsSz, nextHillJob;
+  pthread_mutex_t hillLock;
+
+  /* -g and -K */
+  OUTFILE *paramOut;
+  SWEEPPARAM *sweep;
+  int      numSweep, sweepSz, numSweepTable, nextVariant, *sweepOk;
+  Parameter_t **sweepTable;       /* -g with -K: the model's parameters, in order */
+  char    *sweepText;             /* the SBML of variant 0, see sweep_network() */
+  pthread_mutex_t sweepLock;
+
+  int      writeErrors;
+};
+
+/* where the rows of -S, -E and -G go */
+typedef struct
+{
+  NEMO_CTX *ctx;
+  NETWORK  *net;
+  OUTFILE  *out;
+  int      *kind;
+} NETOUT;
+
+NEMO_CTX * new_ctx(void);
+void free_ctx(NEMO_CTX *);
+void legacy_seed(NEMO_CTX *, long);
+yyscan_t nemo_lex_open(NEMO_LEX *, FILE *);
+void nemo_lex_close(yyscan_t);
+int yylex(YYSTYPE *, yyscan_t);
+void yyerror(yyscan_t, NEMO_CTX *, const char *, ...);
+void nemo_error(NEMO_LEX *, int, int, char *, ...);
+int check_dor(NEMO_CTX *, char *);
+int check_dor_cached(NEMO_CTX *, char *);
+void law_cache_note(NEMO_CTX *, int, char *);
+void law_cache_load(NEMO_CTX *);
+void law_cache_store(NEMO_CTX *);
+void law_cache_path(NEMO_CTX *, LAWITEM *, char *);
+void law_renumber(STRBUF *, char *, int);
+void mark_neighbors(NEMO_CTX *, int);
+char * randomGeneralizedHill(NEMO_CTX *, char *, char *);
+char ** hill_tokens(char *, int *, int *);
+int hill_other(char *, char *);
+int hill_formula(NEMO_CTX *, HILLJOB *);
+void insertNonLinearTerms(NEMO_CTX *, HILLJOB *, STRBUF *, char **, int, int, int *, int);
+void hill_param(NEMO_CTX *, HILLJOB *, char *, int, int, int, char *, char *, int);
+void * hill_worker(void *);
+int build_kinetic_laws(NEMO_CTX *);
+void sb_cat(STRBUF *, char *);
+void sb_printf(STRBUF *, const char *, ...);
+double param_rand(NEMO_CTX *, int, int, char *, char *, int);
+double param_range(int, double);
+double key_rand(NEMO_CTX *, unsigned long long *, int);
+double seed_rand(long, unsigned long long *, int);
+void param_key(unsigned long long *, int, int, char *, char *, int);
+char * explicitKineticLaw(NEMO_CTX *, char *, char *, EXPR *);
+int pg_add(NEMO_CTX *, char *, EXPR *);
+void pg_clear(NEMO_CTX *);
+void drop_reaction(NEMO_CTX *);
+void parse_info_expr(NEMO_CTX *, char *, EXPR *);
+void skip_network(NEMO_CTX *);
+void drop_kinetic_laws(NEMO_CTX *);
+void xgmmlXML(NEMO_CTX *, char *, char *);
+void new_document(NEMO_CTX *);
+void output_network(NEMO_CTX *);
+void sweep_network(NEMO_CTX *);
+void * sweep_worker(void *);
+int sweep_variant(NEMO_CTX *, int);
+int sweep_param(NEMO_CTX *, char *, HILLPARAM *);
+int cmp_sweep(const void *, const void *);
+void xgmml_sink(NEMO_CTX *, char *);
+void cyto_node(NEMO_CTX *, int, char *);
+void simulate_network(NEMO_CTX *, NETWORK *);
+void steady_network(NEMO_CTX *, NETWORK *);
+void census_law(char *, char *);
+void census_network(NEMO_CTX *);
+void partition_network(NEMO_CTX *);
+void param_table(NEMO_CTX *);
+int param_row(const void *, const void *);
+int put_param(NEMO_CTX *, OUTFILE *, const char *, double);
+int sweep_table(const void *, const void *);
+int sweep_params(NEMO_CTX *, int);
+void jacobian_network(NEMO_CTX *, NETWORK *);
+int jac_puts(void *, const char *);
+int sim_row(void *, double, const double *);
+void ensemble_network(NEMO_CTX *, NETWORK *);
+void ens_sample(void *, int, double *);
+void ssa_network(NEMO_CTX *, NETWORK *);
+int ssa_row(void *, int, double, const double *);
+void reset_network(NEMO_CTX *);
+void cyto_write(NEMO_CTX *, char *);
+int cyto_flush(NEMO_CTX *);
+OUTFILE * out_open(NEMO_CTX *, char *);
+int out_write(OUTFILE *, const char *, size_t);
+int out_puts(OUTFILE *, char *);
+int out_close(OUTFILE *);
+char * out_suffix(NEMO_CTX *);
+#ifdef HAVE_ZSTD
+int zstd_stream(OUTFILE *, const char *, size_t, int);
+#endif
+
+const char *sid = "Cell"; /* compartment name */
+%}
+
 %token <string> ABS ARCCOS ARCSIN ARCTAN CEILING COS DIGITS DOR EXP FLOOR
                 GENE GLIST LN LOG POWER PROTEIN ROOT SIN TAN TEN TMLIST
-%type <string_pt> constant dor expr gene ff_loop gene_list multi_out pg sim sim_list
-                  start protein p_error p_list sgn term tmotif tmotif_list tr_group
+%type <string_pt> dor gene ff_loop gene_list multi_out pg sim sim_list
+                  start protein p_error p_list sgn tmotif tmotif_list tr_group
+%type <expr_pt>   constant expr term
+%destructor { free($$); } <string_pt>
+%destructor { expr_free($$); } <expr_pt>
 %left '+' '-'
 %left '*' '/'
 %nonassoc UMINUS
 
 %%
 start       : start '[' tr_group ']'                                                          {
-                                                                                                /* output new SBML file */
-                                                                                                if(output[0])
-                                                                                                  sprintf(docbuf, "%s_%d", output, num_files++);
-                                                                                                else
-                                                                                                  sprintf(docbuf, "regulatoryNetwork_%dgenes_%d", tot_genes, num_files++);
-                                                                                                
-                                                                                                Model_setId(model, docbuf);
-                                                                                                
-                                                                                                if(rand_func && user_func)
-                                                                                                  sprintf(modelname, "Synthetic Network: user specified input functions, and randomized parameters in generalized Hill Functions (nemo2sbml ver %s)", VERSION);
-                                                                                                else if(rand_func)
-                                                                                                  sprintf(modelname, "Synthetic Network: randomized parameters in generalized Hill Functions (nemo2sbml ver %s)", VERSION);
-                                                                                                else if(user_func)
-                                                                                                  sprintf(modelname, "Synthetic Network: user specified input functions (nemo2sbml ver %s)", VERSION);
-                                                                                                else /* probably shouldn't get here */
-                                                                                                  sprintf(modelname, "Synthetic Network: no input functions (nemo2sbml ver %s)", VERSION);
-                                                                                                  
-                                                                                                Model_setName(model, modelname);
-                                                                                                
-                                                                                                strcat(docbuf, ".xml");
-                                                                                                if(writeSBML(doc, docbuf))
-                                                                                                  printf("SBML document written: %s\n", docbuf);
-                                                                                                else
-                                                                                                  fprintf(stderr, "nemo2sbml: Error, failed to write SBML document %s\n", docbuf);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed network:     [%s]\n", $3);
 
-                                                                                                if(xgmml)
+                                                                                                /* build the queued kinetic laws, output new SBML file, then tear down this network before the next one;
+                                                                                                 * a network with errors is not written, but the rest of the file is still checked
+                                                                                                 */
+                                                                                                if(ctx->lex.numErrors > ctx->errorsBefore)
+                                                                                                  skip_network(ctx);
+                                                                                                else
                                                                                                 {
-                                                                                                  /* output xgmml file for cytoscape */
-                                                                                                  sprintf(docbuf, "cytoscapeGraph_%dgenes_%d.xgmml", tot_genes, num_files-1);
-                                                                                                  cyto_graph = fopen(docbuf, "w");
-                                                                                                  if(!cyto_graph)
-                                                                                                  {
-                                                                                                    fprintf(stderr, "nemo2sbml: Error, failed to open %s for writing, continuing\n", docbuf);
-                                                                                                  }
-                                                                                                  else
+                                                                                                  if(!build_kinetic_laws(ctx))
                                                                                                   {
-                                                                                                    fprintf(cyto_graph, "<?xml version=\"1.0\"?>\n");
-                                                                                                    fprintf(cyto_graph, "<graph label=\"%s\" id=\"0\" xmlns=\"http://www.cs.rpi.edu/XGMML\">\n", docbuf);
-                                                                                                    fprintf(cyto_graph, "%s", cytoBuf);
-                                                                                                    fprintf(cyto_graph, "</graph>\n");
-                                                                                                    fclose (cyto_graph);
-                                                                                                    printf("XGMML document written: %s\n", docbuf);
+                                                                                                    yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
+                                                                                                    YYABORT;
                                                                                                   }
+                                                                                                  output_network(ctx);
+                                                                                                  reset_network(ctx);
                                                                                                 }
-                                                                                                
-                                                                                                firstP = 1;
-                                                                                                tot_genes = 0;
-                                                                                                parameterIndex = 0;
-                                                                                                rand_func = user_func = 0;
-                                                                                                
-                                                                                                //SBMLDocument_free(doc); /* why does this cause a segfault? */
-                                                                                                
-                                                                                                doc   = SBMLDocument_createWith(SBML_LEVEL, SBML_VERSION);
-                                                                                                model = SBMLDocument_createModel(doc);
- 
-                                                                                                compart = Model_createCompartment(model);
-                                                                                                Compartment_setId(compart, sid);
-                                                                                                Compartment_setVolume(compart, 1.0);
-
-                                                                                                /* cell volume is 10^-15 liters = 1 cubic micrometer = 1 femtoliter*/
-                                                                                                unitdef = Model_createUnitDefinition(model);
-                                                                                                UnitDefinition_setId(unitdef, "volume");
-                                                                                                UnitDefinition_setName(unitdef, "femtoliter");
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("litre"), 1, -15));
-  
-                                                                                                unitdef = Model_createUnitDefinition(model);
-                                                                                                UnitDefinition_setId(unitdef, "microM_cell");
-                                                                                                UnitDefinition_setName(unitdef, "microMole/cell");
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("mole"), 1, -6));
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("litre"), -1, -15));
-
-                                                                                                unitdef = Model_createUnitDefinition(model);
-                                                                                                UnitDefinition_setId(unitdef, "hill_coeff");
-                                                                                                UnitDefinition_setName(unitdef, "Hill Coefficient");
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("dimensionless"), 1, 0)); /* 1 to 4 */
-
-                                                                                                unitdef = Model_createUnitDefinition(model);
-                                                                                                UnitDefinition_setId(unitdef, "s_fl");
-                                                                                                UnitDefinition_setName(unitdef, "sec/femtoliter");
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("second"), 1, 0));
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("litre"), -1, -15));
-
-                                                                                                unitdef = Model_createUnitDefinition(model);
-                                                                                                UnitDefinition_setId(unitdef, "s_mole");
-                                                                                                UnitDefinition_setName(unitdef, "sec/microMole");
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("second"), 1, 0));
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("mole"), -1, -6));
-
-                                                                                                species = Model_createSpecies(model);
-                                                                                                Species_setId(species, "devNull");
-                                                                                                Species_setName(species, "devNull");
-                                                                                                Species_setCompartment(species, sid);
-                                                                                                Species_setInitialConcentration(species, 0.0);
-                                                                                                Species_setBoundaryCondition(species, 1);
-                                                                                                Species_setConstant(species, 1);
-                                                                                                
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed network:     [%s]\n", $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+
+                                                                                                /* only the latest network is kept, so $$ does not grow across networks */
+                                                                                                ctx->tmp = (char *) malloc(strlen($3) + 3);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
-                                                                                                
-                                                                                                strcpy(tmp, $1); strcat(tmp, "["); strcat(tmp, $3); strcat(tmp, "]");  
-                                                                                                $$ = tmp;
+
+                                                                                                strcpy(ctx->tmp, "["); strcat(ctx->tmp, $3); strcat(ctx->tmp, "]");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                               }
             | '[' tr_group ']'                                                                {
-                                                                                                /* output new SBML file */
-                                                                                                if(output[0])
-                                                                                                  sprintf(docbuf, "%s_%d", output, num_files++);
-                                                                                                else
-                                                                                                  sprintf(docbuf, "regulatoryNetwork_%dgenes_%d", tot_genes, num_files++);
-                                                                                                  
-                                                                                                Model_setId(model, docbuf);
-                                                                                                
-                                                                                                if(rand_func && user_func)
-                                                                                                  sprintf(modelname, "Synthetic Network: user specified input functions, and randomized parameters in generalized Hill Functions (nemo2sbml ver %s)", VERSION);
-                                                                                                else if(rand_func)
-                                                                                                  sprintf(modelname, "Synthetic Network: randomized parameters in generalized Hill Functions (nemo2sbml ver %s)", VERSION);
-                                                                                                else if(user_func)
-                                                                                                  sprintf(modelname, "Synthetic Network: user specified input functions (nemo2sbml ver %s)", VERSION);
-                                                                                                else /* probably shouldn't get here */
-                                                                                                  sprintf(modelname, "Synthetic Network: no input functions (nemo2sbml ver %s)", VERSION);
-                                                                                                
-                                                                                                Model_setName(model, modelname);
-                                                                                                
-                                                                                                strcat(docbuf, ".xml");
-                                                                                                if(writeSBML(doc, docbuf))
-                                                                                                  printf("SBML document written: %s\n", docbuf);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed network:     [%s]\n", $2);
+
+                                                                                                /* build the queued kinetic laws, output new SBML file, then tear down this network before the next one;
+                                                                                                 * a network with errors is not written, but the rest of the file is still checked
+                                                                                                 */
+                                                                                                if(ctx->lex.numErrors > ctx->errorsBefore)
+                                                                                                  skip_network(ctx);
                                                                                                 else
-                                                                                                  fprintf(stderr, "nemo2sbml: Error, failed to write SBML document %s\n", docbuf);
- 
-                                                                                                if(xgmml)
                                                                                                 {
-                                                                                                  /* output xgmml file for cytoscape */
-                                                                                                  sprintf(docbuf, "cytoscapeGraph_%dgenes_%d.xgmml", tot_genes, num_files-1);
-                                                                                                  cyto_graph = fopen(docbuf, "w");
-                                                                                                  if(!cyto_graph)
-                                                                                                  {
-                                                                                                    fprintf(stderr, "nemo2sbml: Error, failed to open %s for writing, continuing\n", docbuf);
-                                                                                                  }
-                                                                                                  else
+                                                                                                  if(!build_kinetic_laws(ctx))
                                                                                                   {
-                                                                                                    fprintf(cyto_graph, "<?xml version=\"1.0\"?>\n");
-                                                                                                    fprintf(cyto_graph, "<graph label=\"%s\" id=\"0\" xmlns=\"http://www.cs.rpi.edu/XGMML\">\n", docbuf);
-                                                                                                    fprintf(cyto_graph, "%s", cytoBuf);
-                                                                                                    fprintf(cyto_graph, "</graph>\n");
-                                                                                                    fclose (cyto_graph);
-                                                                                                    printf("XGMML document written: %s\n", docbuf);
+                                                                                                    yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
+                                                                                                    YYABORT;
                                                                                                   }
+                                                                                                  output_network(ctx);
+                                                                                                  reset_network(ctx);
                                                                                                 }
-                                                                                                
-                                                                                                firstP = 1;
-                                                                                                tot_genes = 0;
-                                                                                                parameterIndex = 0;
-                                                                                                rand_func = user_func = 0;
-                                                                                                
-                                                                                                //SBMLDocument_free(doc); /* why does this cause a segfault? */
-                                                                                                
-                                                                                                doc   = SBMLDocument_createWith(2, 1);
-                                                                                                model = SBMLDocument_createModel(doc);
- 
-                                                                                                compart = Model_createCompartment(model);
-                                                                                                Compartment_setId(compart, sid);
-                                                                                                Compartment_setVolume(compart, 1.0);
-
-                                                                                                /* cell volume is 10^-15 liters = 1 cubic micrometer = 1 femtoliter*/
-                                                                                                unitdef = Model_createUnitDefinition(model);
-                                                                                                UnitDefinition_setId(unitdef, "volume");
-                                                                                                UnitDefinition_setName(unitdef, "femtoliter");
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("litre"), 1, -15));
-  
-                                                                                                unitdef = Model_createUnitDefinition(model);
-                                                                                                UnitDefinition_setId(unitdef, "microM_cell");
-                                                                                                UnitDefinition_setName(unitdef, "microMole/cell");
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("mole"), 1, -6));
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("litre"), -1, -15));
-
-                                                                                                unitdef = Model_createUnitDefinition(model);
-                                                                                                UnitDefinition_setId(unitdef, "hill_coeff");
-                                                                                                UnitDefinition_setName(unitdef, "Hill Coefficient");
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("dimensionless"), 1, 0)); /* 1 to 4 */
-
-                                                                                                unitdef = Model_createUnitDefinition(model);
-                                                                                                UnitDefinition_setId(unitdef, "s_fl");
-                                                                                                UnitDefinition_setName(unitdef, "sec/femtoliter");
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("second"), 1, 0));
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("litre"), -1, -15));
-
-                                                                                                unitdef = Model_createUnitDefinition(model);
-                                                                                                UnitDefinition_setId(unitdef, "s_mole");
-                                                                                                UnitDefinition_setName(unitdef, "sec/microMole");
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("second"), 1, 0));
-                                                                                                UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("mole"), -1, -6));
-
-                                                                                                species = Model_createSpecies(model);
-                                                                                                Species_setId(species, "devNull");
-                                                                                                Species_setName(species, "devNull");
-                                                                                                Species_setCompartment(species, sid);
-                                                                                                Species_setInitialConcentration(species, 0.0);
-                                                                                                Species_setBoundaryCondition(species, 1);
-                                                                                                Species_setConstant(species, 1);
-                                                                                                
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed network:     [%s]\n", $2);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($2) + 3);
-                                                                                                if(!tmp)
+
+                                                                                                ctx->tmp = (char *) malloc(strlen($2) + 3);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
-                                                                                                
-                                                                                                strcpy(tmp, "["); strcat(tmp, $2); strcat(tmp, "]");  
-                                                                                                $$ = tmp;
+
+                                                                                                strcpy(ctx->tmp, "["); strcat(ctx->tmp, $2); strcat(ctx->tmp, "]");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($2);
                                                                                               }
+            | start '[' error ']'                                                             {
+                                                                                                /* a syntax error: skip to the end of this network, and go on with the next */
+                                                                                                skip_network(ctx);
+                                                                                                yyerrok;
+                                                                                                $$ = $1;
+                                                                                              }
+            | '[' error ']'                                                                   {
+                                                                                                skip_network(ctx);
+                                                                                                yyerrok;
+                                                                                                
+                                                                                                $$ = (char *) malloc(3);
+                                                                                                if(!$$)
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                strcpy($$, "[]");
+                                                                                              }
             ; 
 tr_group    : tr_group ',' dor                                                                {
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed tr_group:    %s, %s\n", $1, $3);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 2);
-                                                                                                if(!tmp)
+                                                                                                law_cache_note(ctx, 'D', $3);
+                                                                                                
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + 2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, ","); strcat(tmp, $3); 
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, ","); strcat(ctx->tmp, $3); 
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                               }
             | tr_group ',' GLIST '(' gene_list ')'                                            {
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed tr_group:    %s, GLIST(%s)\n", $1, $5);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($5) + 4);
-                                                                                                if(!tmp)
+                                                                                                law_cache_note(ctx, 'G', $5);
+                                                                                                
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($5) + 4);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);  strcat(tmp, ","); strcat(tmp, $3);
-                                                                                                strcat(tmp, "("); strcat(tmp, $5);  strcat(tmp, ")");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);  strcat(ctx->tmp, ","); strcat(ctx->tmp, $3);
+                                                                                                strcat(ctx->tmp, "("); strcat(ctx->tmp, $5);  strcat(ctx->tmp, ")");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($5);
                                                                                               }
             | tr_group ',' TMLIST '(' tmotif_list ')'                                         {
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed tr_group:    %s, TMLIST(%s)\n", $1, $5);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($5) + 4);
-                                                                                                if(!tmp)
+                                                                                                law_cache_note(ctx, 'T', $5);
+                                                                                                
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($5) + 4);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);  strcat(tmp, ","); strcat(tmp, $3);
-                                                                                                strcat(tmp, "("); strcat(tmp, $5);  strcat(tmp, ")");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);  strcat(ctx->tmp, ","); strcat(ctx->tmp, $3);
+                                                                                                strcat(ctx->tmp, "("); strcat(ctx->tmp, $5);  strcat(ctx->tmp, ")");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($5);
                                                                                               }
             | dor                                                                             {
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed tr_group:    %s\n", $1);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + 2);
-                                                                                                if(!tmp)
+                                                                                                law_cache_note(ctx, 'D', $1);
+                                                                                                
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + 2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                               }
             | GLIST '(' gene_list ')'                                                         {
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed tr_group:    GLIST(%s)\n", $3);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                law_cache_note(ctx, 'G', $3);
+                                                                                                
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, "("); strcat(ctx->tmp, $3);
+                                                                                                strcat(ctx->tmp, ")");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($3);
                                                                                               }
             | TMLIST '(' tmotif_list ')'                                                      {
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed tr_group:    TMLIST(%s)\n", $3);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                law_cache_note(ctx, 'T', $3);
+                                                                                                
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, "("); strcat(ctx->tmp, $3);
+                                                                                                strcat(ctx->tmp, ")");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($3);
                                                                                               }
+            | tr_group ',' error                                                              {
+                                                                                                /* resynchronize at the next motif group */
+                                                                                                ctx->itemJob = ctx->numHillJobs;
+                                                                                                $$ = $1;
+                                                                                              }
             ;
 dor         : DOR '(' gene_list ')'                                                           {
                                                                                                 /* the graph of transcription factors and genes in a dor
                                                                                                  * (dense overlapping regulon) is connected, and consists
                                                                                                  * of at least two genes; check for that here.
                                                                                                  */
-                                                                                                if(check_dor($3))
+                                                                                                if(check_dor_cached(ctx, $3))
                                                                                                 {
-                                                                                                  if(parseInfo)
+                                                                                                  if(ctx->parseInfo)
                                                                                                     printf("parsed dor:         DOR(%s)\n", $3);
                                                                                                     
-                                                                                                  tmp = (char *) malloc(strlen($3) + 6);
-                                                                                                  if(!tmp)
+                                                                                                  ctx->tmp = (char *) malloc(strlen($3) + 6);
+                                                                                                  if(!ctx->tmp)
                                                                                                   {
-                                                                                                    yyerror("malloc error, exiting...");
+                                                                                                    yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                     YYABORT;
                                                                                                   }
                                                                                                 
-                                                                                                  strcpy(tmp, "DOR("); strcat(tmp, $3); strcat(tmp, ")");
-                                                                                                  $$ = tmp;
+                                                                                                  strcpy(ctx->tmp, "DOR("); strcat(ctx->tmp, $3); strcat(ctx->tmp, ")");
+                                                                                                  $$ = ctx->tmp;
                                                                                                   free($3);
                                                                                                 }
                                                                                                 else
                                                                                                 {
-                                                                                                  yyerror("DOR graph error.");
-                                                                                                  YYABORT;
+                                                                                                  nemo_error(&ctx->lex, ctx->lex.dorLine, ctx->lex.dorCol, "Error: DOR graph error");
+                                                                                                  $$ = $3;
                                                                                                 }
                                                                                               }
             ;
 gene_list   : gene_list ',' gene '(' p_list')'                                                {
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, transcriptionFactors);
-                                                                                                  xgmmlXML($3, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->transcriptionFactors);
+                                                                                                  xgmmlXML(ctx, $3, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
                                                                                                 /* instantiate Kinetic Law */
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = randomGeneralizedHill($3, transcriptionFactors);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                if(!randomGeneralizedHill(ctx, $3, ctx->transcriptionFactors))
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kineticLawString);
-                                                                                                  free(kineticLawString);
-                                                                                                }
-                                                                                                else
-                                                                                                {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
+                                                                                                  yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                rand_func = 1;
-                                                                                                firstP  = 1;
-                                                                                                num_sgn = 0;
-                                                                                                transcriptionFactors[0] = 0x0;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->rand_func = 1;
+                                                                                                ctx->firstP  = 1;
+                                                                                                ctx->num_sgn = 0;
+                                                                                                ctx->transcriptionFactors[0] = 0x0;
 
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed gene_list:   %s, %s(%s)\n", $1, $3, $5);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($5) + 4);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($5) + 4);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);  strcat(tmp, ","); strcat(tmp, $3); 
-                                                                                                strcat(tmp, "("); strcat(tmp, $5);  strcat(tmp, ")");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);  strcat(ctx->tmp, ","); strcat(ctx->tmp, $3); 
+                                                                                                strcat(ctx->tmp, "("); strcat(ctx->tmp, $5);  strcat(ctx->tmp, ")");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                                 free($5);
                                                                                               }
             | gene_list ',' gene '(' p_list ':' 'F' '(' expr ')' ')'                          {
-                                                                                                if(xgmml)
+                                                                                                ctx->fText[0] = expr_formula(&ctx->syms, $9);
+                                                                                                if(!ctx->fText[0])
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, transcriptionFactors);
-                                                                                                  xgmmlXML($3, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->transcriptionFactors);
+                                                                                                  xgmmlXML(ctx, $3, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
                                                                                                 /* instantiate Kinetic Law */
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = explicitKineticLaw($3, transcriptionFactors, $9);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                ctx->kLSp = explicitKineticLaw(ctx, $3, ctx->transcriptionFactors, $9);
+                                                                                                if(ctx->kLSp)
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kLSp);
-                                                                                                  free(kLSp);
+                                                                                                  KineticLaw_setFormula(ctx->kl, ctx->kLSp);
+                                                                                                  free(ctx->kLSp);
                                                                                                 }
                                                                                                 else
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
-                                                                                                  YYABORT;
+                                                                                                  yyerror(scanner, ctx, "Error: bad F() kinetic law");
+                                                                                                  drop_reaction(ctx);
+                                                                                                  free($1);
+                                                                                                  free($3);
+                                                                                                  free($5);
+                                                                                                  free(ctx->fText[0]); expr_free($9);
+                                                                                                  YYERROR;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                user_func = 1;
-                                                                                                firstP  = 1;
-                                                                                                num_sgn = 0;
-                                                                                                transcriptionFactors[0] = 0x0;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->user_func = 1;
+                                                                                                ctx->firstP  = 1;
+                                                                                                ctx->num_sgn = 0;
+                                                                                                ctx->transcriptionFactors[0] = 0x0;
 
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed gene_list:   %s, %s(%s:F(%s))\n", $1, $3, $5, $9);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed gene_list:   %s, %s(%s:F(%s))\n", $1, $3, $5, ctx->fText[0]);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($5) + strlen($9) + 8);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($5) + strlen(ctx->fText[0]) + 8);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);  strcat(tmp, ","); strcat(tmp, $3); 
-                                                                                                strcat(tmp, "("); strcat(tmp, $5);  strcat(tmp, ":F(");
-                                                                                                strcat(tmp, $9);  strcat(tmp, "))");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);  strcat(ctx->tmp, ","); strcat(ctx->tmp, $3); 
+                                                                                                strcat(ctx->tmp, "("); strcat(ctx->tmp, $5);  strcat(ctx->tmp, ":F(");
+                                                                                                strcat(ctx->tmp, ctx->fText[0]);  strcat(ctx->tmp, "))");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                                 free($5);
-                                                                                                free($9);
+                                                                                                free(ctx->fText[0]); expr_free($9);
                                                                                               }
             | gene '(' p_list')'                                                              {
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, transcriptionFactors);
-                                                                                                  xgmmlXML($1, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->transcriptionFactors);
+                                                                                                  xgmmlXML(ctx, $1, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
                                                                                                 /* instantiate Kinetic Law */
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = randomGeneralizedHill($1, transcriptionFactors);
-                                                                                                if(kLSp)
-                                                                                                {
-                                                                                                  KineticLaw_setFormula(kl, kineticLawString);
-                                                                                                  free(kineticLawString);
-                                                                                                }
-                                                                                                else
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                if(!randomGeneralizedHill(ctx, $1, ctx->transcriptionFactors))
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
+                                                                                                  yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                rand_func = 1;
-                                                                                                firstP  = 1;
-                                                                                                num_sgn = 0;
-                                                                                                transcriptionFactors[0] = 0x0;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->rand_func = 1;
+                                                                                                ctx->firstP  = 1;
+                                                                                                ctx->num_sgn = 0;
+                                                                                                ctx->transcriptionFactors[0] = 0x0;
 
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed gene_list:   %s(%s)\n", $1, $3);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, "("); strcat(ctx->tmp, $3);
+                                                                                                strcat(ctx->tmp, ")");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                               }
             | gene '(' p_list ':' 'F' '(' expr ')' ')'                                        {
-                                                                                                if(xgmml)
+                                                                                                ctx->fText[0] = expr_formula(&ctx->syms, $7);
+                                                                                                if(!ctx->fText[0])
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, transcriptionFactors);
-                                                                                                  xgmmlXML($1, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->transcriptionFactors);
+                                                                                                  xgmmlXML(ctx, $1, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
                                                                                                 /* instantiate Kinetic Law */
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = explicitKineticLaw($1, transcriptionFactors, $7);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                ctx->kLSp = explicitKineticLaw(ctx, $1, ctx->transcriptionFactors, $7);
+                                                                                                if(ctx->kLSp)
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kLSp);
-                                                                                                  free(kLSp);
+                                                                                                  KineticLaw_setFormula(ctx->kl, ctx->kLSp);
+                                                                                                  free(ctx->kLSp);
                                                                                                 }
                                                                                                 else
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
-                                                                                                  YYABORT;
+                                                                                                  yyerror(scanner, ctx, "Error: bad F() kinetic law");
+                                                                                                  drop_reaction(ctx);
+                                                                                                  free($1);
+                                                                                                  free($3);
+                                                                                                  free(ctx->fText[0]); expr_free($7);
+                                                                                                  YYERROR;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                user_func = 1;
-                                                                                                firstP  = 1;
-                                                                                                num_sgn = 0;
-                                                                                                transcriptionFactors[0] = 0x0;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->user_func = 1;
+                                                                                                ctx->firstP  = 1;
+                                                                                                ctx->num_sgn = 0;
+                                                                                                ctx->transcriptionFactors[0] = 0x0;
 
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed gene_list:   %s(%s:F(%s))\n", $1, $3, $7);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed gene_list:   %s(%s:F(%s))\n", $1, $3, ctx->fText[0]);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($7) + 7);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + strlen(ctx->fText[0]) + 7);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);    strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ":F("); strcat(tmp, $7);  strcat(tmp, "))");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);    strcat(ctx->tmp, "("); strcat(ctx->tmp, $3);
+                                                                                                strcat(ctx->tmp, ":F("); strcat(ctx->tmp, ctx->fText[0]);  strcat(ctx->tmp, "))");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
-                                                                                                free($7);
+                                                                                                free(ctx->fText[0]); expr_free($7);
+                                                                                              }
+            | gene_list ',' error                                                             {
+                                                                                                /* resynchronize at the next gene */
+                                                                                                ctx->firstP  = 1;
+                                                                                                ctx->num_sgn = 0;
+                                                                                                ctx->transcriptionFactors[0] = 0x0;
+                                                                                                $$ = $1;
                                                                                               }
             ;
 tmotif_list : tmotif_list ',' tmotif                                                          {
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed tmotif_list: %s, %s\n", $1, $3);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 2);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + 2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, ","); strcat(tmp, $3);
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, ","); strcat(ctx->tmp, $3);
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                               }
             | tmotif                                                                          {
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed tmotif_list: %s\n", $1);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + 1);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + 1);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                               }
+            | tmotif_list ',' error                                                           {
+                                                                                                /* resynchronize at the next motif */
+                                                                                                $$ = $1;
+                                                                                              }
             ;
 tmotif      : ff_loop                                                                         {
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed tmotif:      %s\n", $1);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + 1);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + 1);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                               }
             | multi_out                                                                       {
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed tmotif:      %s\n", $1);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + 1);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + 1);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                               }
             | sim                                                                             {
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed tmotif:      %s\n", $1);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + 1);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + 1);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                               }
             ;
 p_list      : p_list ',' protein '+'                                                          {
-                                                                                                if(firstP)
+                                                                                                if(ctx->firstP)
                                                                                                 {
-                                                                                                  strcpy(transcriptionFactors, "+");
-                                                                                                  firstP = 0;
+                                                                                                  strcpy(ctx->transcriptionFactors, "+");
+                                                                                                  ctx->firstP = 0;
                                                                                                 }
                                                                                                 else
-                                                                                                  strcat(transcriptionFactors, "+");
+                                                                                                  strcat(ctx->transcriptionFactors, "+");
 
-                                                                                                strcat(transcriptionFactors, $3);
-                                                                                                strcat(transcriptionFactors, ",");
+                                                                                                strcat(ctx->transcriptionFactors, $3);
+                                                                                                strcat(ctx->transcriptionFactors, ",");
 
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed p_list:      %s, %s+\n", $1, $3);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, ","); strcat(tmp, $3); 
-                                                                                                strcat(tmp, "+");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, ","); strcat(ctx->tmp, $3); 
+                                                                                                strcat(ctx->tmp, "+");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                               }
             | p_list ',' protein '-'                                                          {
-                                                                                                if(firstP)
+                                                                                                if(ctx->firstP)
                                                                                                 {
-                                                                                                  strcpy(transcriptionFactors, "-");
-                                                                                                  firstP = 0;
+                                                                                                  strcpy(ctx->transcriptionFactors, "-");
+                                                                                                  ctx->firstP = 0;
                                                                                                 }
                                                                                                 else
-                                                                                                  strcat(transcriptionFactors, "-");
+                                                                                                  strcat(ctx->transcriptionFactors, "-");
 
-                                                                                                strcat(transcriptionFactors, $3);
-                                                                                                strcat(transcriptionFactors, ",");
+                                                                                                strcat(ctx->transcriptionFactors, $3);
+                                                                                                strcat(ctx->transcriptionFactors, ",");
 
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed p_list:      %s, %s-\n", $1, $3);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, ","); strcat(tmp, $3); 
-                                                                                                strcat(tmp, "-");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, ","); strcat(ctx->tmp, $3); 
+                                                                                                strcat(ctx->tmp, "-");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                               }
             | p_list ',' p_error                                                              {
-                                                                                                yyerror("Error: PROTEIN must be followed by '+' or '-'\n"); YYABORT;
+                                                                                                yyerror(scanner, ctx, "Error: %s must be followed by '+' or '-'", $3); free($1); free($3); $$ = 0x0; YYERROR;
                                                                                               }
             | protein '+'                                                                     {
-                                                                                                if(firstP)
+                                                                                                if(ctx->firstP)
                                                                                                 {
-                                                                                                  strcpy(transcriptionFactors, "+");
-                                                                                                  firstP = 0;
+                                                                                                  strcpy(ctx->transcriptionFactors, "+");
+                                                                                                  ctx->firstP = 0;
                                                                                                 }
                                                                                                 else
-                                                                                                  strcat(transcriptionFactors, "+");
+                                                                                                  strcat(ctx->transcriptionFactors, "+");
  
-                                                                                                strcat(transcriptionFactors, $1);
-                                                                                                strcat(transcriptionFactors, ",");
+                                                                                                strcat(ctx->transcriptionFactors, $1);
+                                                                                                strcat(ctx->transcriptionFactors, ",");
   
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed p_list:      %s+\n", $1);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + 2);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + 2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "+");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, "+");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                               }
             | protein '-'                                                                     {
-                                                                                                if(firstP)
+                                                                                                if(ctx->firstP)
                                                                                                 {
-                                                                                                  strcpy(transcriptionFactors, "-");
-                                                                                                  firstP = 0;
+                                                                                                  strcpy(ctx->transcriptionFactors, "-");
+                                                                                                  ctx->firstP = 0;
                                                                                                 }
                                                                                                 else
-                                                                                                  strcat(transcriptionFactors, "-");
+                                                                                                  strcat(ctx->transcriptionFactors, "-");
   
-                                                                                                strcat(transcriptionFactors, $1);
-                                                                                                strcat(transcriptionFactors, ",");
+                                                                                                strcat(ctx->transcriptionFactors, $1);
+                                                                                                strcat(ctx->transcriptionFactors, ",");
 
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed p_list:      %s-\n", $1);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + 2);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + 2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "-");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, "-");
+                                                                                                $$ = ctx->tmp;
                                                                                               }
             | p_error                                                                         {
-                                                                                                yyerror("Error: %s must be followed by '+' or '-'\n", $1); YYABORT;
+                                                                                                yyerror(scanner, ctx, "Error: %s must be followed by '+' or '-'", $1); free($1); $$ = 0x0; YYERROR;
                                                                                               }
             ;
 ff_loop     : protein '(' sgn gene sgn gene sgn ')'                                           { /* instantiate 2 Kinetic Laws */
-                                                                                                sprintf(temp, "%c%s;", sgn0, $1);
+                                                                                                sprintf(ctx->temp, "%c%s;", ctx->sgn0, $1);
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($4, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $4, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = randomGeneralizedHill($4, temp);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                if(!randomGeneralizedHill(ctx, $4, ctx->temp))
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kineticLawString);
-                                                                                                  free(kineticLawString);
-                                                                                                }
-                                                                                                else
-                                                                                                {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
+                                                                                                  yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
                                               
-                                                                                                sprintf(temp, "%cP%s;%c%s;", sgn1, $4+1, sgn2, $1);
+                                                                                                sprintf(ctx->temp, "%cP%s;%c%s;", ctx->sgn1, $4+1, ctx->sgn2, $1);
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($6, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $6, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = randomGeneralizedHill($6, temp);
-                                                                                                if(kLSp)
-                                                                                                {
-                                                                                                  KineticLaw_setFormula(kl, kineticLawString);
-                                                                                                  free(kineticLawString);
-                                                                                                }
-                                                                                                else
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                if(!randomGeneralizedHill(ctx, $6, ctx->temp))
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
+                                                                                                  yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                rand_func = 1;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->rand_func = 1;
                                                                                                 
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed ff_loop:     %s(%s%s%s%s%s)\n", $1, $3, $4, $5, $6, $7);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($4) + strlen($5) + 
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($4) + strlen($5) + 
                                                                                                                       strlen($6) + strlen($7) + 3);
-                                                                                                if(!tmp)
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3); 
-                                                                                                strcat(tmp, $4); strcat(tmp, $5);  strcat(tmp, $6);
-                                                                                                strcat(tmp, $7); strcat(tmp, ")");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, "("); strcat(ctx->tmp, $3); 
+                                                                                                strcat(ctx->tmp, $4); strcat(ctx->tmp, $5);  strcat(ctx->tmp, $6);
+                                                                                                strcat(ctx->tmp, $7); strcat(ctx->tmp, ")");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                                 free($4);
@@ -918,74 +1057,83 @@ ff_loop     : protein '(' sgn gene sgn gene sgn ')'
                                                                                                 free($7);
                                                                                               }
             | protein '(' 'F' '(' expr ')' ':' sgn gene sgn gene sgn ')'                      { /* instantiate 2 Kinetic Laws */
-                                                                                                sprintf(temp, "%c%s;", sgn0, $1);
+                                                                                                ctx->fText[0] = expr_formula(&ctx->syms, $5);
+                                                                                                if(!ctx->fText[0])
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                
+                                                                                                sprintf(ctx->temp, "%c%s;", ctx->sgn0, $1);
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($9, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $9, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = explicitKineticLaw($9, temp, $5);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                ctx->kLSp = explicitKineticLaw(ctx, $9, ctx->temp, $5);
+                                                                                                if(ctx->kLSp)
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kLSp);
-                                                                                                  free(kLSp);
+                                                                                                  KineticLaw_setFormula(ctx->kl, ctx->kLSp);
+                                                                                                  free(ctx->kLSp);
                                                                                                 }
                                                                                                 else
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
-                                                                                                  YYABORT;
+                                                                                                  yyerror(scanner, ctx, "Error: bad F() kinetic law");
+                                                                                                  drop_reaction(ctx);
+                                                                                                  free($1);
+                                                                                                  free($8);
+                                                                                                  free($9);
+                                                                                                  free($10);
+                                                                                                  free($11);
+                                                                                                  free($12);
+                                                                                                  free(ctx->fText[0]); expr_free($5);
+                                                                                                  YYERROR;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                user_func = 1;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->user_func = 1;
 
-                                                                                                sprintf(temp, "%cP%s;%c%s;", sgn1, $9+1, sgn2, $1);
+                                                                                                sprintf(ctx->temp, "%cP%s;%c%s;", ctx->sgn1, $9+1, ctx->sgn2, $1);
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($11, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $11, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = randomGeneralizedHill($11, temp);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                if(!randomGeneralizedHill(ctx, $11, ctx->temp))
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kineticLawString);
-                                                                                                  free(kineticLawString);
-                                                                                                }
-                                                                                                else
-                                                                                                {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
+                                                                                                  yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                rand_func = 1;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->rand_func = 1;
                                                                                                 
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed ff_loop:     %s(F(%s):%s%s%s%s%s)\n", $1, $5, $8, $9, $10, $11, $12);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed ff_loop:     %s(F(%s):%s%s%s%s%s)\n", $1, ctx->fText[0], $8, $9, $10, $11, $12);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($5) + strlen($8) + strlen($9) + 
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen(ctx->fText[0]) + strlen($8) + strlen($9) + 
                                                                                                                       strlen($10)+ strlen($11)+ strlen($12)+ 7);
-                                                                                                if(!tmp)
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);   strcat(tmp, "(F("); strcat(tmp, $5);
-                                                                                                strcat(tmp, "):"); strcat(tmp, $8);    strcat(tmp, $9);
-                                                                                                strcat(tmp, $10);  strcat(tmp, $11);   strcat(tmp, $12);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);   strcat(ctx->tmp, "(F("); strcat(ctx->tmp, ctx->fText[0]);
+                                                                                                strcat(ctx->tmp, "):"); strcat(ctx->tmp, $8);    strcat(ctx->tmp, $9);
+                                                                                                strcat(ctx->tmp, $10);  strcat(ctx->tmp, $11);   strcat(ctx->tmp, $12);
+                                                                                                strcat(ctx->tmp, ")");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
-                                                                                                free($5);
+                                                                                                free(ctx->fText[0]); expr_free($5);
                                                                                                 free($8);
                                                                                                 free($9);
                                                                                                 free($10);
@@ -993,254 +1141,285 @@ ff_loop     : protein '(' sgn gene sgn gene sgn ')'
                                                                                                 free($12);
                                                                                               }
             | protein '(' sgn gene sgn gene sgn ':' 'F' '(' expr ')' ')'                      {
-                                                                                                /* instantiate 2 Kinetic Laws */
-                                                                                                sprintf(temp, "%c%s;", sgn0, $1);
-                                                                                                
-                                                                                                if(xgmml)
+                                                                                                ctx->fText[0] = expr_formula(&ctx->syms, $11);
+                                                                                                if(!ctx->fText[0])
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($4, xgmmlTmp);
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = randomGeneralizedHill($4, temp);
-                                                                                                if(kLSp)
+                                                                                                /* instantiate 2 Kinetic Laws */
+                                                                                                sprintf(ctx->temp, "%c%s;", ctx->sgn0, $1);
+                                                                                                
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kineticLawString);
-                                                                                                  free(kineticLawString);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $4, ctx->xgmmlTmp);
                                                                                                 }
-                                                                                                else
+                                                                                                
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                if(!randomGeneralizedHill(ctx, $4, ctx->temp))
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
+                                                                                                  yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                rand_func = 1;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->rand_func = 1;
                                               
-                                                                                                sprintf(temp, "%cP%s;%c%s;", sgn1, $4+1, sgn2, $1);
+                                                                                                sprintf(ctx->temp, "%cP%s;%c%s;", ctx->sgn1, $4+1, ctx->sgn2, $1);
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($6, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $6, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = explicitKineticLaw($6, temp, $11);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                ctx->kLSp = explicitKineticLaw(ctx, $6, ctx->temp, $11);
+                                                                                                if(ctx->kLSp)
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kLSp);
-                                                                                                  free(kLSp);
+                                                                                                  KineticLaw_setFormula(ctx->kl, ctx->kLSp);
+                                                                                                  free(ctx->kLSp);
                                                                                                 }
                                                                                                 else
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
-                                                                                                  YYABORT;
+                                                                                                  yyerror(scanner, ctx, "Error: bad F() kinetic law");
+                                                                                                  drop_reaction(ctx);
+                                                                                                  free($1);
+                                                                                                  free($3);
+                                                                                                  free($4);
+                                                                                                  free($5);
+                                                                                                  free($6);
+                                                                                                  free($7);
+                                                                                                  free(ctx->fText[0]); expr_free($11);
+                                                                                                  YYERROR;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                user_func = 1;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->user_func = 1;
                                                                                                 
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed ff_loop:     %s(%s%s%s%s%s:F(%s))\n", $1, $3, $4, $5, $6, $7, $11);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed ff_loop:     %s(%s%s%s%s%s:F(%s))\n", $1, $3, $4, $5, $6, $7, ctx->fText[0]);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($4) + strlen($5) + 
-                                                                                                                      strlen($6) + strlen($7) + strlen($11)+ 7);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($4) + strlen($5) + 
+                                                                                                                      strlen($6) + strlen($7) + strlen(ctx->fText[0])+ 7);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);  strcat(tmp, "(");   strcat(tmp, $3);
-                                                                                                strcat(tmp, $4);  strcat(tmp, $5);    strcat(tmp, $6);
-                                                                                                strcat(tmp, $7);  strcat(tmp, ":F("); strcat(tmp, $11);
-                                                                                                strcat(tmp, "))");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);  strcat(ctx->tmp, "(");   strcat(ctx->tmp, $3);
+                                                                                                strcat(ctx->tmp, $4);  strcat(ctx->tmp, $5);    strcat(ctx->tmp, $6);
+                                                                                                strcat(ctx->tmp, $7);  strcat(ctx->tmp, ":F("); strcat(ctx->tmp, ctx->fText[0]);
+                                                                                                strcat(ctx->tmp, "))");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                                 free($4);
                                                                                                 free($5);
                                                                                                 free($6);
                                                                                                 free($7);
-                                                                                                free($11);
+                                                                                                free(ctx->fText[0]); expr_free($11);
                                                                                               }
             | protein '(' 'F' '(' expr ')' ':' sgn gene sgn gene sgn ':' 'F' '(' expr ')' ')' { /* instantiate 2 Kinetic Laws */
-                                                                                                sprintf(temp, "%c%s;", sgn0, $1);
+                                                                                                ctx->fText[0] = expr_formula(&ctx->syms, $5);
+                                                                                                if(!ctx->fText[0])
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                
+                                                                                                ctx->fText[1] = expr_formula(&ctx->syms, $16);
+                                                                                                if(!ctx->fText[1])
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                sprintf(ctx->temp, "%c%s;", ctx->sgn0, $1);
+                                                                                                
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($9, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $9, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = explicitKineticLaw($9, temp, $5);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                ctx->kLSp = explicitKineticLaw(ctx, $9, ctx->temp, $5);
+                                                                                                if(ctx->kLSp)
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kLSp);
-                                                                                                  free(kLSp);
+                                                                                                  KineticLaw_setFormula(ctx->kl, ctx->kLSp);
+                                                                                                  free(ctx->kLSp);
                                                                                                 }
                                                                                                 else
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
-                                                                                                  YYABORT;
+                                                                                                  yyerror(scanner, ctx, "Error: bad F() kinetic law");
+                                                                                                  drop_reaction(ctx);
+                                                                                                  free($1);
+                                                                                                  free($8);
+                                                                                                  free($9);
+                                                                                                  free($10);
+                                                                                                  free($11);
+                                                                                                  free($12);
+                                                                                                  free(ctx->fText[0]); expr_free($5);
+                                                                                                  free(ctx->fText[1]); expr_free($16);
+                                                                                                  YYERROR;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
                                               
-                                                                                                sprintf(temp, "%cP%s;%c%s;", sgn1, $9+1, sgn2, $1);
+                                                                                                sprintf(ctx->temp, "%cP%s;%c%s;", ctx->sgn1, $9+1, ctx->sgn2, $1);
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($11, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $11, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = explicitKineticLaw($11, temp, $16);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                ctx->kLSp = explicitKineticLaw(ctx, $11, ctx->temp, $16);
+                                                                                                if(ctx->kLSp)
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kLSp);
-                                                                                                  free(kLSp);
+                                                                                                  KineticLaw_setFormula(ctx->kl, ctx->kLSp);
+                                                                                                  free(ctx->kLSp);
                                                                                                 }
                                                                                                 else
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
-                                                                                                  YYABORT;
+                                                                                                  yyerror(scanner, ctx, "Error: bad F() kinetic law");
+                                                                                                  drop_reaction(ctx);
+                                                                                                  free($1);
+                                                                                                  free($8);
+                                                                                                  free($9);
+                                                                                                  free($10);
+                                                                                                  free($11);
+                                                                                                  free($12);
+                                                                                                  free(ctx->fText[0]); expr_free($5);
+                                                                                                  free(ctx->fText[1]); expr_free($16);
+                                                                                                  YYERROR;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                user_func = 1;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->user_func = 1;
                                                                                                 
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed ff_loop:     %s(F(%s):%s%s%s%s%s:F(%s))\n", $1, $5, $8, $9, $10, $11, $12, $16);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed ff_loop:     %s(F(%s):%s%s%s%s%s:F(%s))\n", $1, ctx->fText[0], $8, $9, $10, $11, $12, ctx->fText[1]);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($5) + strlen($8) + strlen($9) + 
-                                                                                                                      strlen($10)+ strlen($11)+ strlen($12)+ strlen($16)+ 11);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen(ctx->fText[0]) + strlen($8) + strlen($9) + 
+                                                                                                                      strlen($10)+ strlen($11)+ strlen($12)+ strlen(ctx->fText[1])+ 11);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);    strcat(tmp, "(F("); strcat(tmp, $5);
-                                                                                                strcat(tmp, "):");  strcat(tmp, $8);    strcat(tmp, $9);
-                                                                                                strcat(tmp, $10);   strcat(tmp, $11);   strcat(tmp, $12);
-                                                                                                strcat(tmp, ":F("); strcat(tmp, $16);   strcat(tmp, "))");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);    strcat(ctx->tmp, "(F("); strcat(ctx->tmp, ctx->fText[0]);
+                                                                                                strcat(ctx->tmp, "):");  strcat(ctx->tmp, $8);    strcat(ctx->tmp, $9);
+                                                                                                strcat(ctx->tmp, $10);   strcat(ctx->tmp, $11);   strcat(ctx->tmp, $12);
+                                                                                                strcat(ctx->tmp, ":F("); strcat(ctx->tmp, ctx->fText[1]);   strcat(ctx->tmp, "))");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
-                                                                                                free($5);
+                                                                                                free(ctx->fText[0]); expr_free($5);
                                                                                                 free($8);
                                                                                                 free($9);
                                                                                                 free($10);
                                                                                                 free($11);
                                                                                                 free($12);
-                                                                                                free($16);
+                                                                                                free(ctx->fText[1]); expr_free($16);
                                                                                               }
             ;
 multi_out   : protein '(' sgn gene sgn pg ')' sgn ')'                                         { /* instantiate >= 2 Kinetic Laws */
-                                                                                                sprintf(temp, "%s%s;", $3, $1);
+                                                                                                sprintf(ctx->temp, "%s%s;", $3, $1);
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($4, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $4, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = randomGeneralizedHill($4, temp);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                if(!randomGeneralizedHill(ctx, $4, ctx->temp))
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kineticLawString);
-                                                                                                  free(kineticLawString);
-                                                                                                }
-                                                                                                else
-                                                                                                {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
+                                                                                                  yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                rand_func = 1;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->rand_func = 1;
                                                                                                 
                                                                                                 /* 1 Kinetic Law for each gene in pg */
-                                                                                                strcpy(pg, $6+1);
-                                                                                                pgp = pg;
-                                                                                                pt = strsep(&pgp, ",");
-                                                                                                do
+                                                                                                for(ctx->pgn=ctx->pgGenes; ctx->pgn<ctx->pgGenes+ctx->numPgGenes; ctx->pgn++)
                                                                                                 {
-                                                                                                  sprintf(temp, "%sP%s;%s%s;", $5, $4+1, $8, $1);
+                                                                                                  ctx->pt = ctx->pgn->gene;
+                                                                                                  sprintf(ctx->temp, "%sP%s;%s%s;", $5, $4+1, $8, $1);
                                                                                                   
-                                                                                                  if(xgmml)
+                                                                                                  if(ctx->xgmml)
                                                                                                   {
-                                                                                                    strcpy(xgmmlTmp, temp);
-                                                                                                    xgmmlXML(pt, xgmmlTmp);
+                                                                                                    strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                    xgmmlXML(ctx, ctx->pt, ctx->xgmmlTmp);
                                                                                                   }
                                                                                                   
-                                                                                                  kl = KineticLaw_create();
-                                                                                                  react = Model_createReaction(model);
-                                                                                                  if(p=strstr(pt, ":F("))
+                                                                                                  ctx->kl = KineticLaw_create();
+                                                                                                  ctx->react = Model_createReaction(ctx->model);
+                                                                                                  if(ctx->pgn->law)
                                                                                                   {
-                                                                                                    p[strlen(p)-1] = 0x0; /* remove last ")" */
-                                                                                                    kLSp = explicitKineticLaw(pt, temp, p+3);
-                                                                                                    if(kLSp)
+                                                                                                    ctx->kLSp = explicitKineticLaw(ctx, ctx->pt, ctx->temp, ctx->pgn->law);
+                                                                                                    if(ctx->kLSp)
                                                                                                     {
-                                                                                                      KineticLaw_setFormula(kl, kLSp);
-                                                                                                      free(kLSp);
+                                                                                                      KineticLaw_setFormula(ctx->kl, ctx->kLSp);
+                                                                                                      free(ctx->kLSp);
                                                                                                     }
                                                                                                     else
                                                                                                     {
-                                                                                                      yyerror("NULL kineticLawString, exiting...");
-                                                                                                      YYABORT;
+                                                                                                      yyerror(scanner, ctx, "Error: bad F() kinetic law");
+                                                                                                      drop_reaction(ctx);
+                                                                                                      free($1);
+                                                                                                      free($3);
+                                                                                                      free($4);
+                                                                                                      free($5);
+                                                                                                      free($6);
+                                                                                                      free($8);
+                                                                                                      YYERROR;
                                                                                                     }
                                                                                                   
-                                                                                                    user_func = 1;
+                                                                                                    ctx->user_func = 1;
                                                                                                   }
                                                                                                   else
                                                                                                   {
-                                                                                                    kLSp = randomGeneralizedHill(pt, temp);
-                                                                                                    if(kLSp)
+                                                                                                    if(!randomGeneralizedHill(ctx, ctx->pt, ctx->temp))
                                                                                                     {
-                                                                                                      KineticLaw_setFormula(kl, kineticLawString);
-                                                                                                      free(kineticLawString);
-                                                                                                    }
-                                                                                                    else
-                                                                                                    {
-                                                                                                      yyerror("NULL kineticLawString, exiting...");
+                                                                                                      yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
                                                                                                       YYABORT;
                                                                                                     }
                                                                                                       
-                                                                                                    rand_func = 1;
+                                                                                                    ctx->rand_func = 1;
                                                                                                   }
                                                                                                 
-                                                                                                  Reaction_setKineticLaw(react, kl);
-                                                                                                
-                                                                                                  pt = strsep(&pgp, ",");
+                                                                                                  Reaction_setKineticLaw(ctx->react, ctx->kl);
                                                                                                 }
-                                                                                                while(pt);
+                                                                                                pg_clear(ctx);
                                                                                                 
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed multi_out:   %s(%s%s%s%s)%s)\n", $1, $3, $4, $5, $6, $8);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($4) + strlen($5) + 
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($4) + strlen($5) + 
                                                                                                                       strlen($6) + strlen($8) + 4);
-                                                                                                if(!tmp)
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);  strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, $4);  strcat(tmp, $5);  strcat(tmp, $6);
-                                                                                                strcat(tmp, ")"); strcat(tmp, $8);  strcat(tmp, ")");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);  strcat(ctx->tmp, "("); strcat(ctx->tmp, $3);
+                                                                                                strcat(ctx->tmp, $4);  strcat(ctx->tmp, $5);  strcat(ctx->tmp, $6);
+                                                                                                strcat(ctx->tmp, ")"); strcat(ctx->tmp, $8);  strcat(ctx->tmp, ")");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                                 free($4);
@@ -1249,105 +1428,117 @@ multi_out   : protein '(' sgn gene sgn pg ')' sgn ')'
                                                                                                 free($8);
                                                                                               }
             | protein '(' 'F' '(' expr ')' ':' sgn gene sgn pg ')' sgn ')'                    { /* instantiate >= 2 Kinetic Laws */
-                                                                                                sprintf(temp, "%s%s;", $8, $1);
+                                                                                                ctx->fText[0] = expr_formula(&ctx->syms, $5);
+                                                                                                if(!ctx->fText[0])
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                
+                                                                                                sprintf(ctx->temp, "%s%s;", $8, $1);
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($9, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $9, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = explicitKineticLaw($9, temp, $5);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                ctx->kLSp = explicitKineticLaw(ctx, $9, ctx->temp, $5);
+                                                                                                if(ctx->kLSp)
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kLSp);
-                                                                                                  free(kLSp);
+                                                                                                  KineticLaw_setFormula(ctx->kl, ctx->kLSp);
+                                                                                                  free(ctx->kLSp);
                                                                                                 }
                                                                                                 else
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
-                                                                                                  YYABORT;
+                                                                                                  yyerror(scanner, ctx, "Error: bad F() kinetic law");
+                                                                                                  drop_reaction(ctx);
+                                                                                                  free($1);
+                                                                                                  free($8);
+                                                                                                  free($9);
+                                                                                                  free($10);
+                                                                                                  free($11);
+                                                                                                  free($13);
+                                                                                                  free(ctx->fText[0]); expr_free($5);
+                                                                                                  YYERROR;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                user_func = 1;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->user_func = 1;
                                                                                                 
                                                                                                 /* 1 Kinetic Law for each gene in pg */
-                                                                                                strcpy(pg, $11+1);
-                                                                                                pgp = pg;
-                                                                                                pt = strsep(&pgp, ",");
-                                                                                                do
+                                                                                                for(ctx->pgn=ctx->pgGenes; ctx->pgn<ctx->pgGenes+ctx->numPgGenes; ctx->pgn++)
                                                                                                 {
-                                                                                                  sprintf(temp, "%sP%s;%s%s;", $10, $9+1, $13, $1);
+                                                                                                  ctx->pt = ctx->pgn->gene;
+                                                                                                  sprintf(ctx->temp, "%sP%s;%s%s;", $10, $9+1, $13, $1);
                                                                                                   
-                                                                                                  if(xgmml)
+                                                                                                  if(ctx->xgmml)
                                                                                                   {
-                                                                                                    strcpy(xgmmlTmp, temp);
-                                                                                                    xgmmlXML(pt, xgmmlTmp);
+                                                                                                    strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                    xgmmlXML(ctx, ctx->pt, ctx->xgmmlTmp);
                                                                                                   }
                                                                                                   
-                                                                                                  kl = KineticLaw_create();
-                                                                                                  react = Model_createReaction(model);
-                                                                                                  if(p=strstr(pt, ":F("))
+                                                                                                  ctx->kl = KineticLaw_create();
+                                                                                                  ctx->react = Model_createReaction(ctx->model);
+                                                                                                  if(ctx->pgn->law)
                                                                                                   {
-                                                                                                    p[strlen(p)-1] = 0x0; /* remove last ")" */
-                                                                                                    kLSp = explicitKineticLaw(pt, temp, p+3);
-                                                                                                    if(kLSp)
+                                                                                                    ctx->kLSp = explicitKineticLaw(ctx, ctx->pt, ctx->temp, ctx->pgn->law);
+                                                                                                    if(ctx->kLSp)
                                                                                                     {
-                                                                                                      KineticLaw_setFormula(kl, kLSp);
-                                                                                                      free(kLSp);
+                                                                                                      KineticLaw_setFormula(ctx->kl, ctx->kLSp);
+                                                                                                      free(ctx->kLSp);
                                                                                                     }
                                                                                                     else
                                                                                                     {
-                                                                                                      yyerror("NULL kineticLawString, exiting...");
-                                                                                                      YYABORT;
+                                                                                                      yyerror(scanner, ctx, "Error: bad F() kinetic law");
+                                                                                                      drop_reaction(ctx);
+                                                                                                      free($1);
+                                                                                                      free($8);
+                                                                                                      free($9);
+                                                                                                      free($10);
+                                                                                                      free($11);
+                                                                                                      free($13);
+                                                                                                      free(ctx->fText[0]); expr_free($5);
+                                                                                                      YYERROR;
                                                                                                     }
                                                                                                 
-                                                                                                    user_func = 1;
+                                                                                                    ctx->user_func = 1;
                                                                                                   }
                                                                                                   else
                                                                                                   {
-                                                                                                    kLSp = randomGeneralizedHill(pt, temp);
-                                                                                                    if(kLSp)
-                                                                                                    {
-                                                                                                      KineticLaw_setFormula(kl, kineticLawString);
-                                                                                                      free(kineticLawString);
-                                                                                                    }
-                                                                                                    else
+                                                                                                    if(!randomGeneralizedHill(ctx, ctx->pt, ctx->temp))
                                                                                                     {
-                                                                                                      yyerror("NULL kineticLawString, exiting...");
+                                                                                                      yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
                                                                                                       YYABORT;
                                                                                                     }
                                                                                                 
-                                                                                                    rand_func = 1;
+                                                                                                    ctx->rand_func = 1;
                                                                                                   }
                                                                                                   
-                                                                                                  Reaction_setKineticLaw(react, kl);
-                                                                                                
-                                                                                                  pt = strsep(&pgp, ",");
+                                                                                                  Reaction_setKineticLaw(ctx->react, ctx->kl);
                                                                                                 }
-                                                                                                while(pt);
+                                                                                                pg_clear(ctx);
                                                                                                 
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed multi_out:   %s(F(%s):%s%s%s%s)%s)\n", $1, $5, $8, $9, $10, $11, $13);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed multi_out:   %s(F(%s):%s%s%s%s)%s)\n", $1, ctx->fText[0], $8, $9, $10, $11, $13);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($5) + strlen($8) + strlen($9) + 
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen(ctx->fText[0]) + strlen($8) + strlen($9) + 
                                                                                                                       strlen($10)+ strlen($11)+ strlen($13)+ 8);
-                                                                                                if(!tmp)
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);   strcat(tmp, "(F("); strcat(tmp, $5);
-                                                                                                strcat(tmp, "):"); strcat(tmp, $8);    strcat(tmp, $9);
-                                                                                                strcat(tmp, $10);  strcat(tmp, $11);   strcat(tmp, ")");
-                                                                                                strcat(tmp, $13);  strcat(tmp, ")");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);   strcat(ctx->tmp, "(F("); strcat(ctx->tmp, ctx->fText[0]);
+                                                                                                strcat(ctx->tmp, "):"); strcat(ctx->tmp, $8);    strcat(ctx->tmp, $9);
+                                                                                                strcat(ctx->tmp, $10);  strcat(ctx->tmp, $11);   strcat(ctx->tmp, ")");
+                                                                                                strcat(ctx->tmp, $13);  strcat(ctx->tmp, ")");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
-                                                                                                free($5);
+                                                                                                free(ctx->fText[0]); expr_free($5);
                                                                                                 free($8);
                                                                                                 free($9);
                                                                                                 free($10);
@@ -1356,910 +1547,1022 @@ multi_out   : protein '(' sgn gene sgn pg ')' sgn ')'
                                                                                               }
             ;
 pg          : '(' gene                                                                        {
-                                                                                                if(parseInfo)
+                                                                                                pg_clear(ctx);
+                                                                                                if(!pg_add(ctx, $2, NULL))
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed pg:          (%s\n", $2);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($2) + 2);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($2) + 2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, "("); strcat(tmp, $2);
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, "("); strcat(ctx->tmp, $2);
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($2);
                                                                                               }
             | '(' gene ':' 'F' '(' expr ')'                                                   {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed pg:          (%s:F(%s)\n", $2, $6);
+                                                                                                pg_clear(ctx);
+                                                                                                ctx->fText[0] = expr_formula(&ctx->syms, $6);
+                                                                                                if(!ctx->fText[0])
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                
+                                                                                                if(!pg_add(ctx, $2, $6))
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed pg:          (%s:F(%s)\n", $2, ctx->fText[0]);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($2) + strlen($6) + 6);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($2) + strlen(ctx->fText[0]) + 6);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, "("); strcat(tmp, $2); strcat(tmp, ":F(");
-                                                                                                strcat(tmp, $6);  strcat(tmp, ")"); 
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, "("); strcat(ctx->tmp, $2); strcat(ctx->tmp, ":F(");
+                                                                                                strcat(ctx->tmp, ctx->fText[0]);  strcat(ctx->tmp, ")"); 
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($2);
-                                                                                                free($6);
+                                                                                                free(ctx->fText[0]);
                                                                                               }
             | pg ',' gene                                                                     {
-                                                                                                if(parseInfo)
+                                                                                                if(!pg_add(ctx, $3, NULL))
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed pg:          %s, %s\n", $1, $3);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 2);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + 2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, ","); strcat(tmp, $3);
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, ","); strcat(ctx->tmp, $3);
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                               }
             | pg ',' gene ':' 'F' '(' expr ')'                                                {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed pg:          %s, %s:F(%s)\n", $1, $3, $7);
+                                                                                                ctx->fText[0] = expr_formula(&ctx->syms, $7);
+                                                                                                if(!ctx->fText[0])
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                
+                                                                                                if(!pg_add(ctx, $3, $7))
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed pg:          %s, %s:F(%s)\n", $1, $3, ctx->fText[0]);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($7) + 6);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + strlen(ctx->fText[0]) + 6);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);    strcat(tmp, ","); strcat(tmp, $3);
-                                                                                                strcat(tmp, ":F("); strcat(tmp, $7);  strcat(tmp, ")");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);    strcat(ctx->tmp, ","); strcat(ctx->tmp, $3);
+                                                                                                strcat(ctx->tmp, ":F("); strcat(ctx->tmp, ctx->fText[0]);  strcat(ctx->tmp, ")");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
-                                                                                                free($7);
+                                                                                                free(ctx->fText[0]);
                                                                                               }
             ;
 sim         : protein '(' sim_list gene ')'                                                   { /* instantiate Kinetic Law */
-                                                                                                sprintf(temp, "%c", sgn0); 
-                                                                                                strcat(temp, $1);
-                                                                                                strcat(temp, ";");
+                                                                                                sprintf(ctx->temp, "%c", ctx->sgn0); 
+                                                                                                strcat(ctx->temp, $1);
+                                                                                                strcat(ctx->temp, ";");
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($4, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $4, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = randomGeneralizedHill($4, temp);
-                                                                                                if(kLSp)
-                                                                                                {
-                                                                                                  KineticLaw_setFormula(kl, kineticLawString);
-                                                                                                  free(kineticLawString);
-                                                                                                }
-                                                                                                else
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                if(!randomGeneralizedHill(ctx, $4, ctx->temp))
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
+                                                                                                  yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                rand_func = 1;
-                                                                                                num_sgn = 0;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->rand_func = 1;
+                                                                                                ctx->num_sgn = 0;
                                                                                                 
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed sim:         %s(%s%s)\n", $1, $3, $4);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($4) + 3);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($4) + 3);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);  strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, $4);  strcat(tmp, ")");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);  strcat(ctx->tmp, "("); strcat(ctx->tmp, $3);
+                                                                                                strcat(ctx->tmp, $4);  strcat(ctx->tmp, ")");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                                 free($4);
                                                                                               }
             | protein '(' sim_list gene ':' 'F' '(' expr ')' ')'                              { /* instantiate Kinetic Law */
-                                                                                                sprintf(temp, "%c", sgn0); 
-                                                                                                strcat(temp, $1);
-                                                                                                strcat(temp, ";");
+                                                                                                ctx->fText[0] = expr_formula(&ctx->syms, $8);
+                                                                                                if(!ctx->fText[0])
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                sprintf(ctx->temp, "%c", ctx->sgn0); 
+                                                                                                strcat(ctx->temp, $1);
+                                                                                                strcat(ctx->temp, ";");
+                                                                                                
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($4, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $4, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = explicitKineticLaw($4, temp, $8);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                ctx->kLSp = explicitKineticLaw(ctx, $4, ctx->temp, $8);
+                                                                                                if(ctx->kLSp)
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kLSp);
-                                                                                                  free(kLSp);
+                                                                                                  KineticLaw_setFormula(ctx->kl, ctx->kLSp);
+                                                                                                  free(ctx->kLSp);
                                                                                                 }
                                                                                                 else
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
-                                                                                                  YYABORT;
+                                                                                                  yyerror(scanner, ctx, "Error: bad F() kinetic law");
+                                                                                                  drop_reaction(ctx);
+                                                                                                  free($1);
+                                                                                                  free($3);
+                                                                                                  free($4);
+                                                                                                  free(ctx->fText[0]); expr_free($8);
+                                                                                                  YYERROR;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                user_func = 1;
-                                                                                                num_sgn = 0;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->user_func = 1;
+                                                                                                ctx->num_sgn = 0;
 
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed sim:         %s(%s%s:F(%s))\n", $1, $3, $4, $8);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed sim:         %s(%s%s:F(%s))\n", $1, $3, $4, ctx->fText[0]);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($4) + strlen($8) + 7);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + strlen($4) + strlen(ctx->fText[0]) + 7);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);  strcat(tmp, "(");   strcat(tmp, $3);
-                                                                                                strcat(tmp, $4);  strcat(tmp, ":F("); strcat(tmp, $8);
-                                                                                                strcat(tmp, "))");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);  strcat(ctx->tmp, "(");   strcat(ctx->tmp, $3);
+                                                                                                strcat(ctx->tmp, $4);  strcat(ctx->tmp, ":F("); strcat(ctx->tmp, ctx->fText[0]);
+                                                                                                strcat(ctx->tmp, "))");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($3);
                                                                                                 free($4);
-                                                                                                free($8);
+                                                                                                free(ctx->fText[0]); expr_free($8);
                                                                                               }
             ;
 sim_list    : sim_list gene ','                                                               { /* instantiate Kinetic Law */
-                                                                                                sprintf(temp, "%c", sgn0); 
-                                                                                                strcat(temp, protein);
-                                                                                                strcat(temp, ";");
+                                                                                                sprintf(ctx->temp, "%c", ctx->sgn0); 
+                                                                                                strcat(ctx->temp, ctx->protein);
+                                                                                                strcat(ctx->temp, ";");
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($2, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $2, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = randomGeneralizedHill($2, temp);
-                                                                                                if(kLSp)
-                                                                                                {
-                                                                                                  KineticLaw_setFormula(kl, kineticLawString);
-                                                                                                  free(kineticLawString);
-                                                                                                }
-                                                                                                else
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                if(!randomGeneralizedHill(ctx, $2, ctx->temp))
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
+                                                                                                  yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                rand_func = 1;
-                                                                                                num_sgn = 0;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->rand_func = 1;
+                                                                                                ctx->num_sgn = 0;
 
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed sim_list:    %s%s,\n", $1, $2);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($2) + 2);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($2) + 2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, $2); strcat(tmp, ",");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, $2); strcat(ctx->tmp, ",");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($2);
                                                                                               }
             | sim_list gene ':' 'F' '(' expr ')' ','                                          { /* instantiate Kinetic Law */
-                                                                                                sprintf(temp, "%c", sgn0); 
-                                                                                                strcat(temp, protein);
-                                                                                                strcat(temp, ";");
+                                                                                                ctx->fText[0] = expr_formula(&ctx->syms, $6);
+                                                                                                if(!ctx->fText[0])
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                
+                                                                                                sprintf(ctx->temp, "%c", ctx->sgn0); 
+                                                                                                strcat(ctx->temp, ctx->protein);
+                                                                                                strcat(ctx->temp, ";");
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($2, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $2, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = explicitKineticLaw($2, temp, $6);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                ctx->kLSp = explicitKineticLaw(ctx, $2, ctx->temp, $6);
+                                                                                                if(ctx->kLSp)
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kLSp);
-                                                                                                  free(kLSp);
+                                                                                                  KineticLaw_setFormula(ctx->kl, ctx->kLSp);
+                                                                                                  free(ctx->kLSp);
                                                                                                 }
                                                                                                 else
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
-                                                                                                  YYABORT;
+                                                                                                  yyerror(scanner, ctx, "Error: bad F() kinetic law");
+                                                                                                  drop_reaction(ctx);
+                                                                                                  free($1);
+                                                                                                  free($2);
+                                                                                                  free(ctx->fText[0]); expr_free($6);
+                                                                                                  YYERROR;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                user_func = 1;
-                                                                                                num_sgn = 0;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->user_func = 1;
+                                                                                                ctx->num_sgn = 0;
 
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed sim_list:    %s%s:F(%s),\n", $1, $2, $6);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed sim_list:    %s%s:F(%s),\n", $1, $2, ctx->fText[0]);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($2) + strlen($6) + 6);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($2) + strlen(ctx->fText[0]) + 6);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, $2); strcat(tmp, ":F(");
-                                                                                                strcat(tmp, $6); strcat(tmp, "),");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, $2); strcat(ctx->tmp, ":F(");
+                                                                                                strcat(ctx->tmp, ctx->fText[0]); strcat(ctx->tmp, "),");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($2);
-                                                                                                free($6);
+                                                                                                free(ctx->fText[0]); expr_free($6);
                                                                                               }
             | sgn gene ','                                                                    { /* instantiate Kinetic Law */
-                                                                                                strcpy(temp, $1);
-                                                                                                strcat(temp, protein);
-                                                                                                strcat(temp, ";");
+                                                                                                strcpy(ctx->temp, $1);
+                                                                                                strcat(ctx->temp, ctx->protein);
+                                                                                                strcat(ctx->temp, ";");
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($2, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $2, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = randomGeneralizedHill($2, temp);
-                                                                                                if(kLSp)
-                                                                                                {
-                                                                                                  KineticLaw_setFormula(kl, kineticLawString);
-                                                                                                  free(kineticLawString);
-                                                                                                }
-                                                                                                else
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                if(!randomGeneralizedHill(ctx, $2, ctx->temp))
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
+                                                                                                  yyerror(scanner, ctx, "NULL kineticLawString, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                rand_func = 1;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->rand_func = 1;
                                                                                                 
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed sim_list:    %s%s,\n", $1, $2);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($2) + 2);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($2) + 2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, $2); strcat(tmp, ",");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, $2); strcat(ctx->tmp, ",");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($2);
                                                                                               }
             | sgn gene ':' 'F' '(' expr ')' ','                                               { /* instantiate Kinetic Law */
-                                                                                                strcpy(temp, $1);
-                                                                                                strcat(temp, protein);
-                                                                                                strcat(temp, ";");
+                                                                                                ctx->fText[0] = expr_formula(&ctx->syms, $6);
+                                                                                                if(!ctx->fText[0])
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
+                                                                                                
+                                                                                                strcpy(ctx->temp, $1);
+                                                                                                strcat(ctx->temp, ctx->protein);
+                                                                                                strcat(ctx->temp, ";");
                                                                                                 
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml)
                                                                                                 {
-                                                                                                  strcpy(xgmmlTmp, temp);
-                                                                                                  xgmmlXML($2, xgmmlTmp);
+                                                                                                  strcpy(ctx->xgmmlTmp, ctx->temp);
+                                                                                                  xgmmlXML(ctx, $2, ctx->xgmmlTmp);
                                                                                                 }
                                                                                                 
-                                                                                                kl = KineticLaw_create();
-                                                                                                react = Model_createReaction(model);
-                                                                                                kLSp = explicitKineticLaw($2, temp, $6);
-                                                                                                if(kLSp)
+                                                                                                ctx->kl = KineticLaw_create();
+                                                                                                ctx->react = Model_createReaction(ctx->model);
+                                                                                                ctx->kLSp = explicitKineticLaw(ctx, $2, ctx->temp, $6);
+                                                                                                if(ctx->kLSp)
                                                                                                 {
-                                                                                                  KineticLaw_setFormula(kl, kLSp);
-                                                                                                  free(kLSp);
+                                                                                                  KineticLaw_setFormula(ctx->kl, ctx->kLSp);
+                                                                                                  free(ctx->kLSp);
                                                                                                 }
                                                                                                 else
                                                                                                 {
-                                                                                                  yyerror("NULL kineticLawString, exiting...");
-                                                                                                  YYABORT;
+                                                                                                  yyerror(scanner, ctx, "Error: bad F() kinetic law");
+                                                                                                  drop_reaction(ctx);
+                                                                                                  free($1);
+                                                                                                  free($2);
+                                                                                                  free(ctx->fText[0]); expr_free($6);
+                                                                                                  YYERROR;
                                                                                                 }
                                                                                                 
-                                                                                                Reaction_setKineticLaw(react, kl);
-                                                                                                user_func = 1;
+                                                                                                Reaction_setKineticLaw(ctx->react, ctx->kl);
+                                                                                                ctx->user_func = 1;
                                                                                                 
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed sim_list:    %s%s:F(%s),\n", $1, $2, $6);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed sim_list:    %s%s:F(%s),\n", $1, $2, ctx->fText[0]);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($2) + strlen($6) + 5);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($2) + strlen(ctx->fText[0]) + 6);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, $2); strcat(tmp, ":F(");
-                                                                                                strcat(tmp, $6); strcat(tmp, "),");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, $2); strcat(ctx->tmp, ":F(");
+                                                                                                strcat(ctx->tmp, ctx->fText[0]); strcat(ctx->tmp, "),");
+                                                                                                $$ = ctx->tmp;
                                                                                                 free($1);
                                                                                                 free($2);
-                                                                                                free($6);
+                                                                                                free(ctx->fText[0]); expr_free($6);
                                                                                               }
             ;
 sgn         : '+'                                                                             {
-                                                                                                switch(num_sgn)
+                                                                                                switch(ctx->num_sgn)
                                                                                                 {
-                                                                                                  case 0: sgn0 = '+'; break;
-                                                                                                  case 1: sgn1 = '+'; break;
-                                                                                                  case 2: sgn2 = '+'; break;
+                                                                                                  case 0: ctx->sgn0 = '+'; break;
+                                                                                                  case 1: ctx->sgn1 = '+'; break;
+                                                                                                  case 2: ctx->sgn2 = '+'; break;
                                                                                                 }
-                                                                                                num_sgn++;
-                                                                                                num_sgn %= 3;
+                                                                                                ctx->num_sgn++;
+                                                                                                ctx->num_sgn %= 3;
                                                                                                 
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed sgn:         +\n");
                                                                                                   
-                                                                                                tmp = (char *) malloc(2);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, "+");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, "+");
+                                                                                                $$ = ctx->tmp;
                                                                                               }
             | '-'                                                                             {
-                                                                                                switch(num_sgn)
+                                                                                                switch(ctx->num_sgn)
                                                                                                 {
-                                                                                                  case 0: sgn0 = '-'; break;
-                                                                                                  case 1: sgn1 = '-'; break;
-                                                                                                  case 2: sgn2 = '-'; break;
+                                                                                                  case 0: ctx->sgn0 = '-'; break;
+                                                                                                  case 1: ctx->sgn1 = '-'; break;
+                                                                                                  case 2: ctx->sgn2 = '-'; break;
                                                                                                 }
-                                                                                                num_sgn++;
-                                                                                                num_sgn %= 3;
+                                                                                                ctx->num_sgn++;
+                                                                                                ctx->num_sgn %= 3;
                                                                                                 
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed sgn:         -\n");
 
-                                                                                                tmp = (char *) malloc(2);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, "-");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, "-");
+                                                                                                $$ = ctx->tmp;
                                                                                               }
             ;
 gene        : GENE                                                                            {
-                                                                                                if(xgmml)
+                                                                                                if(ctx->xgmml && ctx->layoutKind) /* written placed, once the network is laid out */
+                                                                                                  layout_node(ctx->layout, atol($1+1));
+                                                                                                else if(ctx->xgmml)
                                                                                                 {
-                                                                                                  if((strlen(cytoBuf) + 64) > cytoBufSz)
-                                                                                                  {
-                                                                                                    tmp = realloc(cytoBuf, cytoBufSz + 256);
-                                                                                                    if(!tmp)
-                                                                                                    {
-                                                                                                      yyerror("realloc error for cytoBuf, exiting...");
-                                                                                                      YYABORT;
-                                                                                                    }
-                                                                                                    else
-                                                                                                    {
-                                                                                                      cytoBuf = tmp;
-                                                                                                      cytoBufSz += 256;
-                                                                                                    }
-                                                                                                  }
-                                                                                                  sprintf(tmpCytoBuf, "  <node id=\"%s\" label=\"%s\"/>\n", $1, $1);
-                                                                                                  strcat(cytoBuf, tmpCytoBuf);
+                                                                                                  sprintf(ctx->tmpCytoBuf, "  <node id=\"%s\" label=\"%s\"/>\n", $1, $1);
+                                                                                                cyto_write(ctx, ctx->tmpCytoBuf);
                                                                                                 }
 
-                                                                                                tot_genes++;
-                                                                                                if(parseInfo)
+                                                                                                ctx->tot_genes++;
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed GENE:        %s\n", $1);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + 1);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + 1);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);
+                                                                                                $$ = ctx->tmp;
                                                                                               }
             ;
 protein     : PROTEIN                                                                         {
-                                                                                                if(!Model_getSpeciesById(model, $1))
+                                                                                                if(!Model_getSpeciesById(ctx->model, $1))
                                                                                                 {
-                                                                                                  species = Model_createSpecies(model);
+                                                                                                  Species_t *species = Model_createSpecies(ctx->model);
+
                                                                                                   Species_setId(species, $1);
                                                                                                   Species_setName(species, $1);
                                                                                                   Species_setCompartment(species, sid);
                                                                                                   Species_setInitialConcentration(species, 1.0);
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(protein, $1);
+                                                                                                strcpy(ctx->protein, $1);
                                                                                                
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed PROTEIN:     %s\n", $1);
                                                                                                   
-                                                                                                tmp = (char *) malloc(strlen($1) + 1);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + 1);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1);
+                                                                                                $$ = ctx->tmp;
                                                                                               }
             ;
 p_error     : PROTEIN ','                                                                     {
-                                                                                                tmp = (char *) malloc(strlen($1) + 2);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + 2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, ",");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, ",");
+                                                                                                $$ = ctx->tmp;
                                                                                               }
             | PROTEIN ')'                                                                     {
-                                                                                                tmp = (char *) malloc(strlen($1) + 2);
-                                                                                                if(!tmp)
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + 2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, ")");
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, ")");
+                                                                                                $$ = ctx->tmp;
                                                                                               }
             ;
 expr        : expr '+' expr                                                                   {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        %s+%s\n", $1, $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 2);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_op(OP_ADD, $1, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "+"); strcat(tmp, $3);
-                                                                                                $$ = tmp;
-                                                                                                free($1);
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed expr:        ", $$);
                                                                                               }
             | expr '-' expr                                                                   {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        %s-%s\n", $1, $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 2);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_op(OP_SUB, $1, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "-"); strcat(tmp, $3);
-                                                                                                $$ = tmp;
-                                                                                                free($1);
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed expr:        ", $$);
                                                                                               }
             | expr '*' expr                                                                   {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        %s*%s\n", $1, $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 2);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_op(OP_MUL, $1, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "*"); strcat(tmp, $3);
-                                                                                                $$ = tmp;
-                                                                                                free($1);
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed expr:        ", $$);
                                                                                               }
             | expr '/' expr                                                                   {
-                                                                                                if($3 == 0) {yyerror("Error: division by zero\n"); YYABORT;}
-                                                                                                else
-                                                                                                {
-                                                                                                  if(parseInfo)
-                                                                                                    printf("parsed expr:        %s/%s\n", $1, $3);
-                                                                                                  
-                                                                                                  tmp = (char *) malloc(strlen($1) + strlen($3) + 2);
-                                                                                                  if(!tmp)
-                                                                                                  {
-                                                                                                    yyerror("malloc error, exiting...");
-                                                                                                    YYABORT;
-                                                                                                  }
+                                                                                                if(expr_is_zero($3)) {yyerror(scanner, ctx, "Error: division by zero"); expr_free($1); expr_free($3); YYERROR;}
                                                                                                 
-                                                                                                  strcpy(tmp, $1); strcat(tmp, "/"); strcat(tmp, $3);
-                                                                                                  $$ = tmp;
-                                                                                                  free($1);
-                                                                                                  free($3);
-                                                                                                }
-                                                                                              }
-            | '-' expr %prec UMINUS                                                           {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        (-%s)\n", $2);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($2) + 2);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_op(OP_DIV, $1, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, "-"); strcat(tmp, $2);
-                                                                                                $$ = tmp;
-                                                                                                free($2);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed expr:        ", $$);
                                                                                               }
-            | '(' expr ')'                                                                    {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        (%s)\n", $2);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($2) + 3);
-                                                                                                if(!tmp)
+            | '-' expr %prec UMINUS                                                           {
+                                                                                                $$ = expr_op(OP_NEG, $2, NULL);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, "("); strcat(tmp, $2); strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($2);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed expr:        ", $$);
+                                                                                              }
+            | '(' expr ')'                                                                    {
+                                                                                                $$ = $2;
                                                                                               }
             | term                                                                            {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        %s\n", $1);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + 2);
-                                                                                                if(!tmp)
-                                                                                                {
-                                                                                                  yyerror("malloc error, exiting...");
-                                                                                                  YYABORT;
-                                                                                                }
-                                                                                                
-                                                                                                strcpy(tmp, $1);
-                                                                                                $$ = tmp;
-                                                                                                free($1);
+                                                                                                $$ = $1;
                                                                                               }
             ;
 term        : protein                                                                         {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed term:        %s\n", $1);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + 1);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_symbol(&ctx->syms, $1); /* resolved to its symbol id */
+                                                                                                free($1);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
-                                                                                                
-                                                                                                strcpy(tmp, $1);
-                                                                                                $$ = tmp;
-                                                                                                free($1);
                                                                                               }
             | constant                                                                        {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed term:        %s\n", $1);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + 1);
-                                                                                                if(!tmp)
-                                                                                                {
-                                                                                                  yyerror("malloc error, exiting...");
-                                                                                                  YYABORT;
-                                                                                                }
-                                                                                                
-                                                                                                strcpy(tmp, $1);
-                                                                                                $$ = tmp;
-                                                                                                free($1);
+                                                                                                $$ = $1;
                                                                                               }
             | ABS '(' expr ')'                                                                {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        abs(%s)\n", $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_func(F_ABS, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             | ARCCOS '(' expr ')'                                                             {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        arccos(%s)\n", $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_func(F_ARCCOS, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             | ARCSIN '(' expr ')'                                                             {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        arcsin(%s)\n", $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_func(F_ARCSIN, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             | ARCTAN '(' expr ')'                                                             {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        arctan(%s)\n", $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_func(F_ARCTAN, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             | CEILING '(' expr ')'                                                            {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        ceiling(%s)\n", $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_func(F_CEILING, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             | COS '(' expr ')'                                                                {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        cos(%s)\n", $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_func(F_COS, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             | EXP '(' expr ')'                                                                {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        exp(%s)\n", $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_func(F_EXP, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             | FLOOR '(' expr ')'                                                              {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        floor(%s)\n", $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_func(F_FLOOR, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             | LN '(' expr ')'                                                                 {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        ln(%s)\n", $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_func(F_LN, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             | LOG '(' DIGITS ',' expr ')'                                                     {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        log(%s,%s)\n", $3, $5);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($3) + strlen($5) + 4);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_op(OP_LOGB, expr_const($3), $5);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);  strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ","); strcat(tmp, $5);  strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($5);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             | POWER '(' expr ',' expr ')'                                                     {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        power(%s,%s)\n", $3, $5);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($3) + strlen($5) + 4);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_op(OP_POW, $3, $5);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);  strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ","); strcat(tmp, $5);  strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($3);
-                                                                                                free($5);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             | ROOT '(' DIGITS ',' expr ')'                                                    {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        root(%s,%s)\n", $3, $5);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($3) + strlen($5) + 4);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_op(OP_ROOT, expr_const($3), $5);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1);  strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ","); strcat(tmp, $5);  strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($5);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             | SIN '(' expr ')'                                                                {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        sin(%s)\n", $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_func(F_SIN, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             | TAN '(' expr ')'                                                                {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed expr:        tan(%s)\n", $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 3);
-                                                                                                if(!tmp)
+                                                                                                $$ = expr_func(F_TAN, $3);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "("); strcat(tmp, $3);
-                                                                                                strcat(tmp, ")");
-                                                                                                $$ = tmp;
-                                                                                                free($3);
+                                                                                                if(ctx->parseInfo)
+                                                                                                  parse_info_expr(ctx, "parsed term:        ", $$);
                                                                                               }
             ;
 constant    : DIGITS '.' DIGITS                                                               {
-                                                                                                if(parseInfo)
-                                                                                                  printf("parsed constant:    %s,%s\n", $1, $3);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + strlen($3) + 2);
-                                                                                                if(!tmp)
+                                                                                                if(ctx->parseInfo)
+                                                                                                  printf("parsed constant:    %s.%s\n", $1, $3);
+                                                                                                
+                                                                                                ctx->tmp = (char *) malloc(strlen($1) + strlen($3) + 2);
+                                                                                                if(!ctx->tmp)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
                                                                                                 
-                                                                                                strcpy(tmp, $1); strcat(tmp, "."); strcat(tmp, $3);
-                                                                                                $$ = tmp;
+                                                                                                strcpy(ctx->tmp, $1); strcat(ctx->tmp, "."); strcat(ctx->tmp, $3);
+                                                                                                $$ = expr_const(ctx->tmp);
+                                                                                                free(ctx->tmp);
+                                                                                                if(!$$)
+                                                                                                {
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
+                                                                                                  YYABORT;
+                                                                                                }
                                                                                               }
             | DIGITS                                                                          {
-                                                                                                if(parseInfo)
+                                                                                                if(ctx->parseInfo)
                                                                                                   printf("parsed constant:    %s\n", $1);
-                                                                                                  
-                                                                                                tmp = (char *) malloc(strlen($1) + 1);
-                                                                                                if(!tmp)
+                                                                                                
+                                                                                                $$ = expr_const($1);
+                                                                                                if(!$$)
                                                                                                 {
-                                                                                                  yyerror("malloc error, exiting...");
+                                                                                                  yyerror(scanner, ctx, "malloc error, exiting...");
                                                                                                   YYABORT;
                                                                                                 }
-                                                                                                
-                                                                                                strcpy(tmp, $1);
-                                                                                                $$ = tmp;
                                                                                               }
             ;
 %%
 
+#ifndef NEMO_LIBRARY
 int main(int argc, char **argv)
 {
-  int i, j=0, option;
-  long seedval;
-
-  seedval = 123456789;
-  srand48(seedval);
+  int cliOnly=0, i, option, ret=0;
+  char *cacheText, *p, *serveDir=0x0, *serveSocket=0x0, outCacheDir[BUFSZ], settings[4*BUFSZ];
+  size_t cacheLen;
+  FILE *in=0x0, *out=0x0;
+  NEMO_CTX *ctx;
+  yyscan_t scanner;
+  
+  ctx = new_ctx();
+  if(!ctx)
+  {
+    fprintf(stderr, "nemo2sbml: malloc error, returning...\n");
+    return 1;
+  }
+  outCacheDir[0] = 0x0;
   
   /* options parsing */
-  while((option = getopt(argc, argv, "s:hkpvx")) > 0)
+  while((option = getopt(argc, argv, "c:C:d:E:g:G:j:J:K:L:P:s:S:T:z:ehklMmnpvx")) > 0)
   {
+    if(strchr("cCeEgGJKMPSTz", option))
+      cliOnly = option;
+    
     switch(option)
     {
+      case 'c':
+        if(strlen(optarg) >= BUFSZ-32)
+        {
+          fprintf(stderr, "nemo2sbml: -c: directory name \"%s\" too long, returning...\n", optarg);
+          return 1;
+        }
+        strcpy(ctx->cacheDir, optarg);
+        break;
+        
+      case 'C':
+        if(strlen(optarg) >= BUFSZ-32)
+        {
+          fprintf(stderr, "nemo2sbml: -C: directory name \"%s\" too long, returning...\n", optarg);
+          return 1;
+        }
+        strcpy(outCacheDir, optarg);
+        break;
+        
+      case 'd':
+        serveSocket = optarg;
+        if((serveDir = strchr(optarg, ',')))
+          *serveDir++ = 0x0;
+        break;
+        
+      case 'E':
+        for(i=0; i<strlen(optarg); i++)
+        {
+          if(!isdigit(optarg[i]))
+          {
+            fprintf(stderr, "nemo2sbml: -E: \"%s\" must be an integer argument > 0, returning...\n", optarg);
+            return 1;
+          }
+        }
+        ctx->numSamples = atoi(optarg);
+        if(ctx->numSamples < 1)
+        {
+          fprintf(stderr, "nemo2sbml: -E: \"%s\" must be an integer argument > 0, returning...\n", optarg);
+          return 1;
+        }
+        break;
+        
+      case 'e':
+        ctx->steadyState = 1;
+        break;
+        
+      case 'g':
+        if(!strcmp(optarg, "csv"))
+          ctx->paramTable = P_CSV;
+        else if(!strcmp(optarg, "bin"))
+          ctx->paramTable = P_BIN;
+        else
+        {
+          fprintf(stderr, "nemo2sbml: -g: unknown \"%s\", use csv or bin, returning...\n", optarg);
+          return 1;
+        }
+        break;
+        
+      case 'G':
+        ctx->numTrajectories = (int) strtol(optarg, &p, 10);
+        if(*p == ',')
+          ctx->ssaOmega = strtod(p+1, &p);
+        if(*p || !isdigit(optarg[0]) || ctx->numTrajectories < 1 || ctx->ssaOmega <= 0.0)
+        {
+          fprintf(stderr, "nemo2sbml: -G: \"%s\" must be <runs>[,<omega>] with runs > 0 and omega > 0, returning...\n", optarg);
+          return 1;
+        }
+        break;
+        
       case 'h':
         printf("compile into Systems Biology Markup Language a\n");
         printf("network in the NEMO (NEtwork MOtif) language\n");
         printf("usage: nemo2sbml [options] <input file> <output file>\n");
+        printf("                 -c <dir>, cache DOR checks, and the laws of each DOR, GLIST and TMLIST, in dir,\n");
+        printf("                    so that on a recompile only the ones that changed are checked and built\n");
+        printf("                 -C <dir>, cache the output files in dir, by input and settings, and on a rerun\n");
+        printf("                    link them from there instead of compiling (not with -k, -p or -T)\n");
+        printf("                 -d <socket>[,<dir>], serve compiles on this Unix socket, see server.c; -j is the most\n");
+        printf("                    threads a request gets, and dir is where its documents may be written;\n");
+        printf("                    -c, -C, -E, -e, -G, -g, -J, -K, -M, -P, -S, -T and -z are not available with it\n");
+        printf("                 -E <samples>, with -S, also simulate this many random parameter sets,\n");
+        printf("                    mean and sd of the time courses to <output>_ensemble.txt\n");
+        printf("                 -e also find the steady state of each network, to <output>_steady.txt\n");
+        printf("                 -g <csv|bin>, make the random parameters global, with their values also\n");
+        printf("                    in a table, <output>_params.csv or .bin, to swap for a sweep\n");
+        printf("                 -G <runs>[,<omega>], with -S, also run this many stochastic (Gillespie) trajectories,\n");
+        printf("                    omega molecules to a unit of concentration (default 1), to <output>_ssa.txt\n");
         printf("                 -h --help\n");
+        printf("                 -j <threads>, build the kinetic laws (and run -E and -G) on this many threads, default = 1\n");
+        printf("                 -J <pattern|partials>, also write the Jacobian's sparsity pattern, or with the\n");
+        printf("                    partial derivatives of the kinetic laws, to <output>_jacobian.txt\n");
         printf("                 -k print kinetic law info\n");
+        printf("                 -K <count>, write each network this many times, with the random parameters of\n");
+        printf("                    seeds seedval, seedval+1, ..., to <output>_<k>.xml (not with -l)\n");
+        printf("                 -L <force|tree>, with -x, place the genes in the XGMML, force-directed (on -j\n");
+        printf("                    threads) or in layers down from the master regulators\n");
+        printf("                 -l legacy parameters, drawn in parse order from one drand48 stream\n");
+        printf("                 -M also count the motifs of each network's regulation graph, to <output>_census.txt\n");
+        printf("                 -m print peak memory use (RSS) after each network\n");
+        printf("                 -n one net reaction per gene, synthesis less degradation, instead of two\n");
+        printf("                 -P <parts>, also split each network into this many submodels, with few regulations\n");
+        printf("                    between them, to <output>_part<k>.xml and the coupling to <output>_partition.txt\n");
         printf("                 -p print parse info\n");
-        printf("                 -s <seedval>, set the seed for drand48, default = 123456789\n");
+        printf("                 -s <seedval>, set the seed for the random parameters, default = 123456789\n");
+        printf("                 -S <tEnd>,<dt>, also simulate each network, time courses to <output>.txt\n");
+        printf("                 -T <text|json>, time each phase of each network, with peak RSS and bytes written,\n");
+        printf("                    to stderr, or as JSON to <output>_timing.json\n");
         printf("                 -v print version\n");
         printf("                 -x output an XGMML file for cytoscape\n");
+        printf("                 -z <gz|zst>[:level], compress the output files (.gz or .zst appended), gz levels 0-9, zst 1-max\n");
         return 0;
         
+      case 'j':
+        for(i=0; i<strlen(optarg); i++)
+        {
+          if(!isdigit(optarg[i]))
+          {
+            fprintf(stderr, "nemo2sbml: -j: \"%s\" must be an integer argument > 0, returning...\n", optarg);
+            return 1;
+          }
+        }
+        ctx->numThreads = atoi(optarg);
+        if(ctx->numThreads < 1)
+        {
+          fprintf(stderr, "nemo2sbml: -j: \"%s\" must be an integer argument > 0, returning...\n", optarg);
+          return 1;
+        }
+        break;
+        
+      case 'J':
+        if(!strcmp(optarg, "pattern"))
+          ctx->jacobian = 1;
+        else if(!strcmp(optarg, "partials"))
+          ctx->jacobian = 2;
+        else
+        {
+          fprintf(stderr, "nemo2sbml: -J: unknown \"%s\", use pattern or partials, returning...\n", optarg);
+          return 1;
+        }
+        break;
+        
       case 'k':
-        kineticLawInfo = 1;
+        ctx->kineticLawInfo = 1;
+        break;
+        
+      case 'K':
+        for(i=0; i<strlen(optarg); i++)
+        {
+          if(!isdigit(optarg[i]))
+          {
+            fprintf(stderr, "nemo2sbml: -K: \"%s\" must be an integer argument > 0, returning...\n", optarg);
+            return 1;
+          }
+        }
+        ctx->numVariants = atoi(optarg);
+        if(ctx->numVariants < 1)
+        {
+          fprintf(stderr, "nemo2sbml: -K: \"%s\" must be an integer argument > 0, returning...\n", optarg);
+          return 1;
+        }
+        break;
+        
+      case 'L':
+        if(!strcmp(optarg, "force"))
+          ctx->layoutKind = LAYOUT_FORCE;
+        else if(!strcmp(optarg, "tree"))
+          ctx->layoutKind = LAYOUT_TREE;
+        else
+        {
+          fprintf(stderr, "nemo2sbml: -L: unknown \"%s\", use force or tree, returning...\n", optarg);
+          return 1;
+        }
+        break;
+        
+      case 'l':
+        ctx->legacyRand = 1;
+        break;
+        
+      case 'M':
+        ctx->motifCensus = 1;
+        break;
+        
+      case 'm':
+        ctx->memInfo = 1;
+        break;
+        
+      case 'n':
+        ctx->netReactions = 1;
+        break;
+        
+      case 'P':
+        for(i=0; i<strlen(optarg); i++)
+        {
+          if(!isdigit(optarg[i]))
+          {
+            fprintf(stderr, "nemo2sbml: -P: \"%s\" must be an integer argument > 0, returning...\n", optarg);
+            return 1;
+          }
+        }
+        ctx->numParts = atoi(optarg);
+        if(ctx->numParts < 1)
+        {
+          fprintf(stderr, "nemo2sbml: -P: \"%s\" must be an integer argument > 0, returning...\n", optarg);
+          return 1;
+        }
         break;
         
       case 'p':
-        parseInfo = 1;
+        ctx->parseInfo = 1;
         break;
 
       case 's':
@@ -2271,37 +2574,163 @@ int main(int argc, char **argv)
             return 1;
           }
         }
-        seedval = atol(optarg);
-        srand48(seedval);
+        ctx->seedval = atol(optarg);
+        break;
+      
+      case 'S':
+        ctx->simEnd = strtod(optarg, &p);
+        if(*p == ',')
+          ctx->simDt = strtod(p+1, &p);
+        if(*p || ctx->simEnd <= 0.0 || ctx->simDt <= 0.0 || ctx->simDt > ctx->simEnd)
+        {
+          fprintf(stderr, "nemo2sbml: -S: \"%s\" must be <tEnd>,<dt> with 0 < dt <= tEnd, returning...\n", optarg);
+          return 1;
+        }
+        break;
+      
+      case 'T':
+        if(!strcmp(optarg, "text"))
+          timing = T_TEXT;
+        else if(!strcmp(optarg, "json"))
+          timing = T_JSON;
+        else
+        {
+          fprintf(stderr, "nemo2sbml: -T: unknown \"%s\", use text or json, returning...\n", optarg);
+          return 1;
+        }
         break;
       
       case 'v':
         printf("ver %s\n", VERSION);
         return 0;
         
+      case 'z':
+        if((p = strchr(optarg, ':')))
+        {
+          *p++ = 0x0;
+          for(i=0; i<strlen(p); i++)
+          {
+            if(!isdigit(p[i]))
+            {
+              fprintf(stderr, "nemo2sbml: -z: level \"%s\" must be an integer argument >= 0, returning...\n", p);
+              return 1;
+            }
+          }
+          ctx->zlevel = strlen(p) > 3 ? 1000 : atoi(p); /* too many digits is out of range below */
+        }
+        
+        if(!strcmp(optarg, "gz"))
+          ctx->zformat = Z_GZIP;
+        else if(!strcmp(optarg, "zst"))
+          ctx->zformat = Z_ZSTD;
+        else
+        {
+          fprintf(stderr, "nemo2sbml: -z: unknown format \"%s\", use gz or zst, returning...\n", optarg);
+          return 1;
+        }
+#ifndef HAVE_ZLIB
+        if(ctx->zformat == Z_GZIP)
+        {
+          fprintf(stderr, "nemo2sbml: -z gz: not compiled in, rebuild with -DHAVE_ZLIB -lz, returning...\n");
+          return 1;
+        }
+#endif
+#ifndef HAVE_ZSTD
+        if(ctx->zformat == Z_ZSTD)
+        {
+          fprintf(stderr, "nemo2sbml: -z zst: not compiled in, rebuild with -DHAVE_ZSTD -lzstd, returning...\n");
+          return 1;
+        }
+#else
+        if(ctx->zformat == Z_ZSTD && p && (ctx->zlevel < 1 || ctx->zlevel > ZSTD_maxCLevel()))
+        {
+          fprintf(stderr, "nemo2sbml: -z zst: level \"%s\" must be 1 to %d, returning...\n", p, ZSTD_maxCLevel());
+          return 1;
+        }
+#endif
+        if(ctx->zformat == Z_GZIP && p && (!*p || ctx->zlevel > 9))
+        {
+          fprintf(stderr, "nemo2sbml: -z gz: level \"%s\" must be 0 to 9, returning...\n", p);
+          return 1;
+        }
+        break;
+        
       case 'x':
-        xgmml = 1;
+        ctx->xgmml = 1;
         
-        cytoBuf = (char *) malloc(BUFSZ);
-        if(!cytoBuf)
+        ctx->cytoBuf = (char *) malloc(BUFSZ);
+        if(!ctx->cytoBuf)
         {
           fprintf(stderr, "nemo2sbml: malloc error for cytoBuf, returning...\n");
           return 1;
         }
         
-        cytoBufSz = BUFSZ;
+        ctx->cytoBufSz = BUFSZ;
         break;
        
       default: break;
     }
   }
   
-  output[0] = 0x0;
+  ctx->output[0] = 0x0;
+  legacy_seed(ctx, ctx->seedval);
+  
+  /* the server's compiles run at once, and take what they write from the request */
+  if(serveSocket && cliOnly)
+  {
+    fprintf(stderr, "nemo2sbml: -d: -%c is not available to the server, returning...\n", cliOnly);
+    return 1;
+  }
+  
+  if(ctx->numSamples && ctx->simEnd <= 0.0)
+  {
+    fprintf(stderr, "nemo2sbml: -E needs -S <tEnd>,<dt>, returning...\n");
+    return 1;
+  }
+  
+  if(ctx->numTrajectories && ctx->simEnd <= 0.0)
+  {
+    fprintf(stderr, "nemo2sbml: -G needs -S <tEnd>,<dt>, returning...\n");
+    return 1;
+  }
+  
+  if(ctx->layoutKind && !ctx->xgmml)
+  {
+    fprintf(stderr, "nemo2sbml: -L needs -x, returning...\n");
+    return 1;
+  }
+  
+  if(ctx->numVariants && ctx->legacyRand)
+  {
+    fprintf(stderr, "nemo2sbml: -K can't redraw the drand48 stream of -l, returning...\n");
+    return 1;
+  }
+  
+  if(ctx->cacheDir[0] && access(ctx->cacheDir, W_OK))
+  {
+    fprintf(stderr, "nemo2sbml: -c: cache directory %s is not writable, returning...\n", ctx->cacheDir);
+    return 1;
+  }
+  
+  if(outCacheDir[0] && access(outCacheDir, W_OK))
+  {
+    fprintf(stderr, "nemo2sbml: -C: cache directory %s is not writable, returning...\n", outCacheDir);
+    return 1;
+  }
+  
+  if(serveDir && access(serveDir, W_OK))
+  {
+    fprintf(stderr, "nemo2sbml: -d: directory %s is not writable, returning...\n", serveDir);
+    return 1;
+  }
+  
+  if(serveSocket)
+    return nemo_serve(serveSocket, serveDir, ctx->numThreads);
   
   if(argv[optind] != NULL)
   {
-    yyin = fopen(argv[optind], "r");
-    if(yyin == NULL)
+    in = fopen(argv[optind], "r");
+    if(in == NULL)
     {
       fprintf(stderr, "nemo2sbml: unable to open input file %s...\n", argv[optind]);
       return 1;
@@ -2315,71 +2744,1351 @@ int main(int argc, char **argv)
         return 1;
       }
       
-      yyout = fopen(argv[optind+1], "w");
-      if(yyout == NULL)
+      out = fopen(argv[optind+1], "w");
+      if(out == NULL)
       {
         fprintf(stderr, "nemo2sbml: unable to open output file %s...\n", argv[optind+1]);
         return 1;
       }
-      strcpy(output, argv[optind+1]);
+      strcpy(ctx->output, argv[optind+1]);
     }
   }
 
 
-  doc = SBMLDocument_createWith(SBML_LEVEL, SBML_VERSION);
-  model = SBMLDocument_createModel(doc);
-
-  compart = Model_createCompartment(model);
-  Compartment_setId(compart, sid);
-  Compartment_setVolume(compart, 1.0); /* 1 femtoliter, see below */
+  /* -C: a run already in the cache is not compiled; -k, -p and -T report on the compile itself, so they bypass it */
+  if(outCacheDir[0] && (ctx->kineticLawInfo || ctx->parseInfo || timing))
+    outCacheDir[0] = 0x0;
+  if(!in)
+    in = stdin;
+  if(outCacheDir[0])
+  {
+    cacheText = oc_read(in, &cacheLen);
+    if(!cacheText)
+    {
+      fprintf(stderr, "nemo2sbml: -C: unable to read the input, returning...\n");
+      return 1;
+    }
+    
+    sprintf(settings, "nemo2sbml %s seed %ld legacy %d xgmml %d z %d:%d S %.17g,%.17g E %d e %d J %d M %d P %d n %d g %d K %d L %d G %d,%.17g prefix %s",
+            VERSION, ctx->seedval, ctx->legacyRand, ctx->xgmml, ctx->zformat, ctx->zlevel, ctx->simEnd, ctx->simDt, ctx->numSamples, ctx->steadyState, ctx->jacobian, ctx->motifCensus, ctx->numParts,
+            ctx->netReactions, ctx->paramTable, ctx->numVariants, ctx->layoutKind, ctx->numTrajectories, ctx->ssaOmega, ctx->output);
+#ifdef NON_LINEAR
+    strcat(settings, " nonlinear");
+#endif
+    if(oc_lookup(outCacheDir, cacheText, cacheLen, settings))
+    {
+      oc_stats(1);
+      return 0;
+    }
+    
+    /* in is at its end, which is where an empty input leaves it anyway */
+    if(cacheLen && !(in = fmemopen(cacheText, cacheLen, "r")))
+    {
+      fprintf(stderr, "nemo2sbml: -C: fmemopen error, returning...\n");
+      return 1;
+    }
+  }
+  
+ 
+  scanner = nemo_lex_open(&ctx->lex, in);
+  if(!scanner)
+  {
+    fprintf(stderr, "nemo2sbml: malloc error for the scanner, returning...\n");
+    return 1;
+  }
+  new_document(ctx);
+
+  tm_enter(T_PARSE);
+  do
+  {
+    yyparse(scanner, ctx);
+  }
+  while(!feof(in));
+  tm_leave();
+  
+  SBMLDocument_free(ctx->doc);
+  
+  if(ctx->cacheDir[0])
+  {
+    printf("DOR cache %s: %d hits, %d misses\n", ctx->cacheDir, ctx->cacheHits, ctx->cacheMisses);
+    printf("law cache %s: %d hits, %d misses\n", ctx->cacheDir, ctx->lawHits, ctx->lawMisses);
+  }
+  
+  if(outCacheDir[0])
+  {
+    if(!ctx->lex.numErrors)
+      oc_store();
+    oc_stats(0);
+  }
+  
+  if(ctx->lex.numErrors)
+  {
+    fprintf(stderr, "nemo2sbml: %d error(s)\n", ctx->lex.numErrors);
+    ret = 1;
+  }
+  else if(ctx->writeErrors)
+  {
+    fprintf(stderr, "nemo2sbml: %d file(s) not written\n", ctx->writeErrors);
+    ret = 1;
+  }
+  
+  nemo_lex_close(scanner);
+  free_ctx(ctx);
+  if(out)
+    fclose(out);
+  return ret;
+}
+#endif
+
+/*
+ libnemo: compile the NEMO text buf[0..len-1] with opts (NULL for the
+ defaults), handing each network's SBML, and XGMML with opts->xgmml, to sinks;
+ see nemo.h. Errors are reported on stderr as nemo2sbml reports them, and a
+ network with errors is not handed on. Returns the number of errors, or -1 if
+ the compile could not be started.
+*/
+int nemo_compile(const char *buf, size_t len, const NEMO_OPTIONS *opts, const NEMO_SINKS *out)
+{
+  int ret;
+  FILE *in;
+  NEMO_CTX *ctx;
+  yyscan_t scanner;
+  
+  if(opts && opts->prefix && strlen(opts->prefix) >= BUFSZ-32)
+  {
+    fprintf(stderr, "nemo_compile: prefix \"%s\" too long, returning...\n", opts->prefix);
+    return -1;
+  }
+  if(len == 0)
+    return 0;
+  
+  in = fmemopen((void *) buf, len, "r");
+  if(in == NULL)
+  {
+    fprintf(stderr, "nemo_compile: fmemopen error, returning...\n");
+    return -1;
+  }
+  ctx = new_ctx();
+  if(ctx == NULL)
+  {
+    fprintf(stderr, "nemo_compile: malloc error, returning...\n");
+    fclose(in);
+    return -1;
+  }
+  
+  ctx->seedval        = opts ? opts->seed : NEMO_SEED;
+  ctx->numThreads     = opts && opts->threads > 0 ? opts->threads : 1;
+  ctx->legacyRand     = opts ? opts->legacyRand : 0;
+  ctx->kineticLawInfo = opts ? opts->kineticLawInfo : 0;
+  ctx->parseInfo      = opts ? opts->parseInfo : 0;
+  ctx->xgmml          = opts ? opts->xgmml : 0;
+  ctx->netReactions   = opts ? opts->netReactions : 0;
+  ctx->layoutKind     = opts && ctx->xgmml ? opts->layout : LAYOUT_NONE;
+  strcpy(ctx->output, opts && opts->prefix ? opts->prefix : "");
+  legacy_seed(ctx, ctx->seedval);
+  
+  if(ctx->xgmml)
+  {
+    ctx->cytoBufSz = BUFSZ;
+    ctx->cytoBuf = (char *) malloc(ctx->cytoBufSz);
+    if(!ctx->cytoBuf)
+    {
+      fprintf(stderr, "nemo_compile: malloc error for cytoBuf, unable to generate xgmml...\n");
+      ctx->xgmml = 0;
+    }
+  }
+  
+  ctx->sinks      = out;
+  ctx->lex.errOut = out ? out->err : 0x0;
+  ctx->infoOut    = out ? out->info : 0x0;
+  scanner = nemo_lex_open(&ctx->lex, in);
+  if(scanner == NULL)
+  {
+    fprintf(stderr, "nemo_compile: malloc error for the scanner, returning...\n");
+    free_ctx(ctx);
+    fclose(in);
+    return -1;
+  }
+  new_document(ctx);
+  
+  do
+  {
+    yyparse(scanner, ctx);
+  }
+  while(!feof(in));
+  
+  /* what a parse that stopped early leaves behind */
+  drop_kinetic_laws(ctx);
+  pg_clear(ctx);
+  SBMLDocument_free(ctx->doc);
+  
+  ret = ctx->lex.numErrors;
+  nemo_lex_close(scanner);
+  free_ctx(ctx);
+  fclose(in);
+  return ret;
+}
+
+/* a parse with nemo2sbml's defaults, NULL on malloc error */
+NEMO_CTX * new_ctx(void)
+{
+  NEMO_CTX *ctx;
+
+  ctx = (NEMO_CTX *) calloc(1, sizeof(NEMO_CTX));
+  if(!ctx)
+    return NULL;
+  ctx->layout = layout_new();
+  if(!ctx->layout)
+  {
+    free(ctx);
+    return NULL;
+  }
+  ctx->edgeId     = 1;
+  ctx->firstP     = 1;
+  ctx->layoutKind = LAYOUT_NONE;
+  ctx->numThreads = 1;
+  ctx->paramTable = P_LOCAL;
+  ctx->seedval    = NEMO_SEED;
+  ctx->ssaOmega   = 1.0;
+  ctx->zformat    = Z_NONE;
+  ctx->zlevel     = -1;
+  pthread_mutex_init(&ctx->hillLock, NULL);
+  pthread_mutex_init(&ctx->sweepLock, NULL);
+  return ctx;
+}
+
+void free_ctx(NEMO_CTX *ctx)
+{
+  if(!ctx)
+    return;
+  if(ctx->cyto_body)
+    fclose(ctx->cyto_body);
+  free(ctx->cytoBuf);
+  free(ctx->hillJobs);
+  free(ctx->lawItems);
+  free(ctx->pgGenes);
+  free(ctx->sweep);
+  expr_reset(&ctx->syms);
+  layout_free(ctx->layout);
+  pthread_mutex_destroy(&ctx->hillLock);
+  pthread_mutex_destroy(&ctx->sweepLock);
+  free(ctx);
+}
+
+/* -l: start the parameters' stream where srand48(seed) would start drand48()'s */
+void legacy_seed(NEMO_CTX *ctx, long seed)
+{
+  ctx->xsubi[0] = 0x330e;
+  ctx->xsubi[1] = (unsigned short) seed;
+  ctx->xsubi[2] = (unsigned short) (seed >> 16);
+}
+
+/* create the SBML document for the next network: compartment, units, and
+ * the devNull species that synthesis draws from and degradation feeds
+ */
+void new_document(NEMO_CTX *ctx)
+{
+  Compartment_t    *compart;
+  Species_t        *species;
+  UnitDefinition_t *unitdef;
+
+  ctx->doc = SBMLDocument_createWith(SBML_LEVEL, SBML_VERSION);
+  ctx->model = SBMLDocument_createModel(ctx->doc);
+
+  compart = Model_createCompartment(ctx->model);
+  Compartment_setId(compart, sid);
+  Compartment_setVolume(compart, 1.0); /* 1 femtoliter, see below */
 
   /* cell volume is 10^-15 liters = 1 cubic micrometer = 1 femtoliter */
-  unitdef = Model_createUnitDefinition(model);
+  unitdef = Model_createUnitDefinition(ctx->model);
   UnitDefinition_setId(unitdef, "volume");
   UnitDefinition_setName(unitdef, "femtoliter");
   UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("litre"), 1, -15));
   
-  unitdef = Model_createUnitDefinition(model);
+  unitdef = Model_createUnitDefinition(ctx->model);
   UnitDefinition_setId(unitdef, "microM_cell");
   UnitDefinition_setName(unitdef, "microMole/cell");
   UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("mole"), 1, -6));
   UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("litre"), -1, -15));
 
-  unitdef = Model_createUnitDefinition(model);
+  unitdef = Model_createUnitDefinition(ctx->model);
   UnitDefinition_setId(unitdef, "hill_coeff");
   UnitDefinition_setName(unitdef, "Hill Coefficient");
   UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("dimensionless"), 1, 0)); /* 1 to 4 */
 
-  unitdef = Model_createUnitDefinition(model);
+  unitdef = Model_createUnitDefinition(ctx->model);
   UnitDefinition_setId(unitdef, "s_fl");
   UnitDefinition_setName(unitdef, "sec/femtoliter");
   UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("second"), 1, 0));
   UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("litre"), -1, -15));
 
-  unitdef = Model_createUnitDefinition(model);
+  unitdef = Model_createUnitDefinition(ctx->model);
   UnitDefinition_setId(unitdef, "s_mole");
   UnitDefinition_setName(unitdef, "sec/microMole");
   UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("second"), 1, 0));
   UnitDefinition_addUnit(unitdef, Unit_createWith(UnitKind_forName("mole"), -1, -6));
 
-  species = Model_createSpecies(model);
+  species = Model_createSpecies(ctx->model);
   Species_setId(species, "devNull");
   Species_setName(species, "devNull");
   Species_setCompartment(species, sid);
   Species_setInitialConcentration(species, 0.0);
   Species_setBoundaryCondition(species, 1);
   Species_setConstant(species, 1);
+}
+
+/* write the SBML (and XGMML, if asked for) of the network just parsed */
+void output_network(NEMO_CTX *ctx)
+{
+  char buf[8192], *sbml;
+  int i, ok;
+  size_t n;
+  NETWORK *net;
+  OUTFILE *sbml_out;
+  struct stat st;
+
+  tm_enter(T_SBML);
+  if(ctx->output[0])
+    sprintf(ctx->docbuf, "%s_%d", ctx->output, ctx->num_files++);
+  else
+    sprintf(ctx->docbuf, "regulatoryNetwork_%dgenes_%d", ctx->tot_genes, ctx->num_files++);
+  
+  Model_setId(ctx->model, ctx->docbuf);
+  
+  if(ctx->rand_func && ctx->user_func)
+    sprintf(ctx->modelname, "Synthetic Network: user specified input functions, and randomized parameters in generalized Hill Functions (nemo2sbml ver %s)", VERSION);
+  else if(ctx->rand_func)
+    sprintf(ctx->modelname, "Synthetic Network: randomized parameters in generalized Hill Functions (nemo2sbml ver %s)", VERSION);
+  else if(ctx->user_func)
+    sprintf(ctx->modelname, "Synthetic Network: user specified input functions (nemo2sbml ver %s)", VERSION);
+  else /* probably shouldn't get here */
+    sprintf(ctx->modelname, "Synthetic Network: no input functions (nemo2sbml ver %s)", VERSION);
+    
+  Model_setName(ctx->model, ctx->modelname);
+  tm_leave();
+  
+  tm_enter(T_WRITE);
+  strcat(ctx->docbuf, ".xml");
+  if(ctx->sinks)
+  {
+    ok = 0;
+    if((sbml = writeSBMLToString(ctx->doc)))
+    {
+      ok = !ctx->sinks->sbml || ctx->sinks->sbml(ctx->sinks->arg, ctx->num_files-1, Model_getId(ctx->model), sbml);
+      free(sbml);
+    }
+  }
+  else if(ctx->numVariants)
+  {
+    sweep_network(ctx);
+    ok = 1;
+  }
+  else if(ctx->zformat == Z_NONE)
+  {
+    unlink(ctx->docbuf); /* never write through a link, e.g. into the -C cache */
+    ok = writeSBML(ctx->doc, ctx->docbuf);
+    if(ok && !stat(ctx->docbuf, &st))
+      tm_bytes(st.st_size);
+    if(ok)
+      oc_note(ctx->docbuf);
+  }
+  else
+  {
+    /* libsbml only writes whole files or strings, so compress the string */
+    strcat(ctx->docbuf, out_suffix(ctx));
+    ok = 0;
+    if((sbml = writeSBMLToString(ctx->doc)))
+    {
+      if((sbml_out = out_open(ctx, ctx->docbuf)))
+      {
+        out_puts(sbml_out, sbml);
+        ok = !out_close(sbml_out);
+      }
+      free(sbml);
+    }
+  }
+  tm_leave();
+  
+  if(!ok)
+  {
+    fprintf(stderr, "nemo2sbml: Error, failed to write SBML document %s\n", ctx->docbuf);
+    ctx->writeErrors++;
+  }
+  else if(!ctx->sinks && !ctx->numVariants)
+    printf("SBML document written: %s\n", ctx->docbuf);
+  
+  if(ctx->paramTable && !ctx->sinks && !ctx->numVariants) /* -K writes a table with each variant */
+  {
+    tm_enter(T_WRITE);
+    param_table(ctx);
+    tm_leave();
+  }
+
+  if(ctx->simEnd > 0.0 || ctx->steadyState || ctx->jacobian)
+  {
+    tm_enter(T_ANALYSIS);
+    net = net_compile(ctx->model);
+    if(!net)
+      fprintf(stderr, "nemo2sbml: Error, can't simulate %s, continuing\n", Model_getId(ctx->model));
+    else
+    {
+      if(ctx->simEnd > 0.0)
+        simulate_network(ctx, net);
+      if(ctx->steadyState)
+        steady_network(ctx, net);
+      if(ctx->jacobian)
+        jacobian_network(ctx, net);
+      net_free(net);
+    }
+    tm_leave();
+  }
+
+  if(ctx->motifCensus)
+  {
+    tm_enter(T_ANALYSIS);
+    census_network(ctx);
+    tm_leave();
+  }
+
+  if(ctx->numParts && !ctx->sinks)
+  {
+    tm_enter(T_ANALYSIS);
+    partition_network(ctx);
+    tm_leave();
+  }
+
+  if(ctx->xgmml)
+  {
+    /* output xgmml file for cytoscape */
+    tm_enter(T_XGMML);
+    sprintf(ctx->docbuf, "cytoscapeGraph_%dgenes_%d.xgmml", ctx->tot_genes, ctx->num_files-1);
+    sprintf(buf, "<?xml version=\"1.0\"?>\n<graph label=\"%s\" id=\"0\" xmlns=\"http://www.cs.rpi.edu/XGMML\">\n", ctx->docbuf);
+    strcat(ctx->docbuf, out_suffix(ctx));
+    
+    if(ctx->layoutKind)
+      layout_compute(ctx->layout, ctx->layoutKind, ctx->numThreads);
+    
+    ctx->cyto_graph = ctx->sinks ? NULL : out_open(ctx, ctx->docbuf);
+    if(ctx->sinks)
+      xgmml_sink(ctx, buf);
+    else if(!ctx->cyto_graph)
+    {
+      fprintf(stderr, "nemo2sbml: Error, failed to open %s for writing, continuing\n", ctx->docbuf);
+    }
+    else
+    {
+      out_puts(ctx->cyto_graph, buf);
+      for(i=0; ctx->layoutKind && i<layout_count(ctx->layout); i++)
+      {
+        cyto_node(ctx, i, buf);
+        out_puts(ctx->cyto_graph, buf);
+      }
+      
+      /* the nodes and edges so far went to the body file as they were
+       * parsed, the rest is still in cytoBuf
+       */
+      if(ctx->cyto_body)
+      {
+        rewind(ctx->cyto_body);
+        while((n = fread(buf, 1, sizeof(buf), ctx->cyto_body)) > 0)
+          out_write(ctx->cyto_graph, buf, n);
+      }
+      out_write(ctx->cyto_graph, ctx->cytoBuf, ctx->cytoLen);
+      out_puts(ctx->cyto_graph, "</graph>\n");
+      
+      if(out_close(ctx->cyto_graph) || (ctx->cyto_body && ferror(ctx->cyto_body)))
+        fprintf(stderr, "nemo2sbml: Error, failed to write XGMML document %s\n", ctx->docbuf);
+      else
+        printf("XGMML document written: %s\n", ctx->docbuf);
+    }
+    tm_leave();
+  }
+}
+
+/* hand the XGMML of the network just written, head first, to the libnemo sink */
+void xgmml_sink(NEMO_CTX *ctx, char *head)
+{
+  char buf[8192];
+  int j;
+  size_t i, n;
+  STRBUF sb = {0x0, 0, 0, 0};
+  
+  sb_cat(&sb, head);
+  for(j=0; ctx->layoutKind && j<layout_count(ctx->layout); j++)
+  {
+    cyto_node(ctx, j, buf);
+    sb_cat(&sb, buf);
+  }
+  if(ctx->cyto_body)
+  {
+    rewind(ctx->cyto_body);
+    while((n = fread(buf, 1, sizeof(buf)-1, ctx->cyto_body)) > 0)
+    {
+      buf[n] = 0x0;
+      sb_cat(&sb, buf);
+    }
+    if(ferror(ctx->cyto_body))
+      sb.err = 1;
+  }
+  for(i=0; i<ctx->cytoLen; i+=n)
+  {
+    n = ctx->cytoLen-i < sizeof(buf)-1 ? ctx->cytoLen-i : sizeof(buf)-1;
+    memcpy(buf, ctx->cytoBuf+i, n);
+    buf[n] = 0x0;
+    sb_cat(&sb, buf);
+  }
+  sb_cat(&sb, "</graph>\n");
+  
+  if(sb.err || (ctx->sinks->xgmml && !ctx->sinks->xgmml(ctx->sinks->arg, ctx->num_files-1, Model_getId(ctx->model), sb.s)))
+    fprintf(stderr, "nemo2sbml: Error, failed to write XGMML document %s\n", ctx->docbuf);
+  free(sb.s);
+}
+
+/* the regulations of geneRegulated's law, for -M; tfs as for randomGeneralizedHill() */
+void census_law(char *geneRegulated, char *tfs)
+{
+  int i, ntf;
+  char **tf;
+  
+  if(!tfs || !(tf = hill_tokens(tfs, &ntf, NULL)))
+    return;
+  for(i=0; i<ntf; i++)
+    if(strstr(tf[i], "P"))
+      census_edge(atol(strstr(tf[i], "P")+1), atol(strstr(geneRegulated, "G")+1), strstr(tf[i], "+") ? C_ACT : C_REP);
+  free(tf);
+}
+
+/* count the motifs of the network just written, see census.c */
+void census_network(NEMO_CTX *ctx)
+{
+  char buf[64], name[2*BUFSZ], sgn[4];
+  char *motif[10] = {"genes", "regulations", "activations", "repressions", "autoregulation+", "autoregulation-",
+                     "cycle2+", "cycle2-", "cycle3+", "cycle3-"};
+  int i;
+  long count[10];
+  CENSUS c;
+  OUTFILE *ce_out;
+  
+  if(!census_count(&c))
+  {
+    fprintf(stderr, "nemo2sbml: Error, no motif census of %s, continuing\n", Model_getId(ctx->model));
+    return;
+  }
+  count[0] = c.genes;      count[1] = c.edges;      count[2] = c.act;        count[3] = c.rep;
+  count[4] = c.autoreg[0]; count[5] = c.autoreg[1]; count[6] = c.cycle2[0]; count[7] = c.cycle2[1];
+  count[8] = c.cycle3[0];  count[9] = c.cycle3[1];
+  
+  sprintf(name, "%s_census.txt%s", Model_getId(ctx->model), out_suffix(ctx));
+  ce_out = out_open(ctx, name);
+  if(!ce_out)
+  {
+    fprintf(stderr, "nemo2sbml: Error, failed to open %s for writing, continuing\n", name);
+    return;
+  }
+  
+  out_puts(ce_out, "# Motif\tCount\n");
+  for(i=0; i<10; i++)
+  {
+    sprintf(buf, "%s\t%ld\n", motif[i], count[i]);
+    out_puts(ce_out, buf);
+  }
+  
+  /* signs of X->Y, Y->Z, X->Z; coherent if X->Z has the sign of the path X->Y->Z */
+  for(i=0; i<8; i++)
+  {
+    sgn[0] = i & 4 ? '-' : '+';
+    sgn[1] = i & 2 ? '-' : '+';
+    sgn[2] = i & 1 ? '-' : '+';
+    sgn[3] = 0x0;
+    sprintf(buf, "ffl%s\t%ld\t%s\n", sgn, c.ffl[i], ((i>>2 ^ i>>1 ^ i) & 1) ? "incoherent" : "coherent");
+    out_puts(ce_out, buf);
+  }
+  sprintf(buf, "sim\t%ld\nsim_genes\t%ld\nsim_largest\t%ld\n", c.sims, c.simGenes, c.simLargest);
+  out_puts(ce_out, buf);
+  
+  if(out_close(ce_out))
+    fprintf(stderr, "nemo2sbml: Error, failed to write motif census %s\n", name);
+  else
+    printf("motif census written: %s (%ld feed-forward loops, %ld feedback cycles)\n", name,
+           c.ffl[0]+c.ffl[1]+c.ffl[2]+c.ffl[3]+c.ffl[4]+c.ffl[5]+c.ffl[6]+c.ffl[7],
+           c.cycle2[0]+c.cycle2[1]+c.cycle3[0]+c.cycle3[1]);
+}
+
+/* -g: the values of the model's parameters, in model order, as text or as native doubles */
+void param_table(NEMO_CTX *ctx)
+{
+  char name[2*BUFSZ];
+  
+  sprintf(name, "%s_params.%s%s", Model_getId(ctx->model), ctx->paramTable == P_CSV ? "csv" : "bin", out_suffix(ctx));
+  ctx->paramOut = out_open(ctx, name);
+  if(!ctx->paramOut)
+  {
+    fprintf(stderr, "nemo2sbml: Error, failed to open %s for writing, continuing\n", name);
+    return;
+  }
+  
+  /* param_row() stops the walk at a row it failed to write; get(n) would walk the list each time */
+  if((ctx->paramTable == P_CSV && !out_puts(ctx->paramOut, "id,value\n")) | (ListOf_find(Model_getListOfParameters(ctx->model), ctx, param_row) != NULL) |
+     out_close(ctx->paramOut))
+  {
+    fprintf(stderr, "nemo2sbml: Error, failed to write parameter table %s\n", name);
+    ctx->writeErrors++;
+  }
+  else
+    printf("parameter table written: %s (%u parameters)\n", name, Model_getNumParameters(ctx->model));
+  ctx->paramOut = NULL;
+}
+
+/* a row of the -g table, called by ListOf_find() for each parameter with the parse as arg; return 0 if it was not written */
+int param_row(const void *arg, const void *item)
+{
+  NEMO_CTX *ctx = (NEMO_CTX *) arg;
+
+  return put_param(ctx, ctx->paramOut, Parameter_getId((Parameter_t *) item), Parameter_getValue((Parameter_t *) item));
+}
+
+/* a row of a -g table, return 0 on failure */
+int put_param(NEMO_CTX *ctx, OUTFILE *of, const char *id, double value)
+{
+  char buf[BUFSZ];
+  
+  if(ctx->paramTable == P_BIN)
+    return out_write(of, (char *) &value, sizeof(double));
+  snprintf(buf, sizeof(buf), "%s,%.17g\n", id, value);
+  return out_puts(of, buf);
+}
+
+/* collect the model's parameters, in order, for the -g tables of the -K variants */
+int sweep_table(const void *arg, const void *item)
+{
+  NEMO_CTX *ctx = (NEMO_CTX *) arg;
+
+  ctx->sweepTable[ctx->numSweepTable++] = (Parameter_t *) item;
+  return 1; /* on to the next */
+}
+
+/* the -g table of variant k, with its values of the random parameters; return 0 on failure */
+int sweep_params(NEMO_CTX *ctx, int k)
+{
+  char name[2*BUFSZ];
+  int i, ok;
+  SWEEPPARAM *sp;
+  OUTFILE *of;
+  
+  sprintf(name, "%s_%d_params.%s%s", Model_getId(ctx->model), k, ctx->paramTable == P_CSV ? "csv" : "bin", out_suffix(ctx));
+  pthread_mutex_lock(&ctx->sweepLock);
+  of = out_open(ctx, name);
+  pthread_mutex_unlock(&ctx->sweepLock);
+  if(!of)
+    return 0;
+  
+  ok = ctx->paramTable != P_CSV || out_puts(of, "id,value\n");
+  for(i=0; ok && i<ctx->numSweepTable; i++)
+  {
+    sp = (SWEEPPARAM *) bsearch(Parameter_getId(ctx->sweepTable[i]), ctx->sweep, ctx->numSweep, sizeof(SWEEPPARAM), cmp_sweep);
+    ok = put_param(ctx, of, Parameter_getId(ctx->sweepTable[i]),
+                   sp ? param_range(sp->kind, seed_rand(ctx->seedval+k, sp->key, 3)) : Parameter_getValue(ctx->sweepTable[i]));
+  }
+  return !out_close(of) && ok;
+}
+
+/* remember a random parameter, named id, for the -K variants; return 0 on a realloc error */
+int sweep_param(NEMO_CTX *ctx, char *id, HILLPARAM *hp)
+{
+  SWEEPPARAM *sp;
+  
+  if(ctx->numSweep == ctx->sweepSz)
+  {
+    sp = (SWEEPPARAM *) realloc(ctx->sweep, (ctx->sweepSz+4096)*sizeof(SWEEPPARAM));
+    if(sp == NULL)
+    {
+      fprintf(stderr, "sweep_param: realloc error, returning 0...\n");
+      return 0;
+    }
+    ctx->sweep = sp;
+    ctx->sweepSz += 4096;
+  }
+  
+  sp = &ctx->sweep[ctx->numSweep++];
+  strncpy(sp->id, id, sizeof(sp->id)-1);
+  sp->id[sizeof(sp->id)-1] = 0x0;
+  sp->kind = hp->kind;
+  memcpy(sp->key, hp->key, sizeof(sp->key));
+  return 1;
+}
+
+/*
+ -K: write the network numVariants times, as <id>_<k>.xml, variant k with
+ the random parameters seed seedval+k would give it, so it is the network a
+ run with -s seedval+k writes, but for the model id. The model is written to
+ a string once, and the variants are copies of it with the model id and the
+ values of the random parameters replaced, made on numThreads threads; the
+ F() laws, and all the rest of the network, are the same in every variant.
+*/
+void sweep_network(NEMO_CTX *ctx)
+{
+  char name[2*BUFSZ];
+  int i, j, k, nthreads;
+  pthread_t *tid=0x0;
+  
+  ctx->sweepText = writeSBMLToString(ctx->doc);
+  ctx->sweepOk = (int *) calloc(ctx->numVariants, sizeof(int));
+  ctx->numSweepTable = 0;
+  ctx->sweepTable = ctx->paramTable ? (Parameter_t **) malloc((Model_getNumParameters(ctx->model)+1)*sizeof(Parameter_t *)) : NULL;
+  if(!ctx->sweepText || !ctx->sweepOk || (ctx->paramTable && !ctx->sweepTable))
+  {
+    fprintf(stderr, "nemo2sbml: Error, malloc error writing the variants of %s, continuing\n", Model_getId(ctx->model));
+    free(ctx->sweepText);
+    free(ctx->sweepOk);
+    free(ctx->sweepTable);
+    ctx->sweepText = NULL;
+    ctx->sweepTable = NULL;
+    ctx->numSweep = 0;
+    ctx->writeErrors++;
+    return;
+  }
+  if(ctx->paramTable)
+    ListOf_find(Model_getListOfParameters(ctx->model), ctx, sweep_table);
+  qsort(ctx->sweep, ctx->numSweep, sizeof(SWEEPPARAM), cmp_sweep);
+  
+  nthreads = ctx->numThreads < ctx->numVariants ? ctx->numThreads : ctx->numVariants;
+  if(nthreads > 1)
+    tid = (pthread_t *) malloc((nthreads-1)*sizeof(pthread_t));
+  
+  ctx->nextVariant = 0;
+  for(i=0; tid && i<nthreads-1; i++)
+  {
+    if(pthread_create(&tid[i], NULL, sweep_worker, ctx))
+    {
+      fprintf(stderr, "sweep_network: pthread_create error, using %d threads...\n", i+1);
+      break;
+    }
+  }
+  sweep_worker(ctx);
+  for(j=0; j<i; j++)
+    pthread_join(tid[j], NULL);
+  free(tid);
+  
+  for(k=0; k<ctx->numVariants; k++)
+  {
+    sprintf(name, "%s_%d.xml%s", Model_getId(ctx->model), k, out_suffix(ctx));
+    if(ctx->sweepOk[k] & 1)
+      printf("SBML document written: %s\n", name);
+    else
+    {
+      fprintf(stderr, "nemo2sbml: Error, failed to write SBML document %s\n", name);
+      ctx->writeErrors++;
+    }
+    
+    if(!ctx->paramTable)
+      continue;
+    sprintf(name, "%s_%d_params.%s%s", Model_getId(ctx->model), k, ctx->paramTable == P_CSV ? "csv" : "bin", out_suffix(ctx));
+    if(ctx->sweepOk[k] & 2)
+      printf("parameter table written: %s (%d parameters)\n", name, ctx->numSweepTable);
+    else
+    {
+      fprintf(stderr, "nemo2sbml: Error, failed to write parameter table %s\n", name);
+      ctx->writeErrors++;
+    }
+  }
+  
+  free(ctx->sweepText);
+  free(ctx->sweepOk);
+  free(ctx->sweepTable);
+  ctx->sweepText = NULL;
+  ctx->sweepTable = NULL;
+  ctx->numSweep = 0;
+}
+
+void * sweep_worker(void *arg)
+{
+  NEMO_CTX *ctx = (NEMO_CTX *) arg;
+  int k;
+  
+  for(;;)
+  {
+    pthread_mutex_lock(&ctx->sweepLock);
+    k = ctx->nextVariant++;
+    pthread_mutex_unlock(&ctx->sweepLock);
+    
+    if(k >= ctx->numVariants)
+      break;
+    
+    ctx->sweepOk[k] = sweep_variant(ctx, k) | (ctx->paramTable && sweep_params(ctx, k)) << 1; /* bit 0 the document, bit 1 its -g table */
+  }
+  
+  return NULL;
+}
+
+/* write variant k of sweepText, return 0 on failure */
+int sweep_variant(NEMO_CTX *ctx, int k)
+{
+  char id[32], name[2*BUFSZ], value[64], *e, *q, *s, *t;
+  SWEEPPARAM *sp;
+  OUTFILE *of;
+  
+  sprintf(name, "%s_%d.xml%s", Model_getId(ctx->model), k, out_suffix(ctx));
+  pthread_mutex_lock(&ctx->sweepLock); /* out_open() notes the file for -C */
+  of = out_open(ctx, name);
+  pthread_mutex_unlock(&ctx->sweepLock);
+  if(!of)
+    return 0;
+  
+  /* the model id */
+  s = ctx->sweepText;
+  if((q = strstr(s, "<model ")) && (q = strstr(q, " id=\"")) && (q = strchr(q+5, '"')))
+  {
+    out_write(of, s, q-s);
+    sprintf(value, "_%d", k);
+    out_puts(of, value);
+    s = q;
+  }
+  
+  /* the parameters, each <parameter id="..." value="..." .../> */
+  while((t = strstr(s, "<parameter ")))
+  {
+    e = strchr(t, '>');
+    q = strstr(t, " id=\"");
+    if(!e || !q || q > e)
+    {
+      out_write(of, s, t+1-s);
+      s = t+1;
+      continue;
+    }
+    q += 5;
+    snprintf(id, sizeof(id), "%.*s", (int)(strchr(q, '"')-q), q);
+    sp = (SWEEPPARAM *) bsearch(id, ctx->sweep, ctx->numSweep, sizeof(SWEEPPARAM), cmp_sweep);
+    q = strstr(t, " value=\"");
+    if(!sp || !q || q > e)
+    {
+      out_write(of, s, e+1-s);
+      s = e+1;
+      continue;
+    }
+    
+    q += 8;
+    out_write(of, s, q-s);
+    sprintf(value, "%.15g", param_range(sp->kind, seed_rand(ctx->seedval+k, sp->key, 3)));
+    out_puts(of, value);
+    s = strchr(q, '"');
+  }
+  out_puts(of, s);
+  
+  return !out_close(of);
+}
+
+/* SWEEPPARAMs by id; a bare id may be the key */
+int cmp_sweep(const void *a, const void *b)
+{
+  return strcmp(((const SWEEPPARAM *) a)->id, ((const SWEEPPARAM *) b)->id);
+}
+
+/* -P: split the network just written into numParts submodels, and write how they are coupled, see partition.c */
+void partition_network(NEMO_CTX *ctx)
+{
+  char buf[3*BUFSZ], name[2*BUFSZ], *sbml;
+  int i, j, ok;
+  OUTFILE *pa_out, *sbml_out;
+  PARTITION *pt;
+  SBMLDocument_t *part;
+  
+  pt = part_compute(ctx->model, ctx->numParts);
+  if(!pt)
+  {
+    fprintf(stderr, "nemo2sbml: Error, malloc error partitioning %s, continuing\n", Model_getId(ctx->model));
+    return;
+  }
+  
+  sprintf(name, "%s_partition.txt%s", Model_getId(ctx->model), out_suffix(ctx));
+  pa_out = out_open(ctx, name);
+  if(!pa_out)
+  {
+    fprintf(stderr, "nemo2sbml: Error, failed to open %s for writing, continuing\n", name);
+    part_free(pt);
+    return;
+  }
+  
+  sprintf(buf, "# %s in %d parts, %ld of %ld regulations cut\n# Part\tDocument\tSpecies\tBoundary\tReactions\n",
+          Model_getId(ctx->model), pt->k, pt->cut, pt->edges);
+  out_puts(pa_out, buf);
+  
+  for(i=0; i<pt->k; i++)
+  {
+    sprintf(ctx->docbuf, "%s_part%d.xml%s", Model_getId(ctx->model), i, out_suffix(ctx));
+    ok = 0;
+    if((part = part_document(ctx->doc, pt, i)))
+    {
+      if((sbml = writeSBMLToString(part)))
+      {
+        if((sbml_out = out_open(ctx, ctx->docbuf)))
+        {
+          out_puts(sbml_out, sbml);
+          ok = !out_close(sbml_out);
+        }
+        free(sbml);
+      }
+      SBMLDocument_free(part);
+    }
+    if(!ok)
+      fprintf(stderr, "nemo2sbml: Error, failed to write SBML document %s\n", ctx->docbuf);
+    
+    sprintf(buf, "%d\t%s\t%d\t%d\t%d\n", i, ctx->docbuf, pt->size[i], pt->boundary[i], pt->reactions[i]);
+    out_puts(pa_out, buf);
+  }
+  
+  /* the coupling: each species' part, and the parts that read it as a boundary species */
+  out_puts(pa_out, "# Species\tPart\tRead by\n");
+  for(i=0; i<pt->nspecies; i++)
+  {
+    if(pt->part[i] < 0)
+      continue;
+    sprintf(buf, "%s\t%d\t", pt->species[i], pt->part[i]);
+    out_puts(pa_out, buf);
+    for(j=pt->readOff[i]; j<pt->readOff[i+1]; j++)
+    {
+      sprintf(buf, j > pt->readOff[i] ? ",%d" : "%d", pt->readers[j]);
+      out_puts(pa_out, buf);
+    }
+    out_puts(pa_out, pt->readOff[i] == pt->readOff[i+1] ? "-\n" : "\n");
+  }
+  
+  if(out_close(pa_out))
+    fprintf(stderr, "nemo2sbml: Error, failed to write partition %s\n", name);
+  else
+    printf("partition written: %s (%d parts, %ld of %ld regulations cut)\n", name, pt->k, pt->cut, pt->edges);
+  part_free(pt);
+}
+
+/* integrate the network just written from 0 to simEnd, a row of
+ * concentrations every simDt in the column layout add_noise.r reads
+ */
+void simulate_network(NEMO_CTX *ctx, NETWORK *net)
+{
+  char name[2*BUFSZ];
+  int i, ret;
+  OUTFILE *sim_out;
+  NETOUT arg;
+  
+  sprintf(name, "%s.txt%s", Model_getId(ctx->model), out_suffix(ctx));
+  
+  sim_out = out_open(ctx, name);
+  if(!sim_out)
+  {
+    fprintf(stderr, "nemo2sbml: Error, failed to open %s for writing, continuing\n", name);
+    return;
+  }
+  
+  out_puts(sim_out, "# Time");
+  for(i=0; i<net->nspecies; i++)
+  {
+    if(!net->fixed[i])
+    {
+      out_puts(sim_out, "\t");
+      out_puts(sim_out, net->species[i]);
+    }
+  }
+  out_puts(sim_out, "\n");
+  
+  arg.ctx = ctx;
+  arg.net = net;
+  arg.out = sim_out;
+  ret = net_simulate(net, net->hill, net->param, ctx->simEnd, ctx->simDt, sim_row, &arg);
+  
+  if(out_close(sim_out) || ret > 0)
+    fprintf(stderr, "nemo2sbml: Error, failed to write time courses %s\n", name);
+  else if(ret < 0)
+    fprintf(stderr, "nemo2sbml: Error, simulation of %s stopped early, time courses in %s are partial\n", Model_getId(ctx->model), name);
+  else
+    printf("time courses written: %s\n", name);
+  
+  if(ctx->numSamples)
+    ensemble_network(ctx, net);
+  if(ctx->numTrajectories)
+    ssa_network(ctx, net);
+}
+
+/* -e: the steady state of the network just written, one species a line */
+void steady_network(NEMO_CTX *ctx, NETWORK *net)
+{
+  char buf[64], name[2*BUFSZ];
+  int i, ret;
+  double *y;
+  NETSTEADY info;
+  OUTFILE *st_out;
+  
+  y = (double *) malloc((net->nspecies+1)*sizeof(double));
+  if(!y)
+  {
+    fprintf(stderr, "nemo2sbml: Error, malloc error for the steady state of %s, continuing\n", Model_getId(ctx->model));
+    return;
+  }
+  
+  ret = net_steady(net, net->hill, net->param, y, &info);
+  if(ret)
+  {
+    if(ret > 0)
+      fprintf(stderr, "nemo2sbml: Error, no steady state found for %s after %d iterations (max |dy/dt| = %g), continuing\n",
+              Model_getId(ctx->model), info.iterations, info.residual);
+    free(y);
+    return;
+  }
+  
+  sprintf(name, "%s_steady.txt%s", Model_getId(ctx->model), out_suffix(ctx));
+  st_out = out_open(ctx, name);
+  if(!st_out)
+  {
+    fprintf(stderr, "nemo2sbml: Error, failed to open %s for writing, continuing\n", name);
+    free(y);
+    return;
+  }
+  
+  out_puts(st_out, "# Species\tSteady state\n");
+  for(i=0; i<net->nspecies; i++)
+  {
+    if(!net->fixed[i])
+    {
+      out_puts(st_out, net->species[i]);
+      sprintf(buf, "\t%.10g\n", y[i]);
+      out_puts(st_out, buf);
+    }
+  }
+  free(y);
+  
+  if(out_close(st_out))
+    fprintf(stderr, "nemo2sbml: Error, failed to write steady state %s\n", name);
+  else if(info.tIntegrated > 0.0)
+    printf("steady state written: %s (integrated to t = %g, then %d Newton iterations, max |dy/dt| = %g)\n",
+           name, info.tIntegrated, info.iterations, info.residual);
+  else
+    printf("steady state written: %s (%d Newton iterations, max |dy/dt| = %g)\n", name, info.iterations, info.residual);
+}
+
+/* -J: the Jacobian's pattern, and with -J partials its entries, of the network just written */
+void jacobian_network(NEMO_CTX *ctx, NETWORK *net)
+{
+  char name[2*BUFSZ];
+  int ret;
+  OUTFILE *jac_out;
+  
+  sprintf(name, "%s_jacobian.txt%s", Model_getId(ctx->model), out_suffix(ctx));
+  jac_out = out_open(ctx, name);
+  if(!jac_out)
+  {
+    fprintf(stderr, "nemo2sbml: Error, failed to open %s for writing, continuing\n", name);
+    return;
+  }
+  
+  ret = net_jacobian(net, ctx->jacobian == 2, jac_puts, jac_out);
+  if(out_close(jac_out) || ret)
+    fprintf(stderr, "nemo2sbml: Error, failed to write Jacobian %s\n", name);
+  else
+    printf("Jacobian written: %s\n", name);
+}
+
+/* see jacobian_network() */
+int jac_puts(void *arg, const char *s)
+{
+  return !out_puts((OUTFILE *) arg, (char *) s);
+}
+
+/* one line of time courses, see simulate_network() */
+int sim_row(void *arg, double t, const double *y)
+{
+  char buf[64];
+  int i;
+  NETWORK *net = ((NETOUT *) arg)->net;
+  OUTFILE *sim_out = ((NETOUT *) arg)->out;
+  
+  sprintf(buf, "%g", t);
+  out_puts(sim_out, buf);
+  for(i=0; i<net->nspecies; i++)
+  {
+    if(!net->fixed[i])
+    {
+      sprintf(buf, "\t%g", y[i]);
+      out_puts(sim_out, buf);
+    }
+  }
+  return !out_puts(sim_out, "\n");
+}
+
+/* -E: the mean and sd of the time courses over numSamples random parameter
+ * sets, drawn from the ranges the kinetic law parameters were drawn from
+ */
+void ensemble_network(NEMO_CTX *ctx, NETWORK *net)
+{
+  char buf[64], name[2*BUFSZ];
+  int failed, i, j, k, *kind, maxB=0, nout, ret;
+  double *mean, *sd;
+  char *isB;
+  OUTFILE *ens_out;
+  NETOUT arg;
+  
+  /* the kind of each parameter, by name; a K_/n_ with no B_ of its index is a non-linear term's */
+  kind = (int *) malloc((net->nparams+1)*sizeof(int));
+  for(j=0; j<net->nparams; j++)
+    if(!strncmp(net->params[j], "B_", 2) && atoi(net->params[j]+2) > maxB)
+      maxB = atoi(net->params[j]+2);
+  isB = (char *) calloc(maxB+1, 1);
+  if(!kind || !isB)
+  {
+    fprintf(stderr, "nemo2sbml: Error, malloc error for the ensemble of %s, continuing\n", Model_getId(ctx->model));
+    free(kind); free(isB);
+    return;
+  }
+  for(j=0; j<net->nparams; j++)
+    if(!strncmp(net->params[j], "B_", 2))
+      isB[atoi(net->params[j]+2)] = 1;
+  
+  for(j=0; j<net->nparams; j++)
+  {
+    i = atoi(net->params[j]+2);
+    if(!strncmp(net->params[j], "dc_", 3))
+      kind[j] = R_DC;
+    else if(!strncmp(net->params[j], "B_", 2))
+      kind[j] = R_B;
+    else if(!strncmp(net->params[j], "K_", 2))
+      kind[j] = i <= maxB && isB[i] ? R_K : R_NL_K;
+    else if(!strncmp(net->params[j], "n_", 2))
+      kind[j] = i <= maxB && isB[i] ? R_N : R_NL_N;
+    else
+      kind[j] = -1; /* e.g. of an explicit F(), keeps its value */
+  }
+  free(isB);
+  
+  arg.ctx  = ctx;
+  arg.net  = net;
+  arg.kind = kind;
+  ret = net_ensemble(net, ctx->numSamples, ctx->numThreads, ctx->simEnd, ctx->simDt, ens_sample, &arg, &mean, &sd, &failed);
+  free(kind);
+  if(ret)
+  {
+    fprintf(stderr, "nemo2sbml: Error, ensemble of %s failed, continuing\n", Model_getId(ctx->model));
+    return;
+  }
+  
+  if(failed == ctx->numSamples)
+  {
+    fprintf(stderr, "nemo2sbml: Error, all %d ensemble simulations of %s stopped early, continuing\n", failed, Model_getId(ctx->model));
+    free(mean); free(sd);
+    return;
+  }
+  
+  sprintf(name, "%s_ensemble.txt%s", Model_getId(ctx->model), out_suffix(ctx));
+  ens_out = out_open(ctx, name);
+  if(!ens_out)
+  {
+    fprintf(stderr, "nemo2sbml: Error, failed to open %s for writing, continuing\n", name);
+    free(mean); free(sd);
+    return;
+  }
+  
+  out_puts(ens_out, "# Time");
+  for(i=0; i<net->nspecies; i++)
+  {
+    if(!net->fixed[i])
+    {
+      out_puts(ens_out, "\t");
+      out_puts(ens_out, net->species[i]);
+      out_puts(ens_out, "_mean\t");
+      out_puts(ens_out, net->species[i]);
+      out_puts(ens_out, "_sd");
+    }
+  }
+  out_puts(ens_out, "\n");
+  
+  nout = (int) floor(ctx->simEnd/ctx->simDt + 1e-9) + 1;
+  for(k=0; k<nout; k++)
+  {
+    sprintf(buf, "%g", k*ctx->simDt);
+    out_puts(ens_out, buf);
+    for(i=0; i<net->nspecies; i++)
+    {
+      if(!net->fixed[i])
+      {
+        sprintf(buf, "\t%g\t%g", mean[k*net->nspecies+i], sd[k*net->nspecies+i]);
+        out_puts(ens_out, buf);
+      }
+    }
+    out_puts(ens_out, "\n");
+  }
+  free(mean); free(sd);
+  
+  if(out_close(ens_out))
+    fprintf(stderr, "nemo2sbml: Error, failed to write ensemble %s\n", name);
+  else
+  {
+    printf("ensemble written: %s (%d samples", name, ctx->numSamples-failed);
+    if(failed)
+      printf(", %d stopped early and left out", failed);
+    printf(")\n");
+  }
+}
+
+/* parameter set k of the ensemble, see ensemble_network(); arg has the kind of each parameter */
+void ens_sample(void *arg, int k, double *param)
+{
+  NETOUT *no = (NETOUT *) arg;
+  int j, *kind = no->kind;
+  unsigned long long key[2];
+  
+  for(j=0; j<no->net->nparams; j++)
+  {
+    if(kind[j] < 0)
+      param[j] = no->net->param[j];
+    else
+    {
+      key[0] = (unsigned long long)k << 8 | R_SAMPLE << 1;
+      key[1] = (unsigned long long)j + 1;
+      param[j] = param_range(kind[j], key_rand(no->ctx, key, 2));
+    }
+  }
+}
+
+/* -G: numTrajectories stochastic time courses, in molecules, one after another, see ssa.c */
+void ssa_network(NEMO_CTX *ctx, NETWORK *net)
+{
+  char name[2*BUFSZ];
+  int failed, i, ret;
+  OUTFILE *ssa_out;
+  NETOUT arg;
+  
+  sprintf(name, "%s_ssa.txt%s", Model_getId(ctx->model), out_suffix(ctx));
+  ssa_out = out_open(ctx, name);
+  if(!ssa_out)
+  {
+    fprintf(stderr, "nemo2sbml: Error, failed to open %s for writing, continuing\n", name);
+    return;
+  }
+  
+  out_puts(ssa_out, "# Run\tTime");
+  for(i=0; i<net->nspecies; i++)
+  {
+    if(!net->fixed[i])
+    {
+      out_puts(ssa_out, "\t");
+      out_puts(ssa_out, net->species[i]);
+    }
+  }
+  out_puts(ssa_out, "\n");
+  
+  arg.ctx = ctx;
+  arg.net = net;
+  arg.out = ssa_out;
+  ret = net_ssa(net, net->param, ctx->numTrajectories, ctx->numThreads, ctx->simEnd, ctx->simDt, ctx->ssaOmega, ctx->seedval, ssa_row, &arg, &failed);
+  
+  if(out_close(ssa_out) || ret)
+    fprintf(stderr, "nemo2sbml: Error, failed to write stochastic time courses %s\n", name);
+  else
+  {
+    printf("stochastic time courses written: %s (%d runs", name, ctx->numTrajectories-failed);
+    if(failed)
+      printf(", %d stopped early and left out", failed);
+    printf(")\n");
+  }
+}
+
+/* a row of trajectory k of the -G output */
+int ssa_row(void *arg, int k, double t, const double *x)
+{
+  char buf[DBL_MAX_10_EXP+8]; /* a count in %.0f is up to that many digits */
+  int i;
+  NETWORK *net = ((NETOUT *) arg)->net;
+  OUTFILE *ssa_out = ((NETOUT *) arg)->out;
+  
+  sprintf(buf, "%d\t%g", k, t);
+  out_puts(ssa_out, buf);
+  for(i=0; i<net->nspecies; i++)
+  {
+    if(!net->fixed[i])
+    {
+      sprintf(buf, "\t%.0f", x[i]);
+      out_puts(ssa_out, buf);
+    }
+  }
+  return !out_puts(ssa_out, "\n");
+}
+
+/* Tear down everything the network just written has built up, so that a
+ * file with any number of networks is compiled in bounded memory: the SBML
+ * document, the XGMML buffer and edge numbering, the symbol table of the
+ * F() laws, and the per-network counters. The lexer's gene/protein list is already freed by proteinsOK() at ']'.
+ */
+void reset_network(NEMO_CTX *ctx)
+{
+  char name[2*BUFSZ], path[2*BUFSZ+16];
+  struct rusage usage;
+  FILE *fp;
+
+  if(timing)
+  {
+    if(ctx->output[0])
+      sprintf(name, "%s_%d", ctx->output, ctx->num_files-1);
+    else
+      sprintf(name, "regulatoryNetwork_%dgenes_%d", ctx->tot_genes, ctx->num_files-1);
+    
+    if(timing == T_TEXT)
+      tm_report(stderr, ctx->num_files-1, name);
+    else
+    {
+      sprintf(path, "%s_timing.json", name);
+      if((fp = fopen(path, "w")))
+      {
+        tm_report(fp, ctx->num_files-1, name);
+        if(fclose(fp))
+          fprintf(stderr, "nemo2sbml: Error, failed to write %s, continuing\n", path);
+      }
+      else
+        fprintf(stderr, "nemo2sbml: Error, failed to open %s for writing, continuing\n", path);
+    }
+    tm_reset();
+  }
 
-  do
+  ctx->firstP = 1;
+  ctx->tot_genes = 0;
+  ctx->parameterIndex = 0;
+  ctx->rand_func = ctx->user_func = 0;
+  expr_reset(&ctx->syms);
+  if(ctx->motifCensus)
+    census_reset(); /* -M is nemo2sbml's alone, its census process-wide */
+  layout_reset(ctx->layout);
+  
+  tm_enter(T_SBML);
+  SBMLDocument_free(ctx->doc);
+  new_document(ctx);
+  tm_leave();
+  
+  if(ctx->xgmml)
   {
-    yyparse();
+    if(ctx->cyto_body)
+    {
+      fclose(ctx->cyto_body);
+      ctx->cyto_body = NULL;
+    }
+    ctx->cytoLen = 0;
+    ctx->edgeId = 1;
   }
-  while(!feof(yyin));
   
-  return 0;
+  if(ctx->memInfo && !getrusage(RUSAGE_SELF, &usage))
+    printf("network %d: peak RSS %ld kB\n", ctx->num_files-1, usage.ru_maxrss);
+}
+
+/* drop the network just parsed, which has errors: nothing is written for it */
+void skip_network(NEMO_CTX *ctx)
+{
+  fprintf(ctx->lex.errOut ? ctx->lex.errOut : stderr, "network %d: %d error(s), not written\n", ctx->num_files, ctx->lex.numErrors - ctx->errorsBefore);
+  ctx->errorsBefore = ctx->lex.numErrors;
+
+  drop_kinetic_laws(ctx);
+  pg_clear(ctx);
+  ctx->firstP  = 1;
+  ctx->num_sgn = 0;
+  ctx->transcriptionFactors[0] = 0x0;
+  ctx->num_files++; /* the networks after it keep their numbers */
+  reset_network(ctx);
 }
 
-int check_dor(char *dor_text)
+int check_dor(NEMO_CTX *ctx, char *dor_text)
 {
   /* For the first GENE, check that at every other GENE can be reached, i.e.
    * there is a path between any two GENEs through the Ps, thus the graph is 
@@ -2387,18 +4096,18 @@ int check_dor(char *dor_text)
    */
 
   int i, j;
-  char *buf, *p;
+  char *buf, *p, *save;
   size_t nmatch=RES;
   regmatch_t  pmatch[RES];
 
   /* init */
   for(i=0; i<GENES; i++)
   {
-    genes[i][0] = 0x0;
-    marked[i] = 0x0;
+    ctx->genes[i][0] = 0x0;
+    ctx->marked[i] = 0x0;
   }
 
-  regcomp(&preg, "P[0-9]*", REG_EXTENDED);
+  regcomp(&ctx->preg, "P[0-9]*", REG_EXTENDED);
 
   buf = (char *) malloc(strlen(dor_text)+8);
   if(buf == NULL)
@@ -2415,59 +4124,379 @@ int check_dor(char *dor_text)
   buf[j] = 0x0;
 
   i = 0;
-  if(p = strtok(buf, ")"))
+  if((p = strtok_r(buf, ")", &save)))
   {
-    if(!regexec(&preg, p, nmatch, pmatch, 0)) /* make sure a P lives here */
+    if(!regexec(&ctx->preg, p, nmatch, pmatch, 0)) /* make sure a P lives here */
     {
-      strcpy(genes[i++], p);
+      strcpy(ctx->genes[i++], p);
       //printf("%d: %s\n", i-1, genes[i-1]);
     }
   }
 
   do
   {
-    if(p = strtok(NULL, ")"))
+    if((p = strtok_r(NULL, ")", &save)))
     {
-      if(!regexec(&preg, p, nmatch, pmatch, 0))
+      if(!regexec(&ctx->preg, p, nmatch, pmatch, 0))
       {
-        strcpy(genes[i++], p);
+        strcpy(ctx->genes[i++], p);
         //printf("%d: %s\n", i-1, genes[i-1]);
       }
     }
   }
   while(p);
 
-  num_genes = i;
+  ctx->num_genes = i;
   
-  if(num_genes < 2)
+  if(ctx->num_genes < 2)
   {
     fprintf(stderr, "check_dor: error, num_genes < 2, exiting...\n");
     free(buf);
-    regfree(&preg);
+    regfree(&ctx->preg);
     return 0;
   }
 
-  mark_neighbors(0); /* recursive depth first search */
+  mark_neighbors(ctx, 0); /* recursive depth first search */
 
   /* every GENE (node) should have been visited */
-  for(i=0; i<num_genes; i++)
+  for(i=0; i<ctx->num_genes; i++)
   {
-    if(!marked[i]) /* failed */
+    if(!ctx->marked[i]) /* failed */
     {
       fprintf(stderr, "check_dor: error, DOR graph is not connected\n");
       free(buf);
-      regfree(&preg);
+      regfree(&ctx->preg);
       return 0;
     }
   }
 
   free(buf);
-  regfree(&preg);
+  regfree(&ctx->preg);
   return 1;
 }
 
+/* 
+ check_dor() with an on-disk cache: a DOR's connectivity depends only on its
+ text, so when a large hand-written file is recompiled after an edit, only the
+ DORs that changed are checked again. The cache file is named by a 64 bit
+ FNV-1a hash of the DOR text without white space, and holds that text so that
+ a hash collision is never taken for a hit. Only DORs that pass are cached.
+*/
+int check_dor_cached(NEMO_CTX *ctx, char *dor_text)
+{
+  int i, j, ok;
+  char *norm, path[2*BUFSZ];
+  unsigned long long hash = 14695981039346656037ULL;
+  size_t len;
+  FILE *fp;
+
+  tm_enter(T_DOR);
+  if(!ctx->cacheDir[0])
+  {
+    ok = check_dor(ctx, dor_text);
+    tm_leave();
+    return ok;
+  }
+
+  norm = (char *) malloc(strlen(dor_text)+1);
+  if(norm == NULL)
+  {
+    fprintf(stderr, "check_dor_cached: malloc error, not using the cache...\n");
+    ok = check_dor(ctx, dor_text);
+    tm_leave();
+    return ok;
+  }
+
+  for(i=j=0; dor_text[i]; i++)
+    if(!isspace((unsigned char)dor_text[i]))
+    {
+      norm[j++] = dor_text[i];
+      hash = (hash ^ (unsigned char)dor_text[i]) * 1099511628211ULL;
+    }
+  norm[j] = 0x0;
+  len = j;
+
+  sprintf(path, "%s/dor_%016llx_v%s", ctx->cacheDir, hash, VERSION);
+  if((fp = fopen(path, "r")))
+  {
+    /* hit only if the whole text matches */
+    for(i=0; i<len; i++)
+      if(getc(fp) != norm[i]) break;
+    ok = (i == len && getc(fp) == EOF);
+    fclose(fp);
+    if(ok)
+    {
+      ctx->cacheHits++;
+      free(norm);
+      tm_leave();
+      return 1;
+    }
+  }
+
+  ctx->cacheMisses++;
+  ok = check_dor(ctx, dor_text);
+  if(ok && (fp = fopen(path, "w")))
+  {
+    if(fwrite(norm, 1, len, fp) != len)
+    {
+      fclose(fp);
+      unlink(path);
+    }
+    else if(fclose(fp))
+      unlink(path);
+  }
+
+  free(norm);
+  tm_leave();
+  return ok;
+}
+
+/* 
+ -c: note the DOR, GLIST or TMLIST just parsed (kind 'D', 'G' or 'T'), whose
+ laws are the ones queued since the last one. Their formulas and parameters
+ depend only on its text, the seed and -n, but for the index their parameter
+ ids start at, so an unchanged one gets them from the cache, renumbered, see
+ build_kinetic_laws(). Not with -l, whose values depend on all that was
+ parsed before.
+*/
+void law_cache_note(NEMO_CTX *ctx, int kind, char *text)
+{
+  int i, j;
+  unsigned long long hash = 14695981039346656037ULL;
+  LAWITEM *item;
+
+  if(!ctx->cacheDir[0] || ctx->legacyRand || ctx->numHillJobs == ctx->itemJob)
+  {
+    ctx->itemJob = ctx->numHillJobs;
+    return;
+  }
+  
+  if(ctx->numLawItems == ctx->lawItemsSz)
+  {
+    item = (LAWITEM *) realloc(ctx->lawItems, (ctx->lawItemsSz+64)*sizeof(LAWITEM));
+    if(item == NULL)
+    {
+      fprintf(stderr, "law_cache_note: realloc error, not using the cache for these laws...\n");
+      ctx->itemJob = ctx->numHillJobs;
+      return;
+    }
+    ctx->lawItems = item;
+    ctx->lawItemsSz += 64;
+  }
+  
+  item = &ctx->lawItems[ctx->numLawItems];
+  item->text = (char *) malloc(strlen(text)+2);
+  if(item->text == NULL)
+  {
+    fprintf(stderr, "law_cache_note: malloc error, not using the cache for these laws...\n");
+    ctx->itemJob = ctx->numHillJobs;
+    return;
+  }
+  
+  item->text[0] = kind;
+  hash = (hash ^ (unsigned char)kind) * 1099511628211ULL;
+  for(i=0, j=1; text[i]; i++)
+    if(!isspace((unsigned char)text[i]))
+    {
+      item->text[j++] = text[i];
+      hash = (hash ^ (unsigned char)text[i]) * 1099511628211ULL;
+    }
+  item->text[j] = 0x0;
+  
+  item->hash  = hash;
+  item->first = ctx->itemJob;
+  item->num   = ctx->numHillJobs - ctx->itemJob;
+  item->hit   = 0;
+  ctx->numLawItems++;
+  ctx->itemJob = ctx->numHillJobs;
+}
+
+/* the cache file of an item: the hash of its text, and the rest its laws depend on */
+void law_cache_path(NEMO_CTX *ctx, LAWITEM *item, char *path)
+{
+  sprintf(path, "%s/law_%016llx_s%ld_n%d_v%s", ctx->cacheDir, item->hash, ctx->seedval, ctx->netReactions, VERSION);
+#ifdef NON_LINEAR
+  strcat(path, "_nonlinear");
+#endif
+}
+
+/* 
+ Fill in the laws of each noted item found in the cache, so that hill_worker()
+ skips them. An entry holds the item's text, so a hash collision is never
+ taken for a hit, then for each law the index its parameters started at, its
+ parameters (values in hex, so they are read back bit for bit) and its
+ formula, all renumbered here to where the law's parameters start now.
+*/
+void law_cache_load(NEMO_CTX *ctx)
+{
+  static char *prefixes[] = {"dc_", "B_", "K_", "n_"};
+  int delta, i, index, j, k, len, m, nparams, ok;
+  char *f, path[2*BUFSZ], prefix[8];
+  size_t flen;
+  FILE *fp;
+  HILLJOB *job;
+  HILLPARAM *hp;
+  LAWITEM *item;
+
+  for(i=0; i<ctx->numLawItems; i++)
+  {
+    item = &ctx->lawItems[i];
+    law_cache_path(ctx, item, path);
+    if(!(fp = fopen(path, "r")))
+    {
+      ctx->lawMisses++;
+      continue;
+    }
+    
+    len = strlen(item->text);
+    for(j=0; j<len; j++)
+      if(getc(fp) != item->text[j]) break;
+    ok = j == len && getc(fp) == '\n' && fscanf(fp, "%d", &k) == 1 && k == item->num;
+    
+    for(j=0; ok && j<item->num; j++)
+    {
+      job = &ctx->hillJobs[item->first+j];
+      job->cached = 1;
+      if(fscanf(fp, "%d %d %zu", &index, &nparams, &flen) != 3 || nparams <= 0 ||
+         !(job->params = (HILLPARAM *) malloc(nparams*sizeof(HILLPARAM))))
+      {
+        ok = 0;
+        break;
+      }
+      job->paramsSz = nparams;
+      delta = job->index - index;
+      
+      for(k=0; ok && k<nparams; k++)
+      {
+        hp = &job->params[k];
+        ok = fscanf(fp, "%7s %d %la %d %llu %llu %llu", prefix, &hp->index, &hp->value, &hp->kind,
+                    &hp->key[0], &hp->key[1], &hp->key[2]) == 7;
+        for(m=0; ok && m<4 && strcmp(prefix, prefixes[m]); m++) ;
+        if(ok && m < 4)
+        {
+          hp->prefix = prefixes[m];
+          hp->index += delta;
+          job->nparams++;
+        }
+        else
+          ok = 0;
+      }
+      
+      f = ok ? (char *) malloc(flen+1) : 0x0;
+      ok = f && getc(fp) == '\n' && fread(f, 1, flen, fp) == flen && getc(fp) == '\n';
+      if(ok)
+      {
+        f[flen] = 0x0;
+        law_renumber(&job->formula, f, delta);
+        ok = !job->formula.err;
+      }
+      free(f);
+    }
+    fclose(fp);
+    
+    if(ok)
+    {
+      item->hit = 1;
+      ctx->lawHits++;
+      continue;
+    }
+    
+    /* stale or broken: build these laws, and store them again */
+    for(j=0; j<item->num; j++)
+    {
+      job = &ctx->hillJobs[item->first+j];
+      free(job->params);
+      free(job->formula.s);
+      job->params  = 0x0;
+      job->nparams = job->paramsSz = 0;
+      memset(&job->formula, 0, sizeof(STRBUF));
+      job->cached  = 0;
+    }
+    ctx->lawMisses++;
+  }
+}
+
+/* write the laws of each noted item that was not in the cache, if they were all built */
+void law_cache_store(NEMO_CTX *ctx)
+{
+  int i, j, k, ok;
+  char path[2*BUFSZ], tmpPath[2*BUFSZ+32];
+  FILE *fp;
+  HILLJOB *job;
+  HILLPARAM *hp;
+  LAWITEM *item;
+
+  for(i=0; i<ctx->numLawItems; i++)
+  {
+    item = &ctx->lawItems[i];
+    for(j=0; !item->hit && j<item->num && !ctx->hillJobs[item->first+j].err; j++) ;
+    if(item->hit || j < item->num)
+      continue;
+    
+    /* written aside and renamed, so another nemo2sbml never reads half an entry */
+    law_cache_path(ctx, item, path);
+    sprintf(tmpPath, "%s.%ld", path, (long) getpid());
+    if(!(fp = fopen(tmpPath, "w")))
+      continue;
+    
+    fprintf(fp, "%s\n%d\n", item->text, item->num);
+    for(j=0; j<item->num; j++)
+    {
+      job = &ctx->hillJobs[item->first+j];
+      fprintf(fp, "%d %d %zu\n", job->index, job->nparams, job->formula.len);
+      for(k=0; k<job->nparams; k++)
+      {
+        hp = &job->params[k];
+        fprintf(fp, "%s %d %a %d %llu %llu %llu\n", hp->prefix, hp->index, hp->value, hp->kind,
+                hp->key[0], hp->key[1], hp->key[2]);
+      }
+      fprintf(fp, "%s\n", job->formula.s);
+    }
+    
+    ok = !ferror(fp);
+    if(fclose(fp) || !ok || rename(tmpPath, path))
+      unlink(tmpPath);
+  }
+}
+
+/* copy formula f to sb, with the index of each dc_, B_, K_ and n_ parameter moved by delta */
+void law_renumber(STRBUF *sb, char *f, int delta)
+{
+  static char *prefixes[] = {"dc_", "B_", "K_", "n_"};
+  int m;
+  size_t k, n, plen;
+
+  if(!delta) /* the laws before any edit */
+  {
+    sb_cat(sb, f);
+    return;
+  }
+  
+  while(*f)
+  {
+    /* a name or number, or else a run of the characters between them */
+    for(n=0; f[n] && (isalnum((unsigned char)f[n]) || f[n] == '_'); n++) ;
+    if(!n)
+      for(n=0; f[n] && !isalnum((unsigned char)f[n]) && f[n] != '_'; n++) ;
+    
+    for(m=0; m<4; m++)
+    {
+      plen = strlen(prefixes[m]);
+      if(n > plen && !strncmp(f, prefixes[m], plen) && strspn(f+plen, "0123456789") == n-plen)
+        break;
+    }
+    
+    if(m < 4)
+      sb_printf(sb, "%s%d", prefixes[m], atoi(f+plen)+delta);
+    else
+      for(k=0; k<n; k+=BUFSZ-1)
+        sb_printf(sb, "%.*s", (int) (n-k < BUFSZ-1 ? n-k : BUFSZ-1), f+k);
+    f += n;
+  }
+}
+
 /* mark neigboring nodes recursively */
-void mark_neighbors(int gene_idx)
+void mark_neighbors(NEMO_CTX *ctx, int gene_idx)
 {
   int j;
   long ioff, joff;
@@ -2475,29 +4504,29 @@ void mark_neighbors(int gene_idx)
   size_t in=RES, jn=RES;
   regmatch_t  ip[RES], jp[RES];
 
-  if(marked[gene_idx]) return; /* this node has been visited */
-  marked[gene_idx] = 0x1;
+  if(ctx->marked[gene_idx]) return; /* this node has been visited */
+  ctx->marked[gene_idx] = 0x1;
 
   /* for every P of gene, mark all the other genes that P regulates */
   ioff = 0;
-  while(!regexec(&preg, genes[gene_idx]+ioff, in, ip, 0))
+  while(!regexec(&ctx->preg, ctx->genes[gene_idx]+ioff, in, ip, 0))
   {
-    strncpy(p_bufi, genes[gene_idx]+ioff+ip[0].rm_so, ip[0].rm_eo-ip[0].rm_so);
+    strncpy(p_bufi, ctx->genes[gene_idx]+ioff+ip[0].rm_so, ip[0].rm_eo-ip[0].rm_so);
     p_bufi[ip[0].rm_eo-ip[0].rm_so] = 0x0;
 
     /* look for a match to p_bufi in other p_lists */
-    for(j=0; j<num_genes; j++)
+    for(j=0; j<ctx->num_genes; j++)
     {
       if(j==gene_idx) continue;
 
       joff = 0;
-      while(!regexec(&preg, genes[j]+joff, jn, jp, 0))
+      while(!regexec(&ctx->preg, ctx->genes[j]+joff, jn, jp, 0))
       {
-        strncpy(p_bufj, genes[j]+joff+jp[0].rm_so, jp[0].rm_eo-jp[0].rm_so);
+        strncpy(p_bufj, ctx->genes[j]+joff+jp[0].rm_so, jp[0].rm_eo-jp[0].rm_so);
         p_bufj[jp[0].rm_eo-jp[0].rm_so] = 0x0;
 
         if(!strcmp(p_bufi, p_bufj)) /* a match */
-          mark_neighbors(j); /* recursive depth first search */
+          mark_neighbors(ctx, j); /* recursive depth first search */
 
         joff += jp[0].rm_eo;
       }
@@ -2507,12 +4536,16 @@ void mark_neighbors(int gene_idx)
 }
 
 /* 
- Return a Kinetic Law string. This particular implementation is a generalized
+ Queue a Kinetic Law. This particular implementation is a generalized
  Hill Function with randomized parameters*, but can be replaced with the 
  biochemical model of your choice, as long as the code in the grammar is also
  altered accordingly to pass the proper parameters.
  tfs (transcription factors string) format: ([+-]P[,;])*
  
+ The reactions, species and modifiers are made here, in parse order, while the
+ law itself (formula and parameters) is left to hill_formula(), run for every
+ queued gene of the network by build_kinetic_laws(), see -j.
+ 
  *see Likhoshvai V., Ratushny A., "Generalized Hill Function Method for 
  Modeling Molecular Processes", Journal of Bioinformatics and Computaional
  Biology, vol 5, issue 2B, pg 521-531, April 2007
@@ -2520,610 +4553,1006 @@ void mark_neighbors(int gene_idx)
  Comment out the "#define NON_LINEAR" statement above to use linear terms
  only in the Hill function
 */
-char * randomGeneralizedHill(char *geneRegulated, char *tfs)
+char * randomGeneralizedHill(NEMO_CTX *ctx, char *geneRegulated, char *tfs)
 {
-  int denom_sz, numer_sz;
-  char buf[32], *denom, *numer, *p=0x0, savP[32], *sav_tfs;
-  KineticLaw_t  *dl;
-  Reaction_t *degrad;
+  int i, j, nnl=0, ntf=0;
+  char buf[BUFSZ], **tf=0x0;
+  HILLJOB *job;
+  KineticLaw_t  *dl=0x0;
+  ModifierSpeciesReference_t *msr;
+  Reaction_t *degrad=0x0;
+  Species_t *species;
+  SpeciesReference_t *reactant;
 
-  denom = (char *) malloc(NLT_SZ);
-  numer = (char *) malloc(NLT_SZ);
-  if(denom==NULL || numer==NULL)
+  tm_enter(T_HILL);
+  if(ctx->motifCensus)
+    census_law(geneRegulated, tfs);
+  if(ctx->numHillJobs == ctx->hillJobsSz)
+  {
+    job = (HILLJOB *) realloc(ctx->hillJobs, (ctx->hillJobsSz+BUFSZ)*sizeof(HILLJOB));
+    if(job == NULL)
+    {
+      fprintf(stderr, "randomGeneralizedHill: realloc error, returning NULL Kinetic Law for %s\n", geneRegulated);
+      tm_leave();
+      return NULL;
+    }
+    ctx->hillJobs = job;
+    ctx->hillJobsSz += BUFSZ;
+  }
+  job = &ctx->hillJobs[ctx->numHillJobs];
+  memset(job, 0, sizeof(HILLJOB));
+  
+  job->gene = strdup(geneRegulated);
+  job->tfs  = strdup(tfs);
+  if(job->gene==NULL || job->tfs==NULL || (tf = hill_tokens(tfs, &ntf, &nnl))==NULL)
   {
-    fprintf(stderr, "randomGeneralizedHill: malloc error, returning NULL...\n");
+    fprintf(stderr, "randomGeneralizedHill: malloc error, returning NULL Kinetic Law for %s\n", geneRegulated);
+    free(job->gene);
+    free(job->tfs);
+    tm_leave();
     return NULL;
   }
-  denom_sz = numer_sz = NLT_SZ;
-
-  /* degradation */
-  dl = KineticLaw_create();
-  degrad = Model_createReaction(model);
-  strcpy(denom, "P"); /* borrow the denom array as a buffer */
-  strcat(denom, strstr(geneRegulated, "G")+1);
-  strcat(denom, "_degrad");
-  Reaction_setId(degrad, denom);
-  strcpy(denom, "P"); 
-  strcat(denom, strstr(geneRegulated, "G")+1);
-  strcat(denom, " degradation");
-  Reaction_setName(degrad, denom);
-  
-  sprintf(buf, "dc_%d", parameterIndex);
-  dparam = Parameter_createWith(buf, 0.01+drand48()/10, "dimensionless"); /* drand48 is uniform rand [0.0 - 1.0) */
-  KineticLaw_addParameter(dl, dparam);
-  Reaction_setReversible(degrad, 0); /* balance of degradation is below */
   
-  /* synthesis */
-  strcpy(denom, "P"); 
-  strcat(denom, strstr(geneRegulated, "G")+1);
-  strcat(denom, "_synthesis");
-  Reaction_setId(react, denom);
-
-  strcpy(denom, "P"); 
-  strcat(denom, strstr(geneRegulated, "G")+1);
-  strcat(denom, " synthesis");
-  Reaction_setName(react, denom);
-  Reaction_setReversible(react, 0);
-
-  strcpy(denom, "P"); 
-  strcat(denom, strstr(geneRegulated, "G")+1);
-  reactant = SpeciesReference_createWith(denom, 1.0, 1);
-  Reaction_addProduct(react, reactant);
-  Reaction_addReactant(react, SpeciesReference_createWith("devNull", 1.0, 1));
-  
-  /* balance of degradation */
-  Reaction_addProduct(degrad, SpeciesReference_createWith("devNull", 1.0, 1));
-  Reaction_addReactant(degrad, reactant);
-  strcpy(numer, buf); /* borrow the numer array as a buffer */
-  strcat(numer, "*");
-  strcat(numer, denom);
-  KineticLaw_setFormula(dl, numer);
-  Reaction_setKineticLaw(degrad, dl);
-  
-  
-  if(!Model_getSpeciesById(model, denom)) /* has this species been created yet? */
-  {
-    species = Model_createSpecies(model);
-    Species_setId(species, denom);
-    Species_setName(species, denom);
+  if(!ntf)
+  {
+    fprintf(stderr, "randomGeneralizedHill: NULL tfs, returning NULL Kinetic Law for %s\n", geneRegulated);
+    free(job->gene);
+    free(job->tfs);
+    free(tf);
+    tm_leave();
+    return NULL;
+  }
+
+  /* degradation, or with -n, a term of the synthesis law (see hill_formula()) */
+  if(ctx->netReactions)
+    dl = ctx->kl;
+  else
+  {
+    dl = KineticLaw_create();
+    degrad = Model_createReaction(ctx->model);
+    sprintf(buf, "P%s_degrad", strstr(geneRegulated, "G")+1);
+    Reaction_setId(degrad, buf);
+    sprintf(buf, "P%s degradation", strstr(geneRegulated, "G")+1);
+    Reaction_setName(degrad, buf);
+    Reaction_setReversible(degrad, 0); /* balance of degradation is below */
+  }
+  
+  /* synthesis; the net rate may be negative, so that reaction is reversible */
+  sprintf(buf, ctx->netReactions ? "P%s_net" : "P%s_synthesis", strstr(geneRegulated, "G")+1);
+  Reaction_setId(ctx->react, buf);
+  sprintf(buf, ctx->netReactions ? "P%s net synthesis" : "P%s synthesis", strstr(geneRegulated, "G")+1);
+  Reaction_setName(ctx->react, buf);
+  Reaction_setReversible(ctx->react, ctx->netReactions);
+
+  sprintf(buf, "P%s", strstr(geneRegulated, "G")+1);
+  reactant = SpeciesReference_createWith(buf, 1.0, 1);
+  Reaction_addProduct(ctx->react, reactant);
+  Reaction_addReactant(ctx->react, SpeciesReference_createWith("devNull", 1.0, 1));
+  
+  /* balance of degradation, with its own species reference since the
+   * reaction owns (and frees) whatever is added to it
+   */
+  if(!ctx->netReactions)
+  {
+    Reaction_addProduct(degrad, SpeciesReference_createWith("devNull", 1.0, 1));
+    Reaction_addReactant(degrad, SpeciesReference_createWith(buf, 1.0, 1));
+  }
+  
+  if(!Model_getSpeciesById(ctx->model, buf)) /* has this species been created yet? */
+  {
+    species = Model_createSpecies(ctx->model);
+    Species_setId(species, buf);
+    Species_setName(species, buf);
     Species_setCompartment(species, sid);
     Species_setInitialConcentration(species, 1.0);
   }
   
-  /* save tfs string */
-  sav_tfs = (char *) malloc(strlen(tfs)+8);
-  if(sav_tfs == NULL)
+  if(!ctx->netReactions)
   {
-    fprintf(stderr, "randomGeneralizedHill: malloc error, returning NULL Kinetic Law for %s\n", geneRegulated);
-    return NULL;
+    sprintf(buf, "dc_%d*P%s", ctx->parameterIndex, strstr(geneRegulated, "G")+1);
+    KineticLaw_setFormula(dl, buf);
+    Reaction_setKineticLaw(degrad, dl);
   }
-  strcpy(sav_tfs, tfs);
-
-  /* build the numerator and denominator strings */
-  p = strtok(tfs, " ,;)");
-  if(p)
+  
+  for(i=0; i<ntf; i++)
+  {
+    msr = ModifierSpeciesReference_createWith(strstr(tf[i], "P"));
+    Reaction_addModifier(ctx->react, msr);
+  }
+  
+  /* reserve the parameter indices of this law, so the next gene's are known now */
+  job->kl    = ctx->kl;
+  job->dl    = dl;
+  job->index = ctx->parameterIndex;
+  
+  for(i=0; i<ntf; i++)
   {
-    strcpy (numer, "(");
-    strcpy (denom, "/(1+power(");
+    ctx->parameterIndex++;
+#ifdef NON_LINEAR
+    for(j=0; j<nnl; j++)
+      if(hill_other(tf[i], tf[j]))
+        ctx->parameterIndex += strstr(tf[i], "+") ? 2 : 1; /* activators have a term above and below */
+#endif
+  }
+  
+  free(tf);
+  ctx->numHillJobs++;
+  tm_leave();
+  return job->gene;
+}
 
-    sprintf(buf, "B_%d", parameterIndex);
-    strcat (numer, buf);
+/* 
+ Split a copy of tfs into its "[+-]P<n>" tokens, *ntf of them. The tokens
+ point into the copy, which is freed along with the returned array. The
+ non-linear terms take only the first *nnl (if nnl is not NULL): the old
+ insertNonLinearTerms() split tfs with strsep(), which stops at the first
+ empty token, so -l output stays as it was for tfs with two delimiters in
+ a row.
+*/
+char ** hill_tokens(char *tfs, int *ntf, int *nnl)
+{
+  char *copy, **tf, *save, *tok;
+  size_t len;
+  
+  tf = (char **) malloc((strlen(tfs)/2+2)*sizeof(char *) + strlen(tfs)+1);
+  if(tf == NULL)
+    return NULL;
+  
+  copy = (char *) (tf + strlen(tfs)/2+2);
+  strcpy(copy, tfs);
+  
+  *ntf = 0;
+  for(tok = strtok_r(copy, " ,;)", &save); tok; tok = strtok_r(NULL, " ,;)", &save))
+    tf[(*ntf)++] = tok;
+  
+  if(nnl)
+  {
+    *nnl = 0;
+    for(tok = tfs; (len = strcspn(tok, " ,;)")) > 0; tok += len+1)
+    {
+      ++*nnl;
+      if(!tok[len])
+        break;
+    }
+  }
+  
+  return tf;
+}
 
-    param = Parameter_createWith(buf, 0.0001+drand48(), "microM_cell"); /* 0.0001 ~ 1.0 */
-    KineticLaw_addParameter(kl, param);
+/* does tf other get a non-linear term in the part of the law for tf? */
+int hill_other(char *tf, char *other)
+{
+  char savP[BUFSZ];
+  
+  sprintf(savP, "%c%s", strstr(tf, "+") ? '+' : '-', strstr(tf, "P"));
+  return strcmp(other, savP) != 0;
+}
 
-    if(strstr(p, "+")) /* activator */
+/* 
+ Build the formula and draw the parameters of a queued law. Only the job is
+ touched, so any number of these may run at once (unless -l, since its
+ drand48() stream then has to be drawn in parse order).
+*/
+int hill_formula(NEMO_CTX *ctx, HILLJOB *job)
+{
+  int gene, i, idx, nnl, ntf;
+  char **tf;
+  STRBUF numer = {0}, denom = {0};
+  
+  tf = hill_tokens(job->tfs, &ntf, &nnl);
+  if(tf == NULL)
+  {
+    fprintf(stderr, "hill_formula: malloc error, returning NULL Kinetic Law for %s\n", job->gene);
+    return 0;
+  }
+  
+  gene = atoi(strstr(job->gene, "G")+1);
+  idx  = job->index;
+  
+  hill_param(ctx, job, "dc_", idx, R_DC, gene, NULL, NULL, 0);
+  
+  /* build the numerator and denominator strings */
+  sb_cat(&numer, "(");
+  sb_cat(&denom, "/(1+");
+  for(i=0; i<ntf; i++)
+  {
+    if(i)
     {
-      strcat (numer, "*power(");
-      sprintf(buf, "%s", strstr(p, "P"));
-      strcpy(savP, "+");
-      strcat(savP, buf);
-      msr = ModifierSpeciesReference_createWith(buf);
-      Reaction_addModifier(react, msr);
-      strcat (numer, buf);
-      strcat (denom, buf);
-      strcat (numer, "/");
-      strcat (denom, "/");
-      sprintf(buf, "K_%d", parameterIndex);
-      strcat (numer, buf);
-      strcat (denom, buf);
-      strcat (numer, ", ");
-      strcat (denom, ", ");
-
-      param = Parameter_createWith(buf, 0.5+drand48(), "microM_cell"); /* 0.5 ~ 1.5 */
-      KineticLaw_addParameter(kl, param);
-
-      sprintf(buf, "n_%d", parameterIndex);
-      strcat (numer, buf);
-      strcat (denom, buf);
-
-      param = Parameter_createWith(buf, 1.0+floor(4*drand48()), "hill_coeff"); /* 1 - 4 */
-      KineticLaw_addParameter(kl, param);
-
-      strcat (numer, ")");
-      strcat (denom, ")");
-      
-      if((denom_sz - strlen(denom)) < NLT_SZ)
-      {
-        denom = realloc(denom, denom_sz + NLT_SZ);
-        if(denom == NULL)
-        {
-          fprintf(stderr, "randomGeneralizedHill: realloc error, returning NULL Kinetic Law for %s\n", geneRegulated);
-          return NULL;
-        }
-        denom_sz += NLT_SZ;
-      }
-      if((numer_sz - strlen(numer)) < NLT_SZ)
-      {
-        numer = realloc(numer, numer_sz + NLT_SZ);
-        if(numer == NULL)
-        {
-          fprintf(stderr, "randomGeneralizedHill: realloc error, returning NULL Kinetic Law for %s\n", geneRegulated);
-          return NULL;
-        }
-        numer_sz += NLT_SZ;
-      }
+      sb_cat(&numer, "+");
+      sb_cat(&denom, "+");
+    }
+    sb_cat(&denom, "power(");
+    
+    sb_printf(&numer, "B_%d", idx);
+    hill_param(ctx, job, "B_", idx, R_B, gene, tf[i], NULL, 0);
+    
+    if(strstr(tf[i], "+")) /* activator */
+    {
+      sb_printf(&numer, "*power(%s/K_%d, n_%d)", strstr(tf[i], "P"), idx, idx);
+      sb_printf(&denom, "%s/K_%d, n_%d)", strstr(tf[i], "P"), idx, idx);
+      hill_param(ctx, job, "K_", idx, R_K, gene, tf[i], NULL, 0);
+      hill_param(ctx, job, "n_", idx, R_N, gene, tf[i], NULL, 0);
 #ifdef NON_LINEAR
-      strcat (numer, insertNonLinearTerms(savP, sav_tfs));
-      strcat (denom, insertNonLinearTerms(savP, sav_tfs));
+      insertNonLinearTerms(ctx, job, &numer, tf, nnl, i, &idx, 0);
+      insertNonLinearTerms(ctx, job, &denom, tf, nnl, i, &idx, 1);
 #endif
     }
     else               /* repressor */
     {
-      sprintf(buf, "%s", strstr(p, "P"));
-      strcpy(savP, "-");
-      strcat(savP, buf);
-      msr = ModifierSpeciesReference_createWith(buf);
-      Reaction_addModifier(react, msr);
-      strcat (denom, buf);
-      strcat (denom, "/");
-      sprintf(buf, "K_%d", parameterIndex);
-      strcat (denom, buf);
-      strcat (denom, ", ");
-
-      param = Parameter_createWith(buf, 0.5+drand48(), "microM_cell");
-      KineticLaw_addParameter(kl, param);
-
-      sprintf(buf, "n_%d", parameterIndex);
-      strcat (denom, buf);
-
-      param = Parameter_createWith(buf, 1.0+floor(4*drand48()), "hill_coeff");
-      KineticLaw_addParameter(kl, param);
-      strcat (denom, ")");
-      
-      if((denom_sz - strlen(denom)) < NLT_SZ)
-      {
-        denom = realloc(denom, denom_sz + NLT_SZ);
-        if(denom == NULL)
-        {
-          fprintf(stderr, "randomGeneralizedHill: realloc error, returning NULL Kinetic Law for %s\n", geneRegulated);
-          return NULL;
-        }
-        denom_sz += NLT_SZ;
-      }
+      sb_printf(&denom, "%s/K_%d, n_%d)", strstr(tf[i], "P"), idx, idx);
+      hill_param(ctx, job, "K_", idx, R_K, gene, tf[i], NULL, 0);
+      hill_param(ctx, job, "n_", idx, R_N, gene, tf[i], NULL, 0);
 #ifdef NON_LINEAR
-      strcat (denom, insertNonLinearTerms(savP, sav_tfs));
+      insertNonLinearTerms(ctx, job, &denom, tf, nnl, i, &idx, 1);
 #endif
     }
     
-    parameterIndex++;
+    idx++;
   }
-  else
+  sb_cat(&numer, ")");
+  sb_cat(&numer, denom.s);
+  sb_cat(&numer, ")");
+  if(ctx->netReactions)
+    sb_printf(&numer, "-dc_%d*P%s", job->index, strstr(job->gene, "G")+1);
+  
+  free(tf);
+  free(denom.s);
+  job->formula = numer;
+  
+  if(numer.err || denom.err || job->err)
+  {
+    fprintf(stderr, "hill_formula: malloc error, returning NULL Kinetic Law for %s\n", job->gene);
+    return 0;
+  }
+  return 1;
+}
+
+/* 
+ Append the terms of tf[0..ntf-1] other than tf[self], each with its own K and n.
+ part: 0 when inserting into the numerator, 1 for the denominator
+*/
+void insertNonLinearTerms(NEMO_CTX *ctx, HILLJOB *job, STRBUF *sb, char **tf, int ntf, int self, int *idx, int part)
+{
+  int gene, j;
+  char savP[BUFSZ];
+  
+  gene = atoi(strstr(job->gene, "G")+1);
+  sprintf(savP, "%c%s", strstr(tf[self], "+") ? '+' : '-', strstr(tf[self], "P"));
+  
+  for(j=0; j<ntf; j++)
+  {
+    if(hill_other(tf[self], tf[j]))  /* different */
+    {
+      ++*idx;
+      sb_printf(sb, "*power(%s/K_%d, n_%d)", strstr(tf[j], "P"), *idx, *idx);
+
+      //param = Parameter_createWith(buf, 0.5*drand48(), "microM_cell"); /* 0.5 ~ 1.5 */
+      hill_param(ctx, job, "K_", *idx, R_NL_K, gene, savP, tf[j], part);
+      //param = Parameter_createWith(buf, 1.0+floor(4*drand48()), "hill_coeff"); /* 1 - 4 */
+      hill_param(ctx, job, "n_", *idx, R_NL_N, gene, savP, tf[j], part);
+    }
+  }
+}
+
+/* draw and record a parameter of kind R_xx of a queued law; the first one (dc_) goes to the degradation law */
+void hill_param(NEMO_CTX *ctx, HILLJOB *job, char *prefix, int idx, int kind, int gene, char *tf, char *other, int part)
+{
+  double value;
+  HILLPARAM *hp;
+  
+  value = param_range(kind, param_rand(ctx, gene, kind, tf, other, part));
+  if(job->nparams == job->paramsSz)
+  {
+    hp = (HILLPARAM *) realloc(job->params, (job->paramsSz+32)*sizeof(HILLPARAM));
+    if(hp == NULL)
+    {
+      job->err = 1;
+      return;
+    }
+    job->params = hp;
+    job->paramsSz += 32;
+  }
+  
+  hp = &job->params[job->nparams++];
+  hp->prefix = prefix;
+  hp->index  = idx;
+  hp->value  = value;
+  hp->kind   = kind;
+  param_key(hp->key, gene, kind, tf, other, part);
+}
+
+void * hill_worker(void *arg)
+{
+  NEMO_CTX *ctx = (NEMO_CTX *) arg;
+  int i;
+  
+  for(;;)
+  {
+    pthread_mutex_lock(&ctx->hillLock);
+    i = ctx->nextHillJob++;
+    pthread_mutex_unlock(&ctx->hillLock);
+    
+    if(i >= ctx->numHillJobs)
+      break;
+    
+    if(!ctx->hillJobs[i].cached && !hill_formula(ctx, &ctx->hillJobs[i]))
+      ctx->hillJobs[i].err = 1;
+  }
+  
+  return NULL;
+}
+
+/* 
+ Build all the laws queued for this network, on numThreads threads, then
+ hand them to libsbml in parse order, so the output is the same whatever the
+ number of threads. Returns 0 if any law could not be built.
+*/
+int build_kinetic_laws(NEMO_CTX *ctx)
+{
+  int i, j, nthreads, ok=1;
+  char buf[32], *units;
+  HILLJOB *job;
+  Parameter_t *param;
+  pthread_t *tid=0x0;
+  
+  nthreads = ctx->legacyRand ? 1 : ctx->numThreads; /* the -l stream must be drawn in parse order */
+  if(nthreads > ctx->numHillJobs)
+    nthreads = ctx->numHillJobs;
+  if(nthreads > 1)
+    tid = (pthread_t *) malloc((nthreads-1)*sizeof(pthread_t));
+  
+  tm_enter(T_FORMULA);
+  law_cache_load(ctx);
+  ctx->nextHillJob = 0;
+  for(i=0; tid && i<nthreads-1; i++)
   {
-    fprintf(stderr, "randomGeneralizedHill: NULL tfs, returning NULL Kinetic Law for %s\n", geneRegulated);
-    return NULL;
+    if(pthread_create(&tid[i], NULL, hill_worker, ctx))
+    {
+      fprintf(stderr, "build_kinetic_laws: pthread_create error, using %d threads...\n", i+1);
+      break;
+    }
   }
-
-  do
+  hill_worker(ctx);
+  for(j=0; j<i; j++)
+    pthread_join(tid[j], NULL);
+  free(tid);
+  law_cache_store(ctx);
+  tm_leave();
+  
+  tm_enter(T_SBML);
+  for(i=0; i<ctx->numHillJobs; i++)
   {
-    p = strtok(NULL, " ,;)");
-    if(p)
+    job = &ctx->hillJobs[i];
+    
+    if(ok && !job->err)
     {
-      strcat (numer, "+");
-      strcat (denom, "+power(");
-
-      sprintf(buf, "B_%d", parameterIndex);
-      strcat (numer, buf);
-
-      param = Parameter_createWith(buf, 0.0001+drand48(), "microM_cell");
-      KineticLaw_addParameter(kl, param);
-
-      if(strstr(p, "+")) /* activator */
+      for(j=0; j<job->nparams; j++)
       {
-        strcat (numer, "*power(");
-        sprintf(buf, "%s", strstr(p, "P"));
-        strcpy(savP, "+");
-        strcat(savP, buf);
-        msr = ModifierSpeciesReference_createWith(buf);
-        Reaction_addModifier(react, msr);
-        strcat (numer, buf);
-        strcat (denom, buf);
-        strcat (numer, "/");
-        strcat (denom, "/");
-        sprintf(buf, "K_%d", parameterIndex);
-        strcat (numer, buf);
-        strcat (denom, buf);
-        strcat (numer, ", ");
-        strcat (denom, ", ");
-
-        param = Parameter_createWith(buf, 0.5+drand48(), "microM_cell");
-        KineticLaw_addParameter(kl, param);
-
-        sprintf(buf, "n_%d", parameterIndex);
-        strcat (numer, buf);
-        strcat (denom, buf);
-
-        param = Parameter_createWith(buf, 1.0+floor(4*drand48()), "hill_coeff");
-        KineticLaw_addParameter(kl, param);
-
-        strcat (numer, ")");
-        strcat (denom, ")");
-        
-        if((denom_sz - strlen(denom)) < NLT_SZ)
-        {
-          denom = realloc(denom, denom_sz + NLT_SZ);
-          if(denom == NULL)
-          {
-            fprintf(stderr, "randomGeneralizedHill: realloc error, returning NULL Kinetic Law for %s\n", geneRegulated);
-            return NULL;
-          }
-          denom_sz += NLT_SZ;
-        }
-        if((numer_sz - strlen(numer)) < NLT_SZ)
+        sprintf(buf, "%s%d", job->params[j].prefix, job->params[j].index);
+        units = j == 0 ? "dimensionless" : job->params[j].prefix[0] == 'n' ? "hill_coeff" : "microM_cell";
+        if(ctx->paramTable) /* -g: the ids are unique in the network, so they can all be the model's */
         {
-          numer = realloc(numer, numer_sz + NLT_SZ);
-          if(numer == NULL)
-          {
-            fprintf(stderr, "randomGeneralizedHill: realloc error, returning NULL Kinetic Law for %s\n", geneRegulated);
-            return NULL;
-          }
-          numer_sz += NLT_SZ;
+          param = Model_createParameter(ctx->model);
+          Parameter_setId(param, buf);
+          Parameter_setValue(param, job->params[j].value);
+          Parameter_setUnits(param, units);
         }
-#ifdef NON_LINEAR
-        strcat (numer, insertNonLinearTerms(savP, sav_tfs));
-        strcat (denom, insertNonLinearTerms(savP, sav_tfs));
-#endif
-      }
-      else               /* repressor */
-      {
-        sprintf(buf, "%s", strstr(p, "P"));
-        strcpy(savP, "-");
-        strcat(savP, buf);
-        msr = ModifierSpeciesReference_createWith(buf);
-        Reaction_addModifier(react, msr);
-        strcat (denom, buf);
-        strcat (denom, "/");
-        sprintf(buf, "K_%d", parameterIndex);
-        strcat (denom, buf);
-        strcat (denom, ", ");
-
-        param = Parameter_createWith(buf, 0.5+drand48(), "microM_cell");
-        KineticLaw_addParameter(kl, param);
-
-        sprintf(buf, "n_%d", parameterIndex);
-        strcat (denom, buf);
-
-        param = Parameter_createWith(buf, 1.0+floor(4*drand48()), "hill_coeff");
-        KineticLaw_addParameter(kl, param);
-        strcat (denom, ")");
-        
-        if((denom_sz - strlen(denom)) < NLT_SZ)
+        else
         {
-          denom = realloc(denom, denom_sz + NLT_SZ);
-          if(denom == NULL)
-          {
-            fprintf(stderr, "randomGeneralizedHill: realloc error, returning NULL Kinetic Law for %s\n", geneRegulated);
-            return NULL;
-          }
-          denom_sz += NLT_SZ;
+          param = Parameter_createWith(buf, job->params[j].value, units);
+          KineticLaw_addParameter(j == 0 ? job->dl : job->kl, param);
         }
-#ifdef NON_LINEAR
-        strcat (denom, insertNonLinearTerms(savP, sav_tfs));
-#endif
+        if(ctx->numVariants && !sweep_param(ctx, buf, &job->params[j]))
+          ok = 0;
       }
+      KineticLaw_setFormula(job->kl, job->formula.s);
       
-      parameterIndex++;
+      if(ctx->kineticLawInfo)
+        fprintf(ctx->infoOut ? ctx->infoOut : stdout, "Kinetic Law for %s = %s\n", job->gene, job->formula.s);
     }
+    else
+      ok = 0;
   }
-  while(p);
+  tm_leave();
+  
+  drop_kinetic_laws(ctx);
+  return ok;
+}
+
+/* empty the queue of kinetic laws, built or not */
+void drop_kinetic_laws(NEMO_CTX *ctx)
+{
+  int i;
 
-  kineticLawString = (char *) malloc(strlen(numer)+strlen(denom)+8);
-  if(kineticLawString==NULL)
+  for(i=0; i<ctx->numHillJobs; i++)
   {
-    fprintf(stderr, "randomGeneralizedHill: malloc error, returning NULL Kinetic Law for %s\n", geneRegulated);
-    return NULL;
+    free(ctx->hillJobs[i].gene);
+    free(ctx->hillJobs[i].tfs);
+    free(ctx->hillJobs[i].params);
+    free(ctx->hillJobs[i].formula.s);
   }
-  strcpy(kineticLawString, numer);
-  strcat(kineticLawString, ")");
-  strcat(kineticLawString, denom);
-  strcat(kineticLawString, ")");
-  if(kineticLawInfo)
-    printf("Kinetic Law for %s = %s\n", geneRegulated, kineticLawString);
-
-  free(denom);
-  free(numer);
-  free(sav_tfs);
-  return kineticLawString;
+  ctx->numHillJobs = 0;
+  
+  for(i=0; i<ctx->numLawItems; i++)
+    free(ctx->lawItems[i].text);
+  ctx->numLawItems = 0;
+  ctx->itemJob = 0;
 }
 
-char * insertNonLinearTerms(char *savP, char *sav_tfs)
+/* append to a growable string, doubling it as needed; sb->err is set on failure */
+void sb_cat(STRBUF *sb, char *s)
 {
-  char buf[32], *pgp, *pt, *tfs;
+  char *t;
+  size_t len;
   
-  tfs = (char *) malloc(strlen(sav_tfs)+8);
-  if(tfs == NULL)
+  if(sb->err)
+    return;
+  if(s == NULL)
   {
-    fprintf(stderr, "insertNonLinearTerms: malloc error, returning NULL...\n");
-    return NULL;
+    sb->err = 1;
+    return;
   }
-  strcpy(tfs, sav_tfs);
-
-  returnString[0] = 0x0;
-
-  pgp = tfs;
-  do
+  len = strlen(s);
+  
+  if(sb->len + len + 1 > sb->sz)
   {
-    pt = strsep(&pgp, " ,;)");
-    if(pt && strlen(pt) > 0)
+    t = (char *) realloc(sb->s, 2*(sb->len + len + 1) + NLT_SZ);
+    if(t == NULL)
     {
-      if(strcmp(pt, savP))  /* different */
-      {
-        strcat(returnString, "*power(");
-        sprintf(buf, "%s", strstr(pt, "P"));
-        strcat(returnString, buf);
-        strcat(returnString, "/");
-        sprintf(buf, "K_%d", ++parameterIndex);
-        strcat(returnString, buf);
-
-        //param = Parameter_createWith(buf, 0.5*drand48(), "microM_cell"); /* 0.5 ~ 1.5 */
-        param = Parameter_createWith(buf, 1+1000*drand48(), "microM_cell"); /* 1 ~ 1001 */
-        KineticLaw_addParameter(kl, param);
-        
-        strcat(returnString, ", ");
-        sprintf(buf, "n_%d", parameterIndex);
-        strcat(returnString, buf);
-        strcat(returnString, ")");
-
-        //param = Parameter_createWith(buf, 1.0+floor(4*drand48()), "hill_coeff"); /* 1 - 4 */
-        param = Parameter_createWith(buf, 0.2+4*drand48(), "hill_coeff"); /* 0.2 - 4.2 */
-        KineticLaw_addParameter(kl, param);
-      }
+      sb->err = 1;
+      return;
     }
+    sb->s  = t;
+    sb->sz = 2*(sb->len + len + 1) + NLT_SZ;
   }
-  while(pt && strlen(pt) > 0);
   
-  free(tfs);
-  return returnString;
+  memcpy(sb->s + sb->len, s, len+1);
+  sb->len += len;
 }
 
-char * explicitKineticLaw(char *geneRegulated, char *tfs, char *explicitFunction)
+void sb_printf(STRBUF *sb, const char *fmt, ...)
 {
-  int i, j;
-  char a1[64], a2[64], buf[32], *p=0x0, proteins[64][32];
-  KineticLaw_t  *dl;
-  Reaction_t *degrad;
-
-  /* degradation */
-  dl = KineticLaw_create();
-  degrad = Model_createReaction(model);
-  strcpy(a1, "P");
-  strcat(a1, strstr(geneRegulated, "G")+1);
-  strcat(a1, "_degrad");
-  Reaction_setId(degrad, a1);
-  strcpy(a1, "P"); 
-  strcat(a1, strstr(geneRegulated, "G")+1);
-  strcat(a1, " degradation");
-  Reaction_setName(degrad, a1);
-  Reaction_setReversible(degrad, 0); /* balance of degradation is below */
+  char buf[BUFSZ];
+  va_list ap;
+  
+  va_start(ap, fmt);
+  vsnprintf(buf, BUFSZ, fmt, ap);
+  va_end(ap);
+  sb_cat(sb, buf);
+}
+
+/* 
+ Uniform random number in [0.0 - 1.0) for a parameter of the kinetic law of
+ gene. Unless -l (legacy) is given, it is not taken from the drand48
+ stream but computed from a key: (seed, gene, transcription factor, second
+ transcription factor of a non-linear term, numerator/denominator part, kind),
+ hashed with the splitmix64 finalizer. Each parameter then depends only on
+ where it sits in the network, not on how much was parsed before it, so
+ networks may be reordered, split up, or have their kinetic laws built in any
+ order and still get bit-for-bit the same values.
+ tf, other: "[+-]P<n>" or NULL
+*/
+double param_rand(NEMO_CTX *ctx, int gene, int kind, char *tf, char *other, int part)
+{
+  unsigned long long key[3];
+
+  if(ctx->legacyRand)
+    return erand48(ctx->xsubi); /* the drand48() stream of srand48(seedval), but the parse's own */
+
+  param_key(key, gene, kind, tf, other, part);
+  return key_rand(ctx, key, 3);
+}
+
+/* the key of param_rand() */
+void param_key(unsigned long long *key, int gene, int kind, char *tf, char *other, int part)
+{
+  key[0] = (unsigned long long)gene << 8 | kind << 1 | part;
+  key[1] = tf    ? (unsigned long long)atoi(strstr(tf, "P")+1) + 1    : 0;
+  key[2] = other ? (unsigned long long)atoi(strstr(other, "P")+1) + 1 : 0;
+}
+
+/* uniform random number in [0.0 - 1.0) hashed from seedval and key[0 .. n-1] */
+double key_rand(NEMO_CTX *ctx, unsigned long long *key, int n)
+{
+  return seed_rand(ctx->seedval, key, n);
+}
+
+/* the same, for another seed; -K variant k is seedval+k */
+double seed_rand(long seed, unsigned long long *key, int n)
+{
+  int i;
+  unsigned long long x;
+
+  x = (unsigned long long)seed;
+  for(i=0; i<n; i++)
+  {
+    x ^= key[i];
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+  }
+
+  return (x >> 11) * (1.0/9007199254740992.0); /* top 53 bits */
+}
+
+/* the value of a parameter of kind R_xx for uniform random number u */
+double param_range(int kind, double u)
+{
+  switch(kind)
+  {
+    case R_DC:   return 0.01+u/10;
+    case R_B:    return 0.0001+u;        /* 0.0001 ~ 1.0 */
+    case R_K:    return 0.5+u;           /* 0.5 ~ 1.5 */
+    case R_N:    return 1.0+floor(4*u);  /* 1 - 4 */
+    case R_NL_K: return 1+1000*u;        /* 1 ~ 1001 */
+    case R_NL_N: return 0.2+4*u;         /* 0.2 - 4.2 */
+  }
+  return u;
+}
+
+/*
+ The synthesis and degradation reactions of geneRegulated, with the user law f
+ as the synthesis law. Each protein in tfs becomes a modifier, and must appear
+ in f: the proteins of f are marked in the symbol table, so the check is one
+ pass over f and one over tfs. Returns the formula of f, malloc'd, or NULL.
+*/
+char * explicitKineticLaw(NEMO_CTX *ctx, char *geneRegulated, char *tfs, EXPR *f)
+{
+  char a1[64], a2[64], buf[32], *kLSp, *p=0x0, *net, *save;
+  KineticLaw_t  *dl=0x0;
+  ModifierSpeciesReference_t *msr;
+  Reaction_t *degrad=0x0;
+  Species_t *species;
+  SpeciesReference_t *reactant;
+
+  tm_enter(T_SBML);
+  if(ctx->motifCensus)
+    census_law(geneRegulated, tfs);
+  
+  /* degradation, or with -n, a term of the synthesis law (see below) */
+  if(!ctx->netReactions)
+  {
+    dl = KineticLaw_create();
+    degrad = Model_createReaction(ctx->model);
+    strcpy(a1, "P");
+    strcat(a1, strstr(geneRegulated, "G")+1);
+    strcat(a1, "_degrad");
+    Reaction_setId(degrad, a1);
+    strcpy(a1, "P"); 
+    strcat(a1, strstr(geneRegulated, "G")+1);
+    strcat(a1, " degradation");
+    Reaction_setName(degrad, a1);
+    Reaction_setReversible(degrad, 0); /* balance of degradation is below */
+  }
   
   /* synthesis */
   strcpy(a1, "P"); 
   strcat(a1, strstr(geneRegulated, "G")+1);
-  strcat(a1, "_synthesis");
-  Reaction_setId(react, a1);
+  strcat(a1, ctx->netReactions ? "_net" : "_synthesis");
+  Reaction_setId(ctx->react, a1);
 
   strcpy(a1, "P"); 
   strcat(a1, strstr(geneRegulated, "G")+1);
-  strcat(a1, " synthesis");
-  Reaction_setName(react, a1);
-  Reaction_setReversible(react, 0);
+  strcat(a1, ctx->netReactions ? " net synthesis" : " synthesis");
+  Reaction_setName(ctx->react, a1);
+  Reaction_setReversible(ctx->react, ctx->netReactions);
 
   strcpy(a1, "P"); 
   strcat(a1, strstr(geneRegulated, "G")+1);
   reactant = SpeciesReference_createWith(a1, 1.0, 1);
-  Reaction_addProduct(react, reactant);
-  Reaction_addReactant(react, SpeciesReference_createWith("devNull", 1.0, 1));
+  Reaction_addProduct(ctx->react, reactant);
+  Reaction_addReactant(ctx->react, SpeciesReference_createWith("devNull", 1.0, 1));
   
-  /* balance of degradation */
-  Reaction_addProduct(degrad, SpeciesReference_createWith("devNull", 1.0, 1));
-  Reaction_addReactant(degrad, reactant);
-  strcpy(a2, a1);
-  KineticLaw_setFormula(dl, a2);
-  Reaction_setKineticLaw(degrad, dl);
+  /* balance of degradation, with its own species reference since the
+   * reaction owns (and frees) whatever is added to it
+   */
+  if(!ctx->netReactions)
+  {
+    Reaction_addProduct(degrad, SpeciesReference_createWith("devNull", 1.0, 1));
+    Reaction_addReactant(degrad, SpeciesReference_createWith(a1, 1.0, 1));
+    strcpy(a2, a1);
+    KineticLaw_setFormula(dl, a2);
+    Reaction_setKineticLaw(degrad, dl);
+  }
   
-  if(!Model_getSpeciesById(model, a1)) /* has this species been created yet? */
+  if(!Model_getSpeciesById(ctx->model, a1)) /* has this species been created yet? */
   {
-    species = Model_createSpecies(model);
+    species = Model_createSpecies(ctx->model);
     Species_setId(species, a1);
     Species_setName(species, a1);
     Species_setCompartment(species, sid);
     Species_setInitialConcentration(species, 1.0);
   }
 
-  /* build a list of proteins (<=64) used in explicitFunction */
-  p = explicitFunction;
-  for(i=0; i<64; i++)
+  kLSp = expr_formula(&ctx->syms, f);
+  if(kLSp == NULL)
   {
-    j = 0; proteins[i][0] = 0x0;
-    if(p && (p=strstr(p, "P")))
-    {
-      j = 1;
-      while(isdigit(p[j]))
-      {
-        proteins[i][j] = p[j++];
-        proteins[i][j] = 0x0;
-      }
-      if(j>1) proteins[i][0] = 'P';
-      p++;
-    }
+    fprintf(stderr, "explicitKineticLaw: malloc error, returning NULL Kinetic Law for %s\n", geneRegulated);
+    tm_leave();
+    return NULL;
   }
+  expr_mark(&ctx->syms, f, ++ctx->lawMark);
 
-  /* add reaction modifiers, and make sure that each modifier appears in explicitFunction */
-  p = strtok(tfs, " ,;)");
-  if(p)
+  /* add reaction modifiers, and make sure that each modifier appears in the law */
+  p = strtok_r(tfs, " ,;)", &save);
+  if(!p)
   {
-    sprintf(buf, "%s", strstr(p, "P"));
-    /* is this modifier used in explicitFunction? */
-    j = 0;
-    for(i=0; i<64; i++)
-      if(!strcmp(proteins[i], buf)) {j = 1; break;}
+    fprintf(stderr, "explicitKineticLaw: NULL tfs, returning NULL Kinetic Law for %s\n", geneRegulated);
+    free(kLSp);
+    tm_leave();
+    return NULL;
+  }
 
-    if(!j)
+  do
+  {
+    sprintf(buf, "%s", strstr(p, "P"));
+    if(!expr_marked(&ctx->syms, expr_lookup(&ctx->syms, buf), ctx->lawMark))
     {
-      fprintf(stderr, "explicitKineticLaw: protein %s unused in %s, returning NULL Kinetic Law for %s\n", buf, explicitFunction, geneRegulated);
+      fprintf(stderr, "explicitKineticLaw: protein %s unused in %s, returning NULL Kinetic Law for %s\n", buf, kLSp, geneRegulated);
+      free(kLSp);
+      tm_leave();
       return NULL;
     }
     
     msr = ModifierSpeciesReference_createWith(buf);
-    Reaction_addModifier(react, msr);
+    Reaction_addModifier(ctx->react, msr);
+    p = strtok_r(NULL, " ,;)", &save);
   }
-  else
+  while(p);
+  
+  /* -n: the law less the degradation, a1 at unit rate */
+  if(ctx->netReactions)
   {
-    fprintf(stderr, "explicitKineticLaw: NULL tfs, returning NULL Kinetic Law for %s\n", geneRegulated);
-    return NULL;
+    net = (char *) malloc(strlen(kLSp) + strlen(a1) + 4);
+    if(net == NULL)
+    {
+      fprintf(stderr, "explicitKineticLaw: malloc error, returning NULL Kinetic Law for %s\n", geneRegulated);
+      free(kLSp);
+      tm_leave();
+      return NULL;
+    }
+    sprintf(net, "(%s)-%s", kLSp, a1);
+    free(kLSp);
+    kLSp = net;
   }
+  
+  if(ctx->kineticLawInfo)
+    fprintf(ctx->infoOut ? ctx->infoOut : stdout, "Kinetic Law for %s = %s\n", geneRegulated, kLSp);
+  
+  tm_leave();
+  return kLSp;
+}
 
-  do
+/* append gene, and its F() law if it has one, to the pg list of the multi_out being parsed */
+int pg_add(NEMO_CTX *ctx, char *gene, EXPR *law)
+{
+  PGENE *t;
+
+  if(ctx->numPgGenes == ctx->pgGenesSz)
   {
-    p = strtok(NULL, " ,;)");
-    if(p)
+    t = (PGENE *) realloc(ctx->pgGenes, (2*ctx->pgGenesSz+16)*sizeof(PGENE));
+    if(t == NULL)
     {
-      sprintf(buf, "%s", strstr(p, "P"));
-      /* is this modifier used in explicitFunction? */
-      j = 0;
-      for(i=0; i<64; i++)
-        if(!strcmp(proteins[i], buf)) {j = 1; break;}
-    
-      if(!j)
-      {
-        fprintf(stderr, "explicitKineticLaw: protein %s unused in %s, returning NULL Kinetic Law for %s\n", buf, explicitFunction, geneRegulated);
-        return NULL;
-      }
-      
-      msr = ModifierSpeciesReference_createWith(buf);
-      Reaction_addModifier(react, msr);
+      expr_free(law);
+      return 0;
     }
+    ctx->pgGenes = t;
+    ctx->pgGenesSz = 2*ctx->pgGenesSz+16;
   }
-  while(p);
-  
-  if(kineticLawInfo)
-    printf("Kinetic Law for %s = %s\n", geneRegulated, explicitFunction);
-  
-  return explicitFunction;
+
+  ctx->pgGenes[ctx->numPgGenes].gene = strdup(gene);
+  ctx->pgGenes[ctx->numPgGenes].law  = law;
+  if(ctx->pgGenes[ctx->numPgGenes].gene == NULL)
+  {
+    expr_free(law);
+    return 0;
+  }
+  ctx->numPgGenes++;
+  return 1;
+}
+
+void pg_clear(NEMO_CTX *ctx)
+{
+  int i;
+
+  for(i=0; i<ctx->numPgGenes; i++)
+  {
+    free(ctx->pgGenes[i].gene);
+    expr_free(ctx->pgGenes[i].law);
+  }
+  ctx->numPgGenes = 0;
+}
+
+/* 
+ Take back the reaction an F() law was rejected in, with its law and the
+ degradation explicitKineticLaw() made for it, before the rule's YYERROR.
+*/
+void drop_reaction(NEMO_CTX *ctx)
+{
+  ListOf_t *lo = Model_getListOfReactions(ctx->model);
+  Reaction_t *r;
+
+  KineticLaw_free(ctx->kl);
+  ctx->kl = 0x0;
+  while(ListOf_getNumItems(lo) > 0)
+  {
+    r = (Reaction_t *) ListOf_remove(lo, ListOf_getNumItems(lo)-1);
+    Reaction_free(r);
+    if(r == ctx->react)
+      break;
+  }
+  ctx->react = 0x0;
+}
+
+/* -p output for an F() expression, as reduced so far */
+void parse_info_expr(NEMO_CTX *ctx, char *label, EXPR *e)
+{
+  char *f = expr_formula(&ctx->syms, e);
+
+  printf("%s%s\n", label, f ? f : "?");
+  free(f);
 }
 
 /* 
  write edge information into cytoBuf
  tfs (transcription factors string) format: ([+-]P[,;])* 
 */
-void xgmmlXML(char *geneRegulated, char *tfs)
+void xgmmlXML(NEMO_CTX *ctx, char *geneRegulated, char *tfs)
 {
-  int act;
-  static int edgeId=1;
+  char *p, *save;
 
-  p = strtok(tfs, " ,;)");
-  if(p)
+  p = strtok_r(tfs, " ,;)", &save);
+  while(p)
   {
-    if((strlen(cytoBuf) + 1024) > cytoBufSz)
-    {
-      tmp = realloc(cytoBuf, cytoBufSz + 1024);
-      if(!tmp)
-      {
-        fprintf(stderr, "nemo2sbml: realloc error for cytoBuf, unable to generate xgmml...");
-        xgmml = 0;
-      }
-      else
-      {
-        cytoBuf = tmp;
-        cytoBufSz += 1024;
-      }
-    }
-
+    if(ctx->layoutKind)
+      layout_edge(ctx->layout, atol(strstr(p, "P")+1), atol(geneRegulated+1));
+    
     if(strstr(p, "+")) /* activator */
-    {
-      act = 1;
-      sprintf(tmpCytoBuf, "  <edge id=\"%d\" source=\"G%s\" target=\"%s\" label=\"activation\">\n", 
-              edgeId++, strstr(p, "P")+1, geneRegulated);
-    }
+      sprintf(ctx->tmpCytoBuf, "  <edge id=\"%d\" source=\"G%s\" target=\"%s\" label=\"activation\">\n", 
+              ctx->edgeId++, strstr(p, "P")+1, geneRegulated);
     else               /* repressor */
-    {
-      act = 0;
-      sprintf(tmpCytoBuf, "  <edge id=\"%d\" source=\"G%s\" target=\"%s\" label=\"repression\">\n", 
-              edgeId++, strstr(p, "P")+1, geneRegulated);
-    }
+      sprintf(ctx->tmpCytoBuf, "  <edge id=\"%d\" source=\"G%s\" target=\"%s\" label=\"repression\">\n", 
+              ctx->edgeId++, strstr(p, "P")+1, geneRegulated);
               
-    strcat(cytoBuf, tmpCytoBuf);
-    strcat(cytoBuf, "    <graphics>\n");
-    strcat(cytoBuf, "      <att>\n");
-    strcat(cytoBuf, "        <att name=\"sourceArrow\" value=\"0\"/>\n");
+    cyto_write(ctx, ctx->tmpCytoBuf);
+    cyto_write(ctx, "    <graphics>\n");
+    cyto_write(ctx, "      <att>\n");
+    cyto_write(ctx, "        <att name=\"sourceArrow\" value=\"0\"/>\n");
     
-    if(act)
-      strcat(cytoBuf, "        <att name=\"targetArrow\" value=\"3\"/>\n");
+    if(strstr(p, "+"))
+      cyto_write(ctx, "        <att name=\"targetArrow\" value=\"3\"/>\n");
     else
-      strcat(cytoBuf, "        <att name=\"targetArrow\" value=\"15\"/>\n");
+      cyto_write(ctx, "        <att name=\"targetArrow\" value=\"15\"/>\n");
       
-    strcat(cytoBuf, "      </att>\n");
-    strcat(cytoBuf, "    </graphics>\n");
-    strcat(cytoBuf, "  </edge>\n");
+    cyto_write(ctx, "      </att>\n");
+    cyto_write(ctx, "    </graphics>\n");
+    cyto_write(ctx, "  </edge>\n");
+    
+    p = strtok_r(NULL, " ,;)", &save);
+  }
+}
+
+/* the i-th gene of the -L layout, as an XGMML node at its place */
+void cyto_node(NEMO_CTX *ctx, int i, char *buf)
+{
+  long g;
+  double x, y;
+  
+  g = layout_get(ctx->layout, i, &x, &y);
+  sprintf(buf, "  <node id=\"G%ld\" label=\"G%ld\">\n    <graphics x=\"%.1f\" y=\"%.1f\"/>\n  </node>\n", g, g, x, y);
+}
+
+/* 
+ Append s to the XGMML of the current network. cytoBuf grows geometrically
+ up to CYTO_FLUSH bytes and is then flushed to a temporary body file, so the
+ cost is linear in the size of the graph and the whole graph is never held in
+ memory. The body is copied into the .xgmml file once the network is done,
+ when its name (which carries the gene count) is known.
+*/
+void cyto_write(NEMO_CTX *ctx, char *s)
+{
+  char *t;
+  size_t len;
+  
+  if(!ctx->xgmml) return;
+  
+  tm_enter(T_XGMML);
+  len = strlen(s);
+  if(ctx->cytoLen + len > ctx->cytoBufSz && ctx->cytoLen >= CYTO_FLUSH && !cyto_flush(ctx))
+  {
+    tm_leave();
+    return;
   }
   
-  do
+  while(ctx->cytoLen + len > ctx->cytoBufSz)
   {
-    p = strtok(NULL, " ,;)");
-    if(p)
+    t = realloc(ctx->cytoBuf, 2*ctx->cytoBufSz);
+    if(!t)
     {
-      if((strlen(cytoBuf) + 1024) > cytoBufSz)
-      {
-        tmp = realloc(cytoBuf, cytoBufSz + 1024);
-        if(!tmp)
-        {
-          fprintf(stderr, "nemo2sbml: realloc error for cytoBuf, unable to generate xgmml...");
-          xgmml = 0;
-        }
-        else
-        {
-          cytoBuf = tmp;
-          cytoBufSz += 1024;
-        }
-      }
+      fprintf(stderr, "nemo2sbml: realloc error for cytoBuf, unable to generate xgmml...\n");
+      ctx->xgmml = 0;
+      tm_leave();
+      return;
+    }
+    ctx->cytoBuf = t;
+    ctx->cytoBufSz *= 2;
+  }
+  
+  memcpy(ctx->cytoBuf+ctx->cytoLen, s, len);
+  ctx->cytoLen += len;
+  tm_leave();
+}
 
-      if(strstr(p, "+")) /* activator */
-      {
-        act = 1;
-        sprintf(tmpCytoBuf, "  <edge id=\"%d\" source=\"G%s\" target=\"%s\" label=\"activation\">\n", 
-                edgeId++, strstr(p, "P")+1, geneRegulated);
-      }
-      else               /* repressor */
+/* move what is in cytoBuf to the body file, return 0 on failure */
+int cyto_flush(NEMO_CTX *ctx)
+{
+  if(!ctx->cyto_body)
+  {
+    ctx->cyto_body = tmpfile();
+    if(!ctx->cyto_body)
+    {
+      fprintf(stderr, "nemo2sbml: unable to open a temporary file, unable to generate xgmml...\n");
+      ctx->xgmml = 0;
+      return 0;
+    }
+  }
+  
+  if(fwrite(ctx->cytoBuf, 1, ctx->cytoLen, ctx->cyto_body) != ctx->cytoLen)
+  {
+    fprintf(stderr, "nemo2sbml: write error on temporary file, unable to generate xgmml...\n");
+    ctx->xgmml = 0;
+    return 0;
+  }
+  
+  ctx->cytoLen = 0;
+  return 1;
+}
+
+/* file name suffix for the -z output format */
+char * out_suffix(NEMO_CTX *ctx)
+{
+  switch(ctx->zformat)
+  {
+    case Z_GZIP: return ".gz";
+    case Z_ZSTD: return ".zst";
+    default:     return "";
+  }
+}
+
+/* open path for writing in the -z output format, NULL on failure */
+OUTFILE * out_open(NEMO_CTX *ctx, char *path)
+{
+#ifdef HAVE_ZLIB
+  char mode[16];
+#endif
+  OUTFILE *of;
+
+  of = (OUTFILE *) calloc(1, sizeof(OUTFILE));
+  if(!of)
+  {
+    fprintf(stderr, "out_open: malloc error, returning NULL...\n");
+    return NULL;
+  }
+  of->zformat = ctx->zformat;
+  
+  unlink(path); /* never write through a link, e.g. into the -C cache */
+  oc_note(path);
+  
+  switch(ctx->zformat)
+  {
+#ifdef HAVE_ZLIB
+    case Z_GZIP:
+      snprintf(mode, sizeof(mode), "wb%d", ctx->zlevel < 0 ? 6 : ctx->zlevel);
+      of->gz = gzopen(path, mode);
+      if(of->gz) return of;
+      break;
+#endif
+#ifdef HAVE_ZSTD
+    case Z_ZSTD:
+      of->fp = fopen(path, "wb");
+      of->zc = ZSTD_createCCtx();
+      of->zbufSz = ZSTD_CStreamOutSize();
+      of->zbuf = (char *) malloc(of->zbufSz);
+      if(of->fp && of->zc && of->zbuf)
       {
-        act = 0;
-        sprintf(tmpCytoBuf, "  <edge id=\"%d\" source=\"G%s\" target=\"%s\" label=\"repression\">\n", 
-                edgeId++, strstr(p, "P")+1, geneRegulated);
+        ZSTD_CCtx_setParameter(of->zc, ZSTD_c_compressionLevel, ctx->zlevel < 0 ? 3 : ctx->zlevel);
+        return of;
       }
-              
-      strcat(cytoBuf, tmpCytoBuf);
-      strcat(cytoBuf, "    <graphics>\n");
-      strcat(cytoBuf, "      <att>\n");
-      strcat(cytoBuf, "        <att name=\"sourceArrow\" value=\"0\"/>\n");
-    
-      if(act)
-        strcat(cytoBuf, "        <att name=\"targetArrow\" value=\"3\"/>\n");
-      else
-        strcat(cytoBuf, "        <att name=\"targetArrow\" value=\"15\"/>\n");
-      
-      strcat(cytoBuf, "      </att>\n");
-      strcat(cytoBuf, "    </graphics>\n");
-      strcat(cytoBuf, "  </edge>\n");
-    }
+      if(of->fp) fclose(of->fp);
+      ZSTD_freeCCtx(of->zc);
+      free(of->zbuf);
+      break;
+#endif
+    default:
+      of->fp = fopen(path, "w");
+      if(of->fp) return of;
+      break;
   }
-  while(p);
+  
+  free(of);
+  return NULL;
+}
+
+#ifdef HAVE_ZSTD
+/* feed len bytes (or, if end, the end of the frame) through the compressor */
+int zstd_stream(OUTFILE *of, const char *s, size_t len, int end)
+{
+  size_t left;
+  ZSTD_inBuffer  in  = {s, len, 0};
+  ZSTD_outBuffer out;
+  
+  do
+  {
+    out.dst = of->zbuf; out.size = of->zbufSz; out.pos = 0;
+    left = ZSTD_compressStream2(of->zc, &out, &in, end ? ZSTD_e_end : ZSTD_e_continue);
+    if(ZSTD_isError(left) || fwrite(of->zbuf, 1, out.pos, of->fp) != out.pos)
+      return 0;
+  }
+  while(end ? left != 0 : in.pos < in.size);
+  
+  return 1;
+}
+#endif
+
+/* write len bytes, return 0 on failure (also remembered until out_close) */
+int out_write(OUTFILE *of, const char *s, size_t len)
+{
+  if(of->err || len == 0) return !of->err;
+  
+  switch(of->zformat)
+  {
+#ifdef HAVE_ZLIB
+    case Z_GZIP:
+      if(gzwrite(of->gz, s, len) != (int)len) of->err = 1;
+      break;
+#endif
+#ifdef HAVE_ZSTD
+    case Z_ZSTD:
+      if(!zstd_stream(of, s, len, 0)) of->err = 1;
+      break;
+#endif
+    default:
+      if(fwrite(s, 1, len, of->fp) != len) of->err = 1;
+      break;
+  }
+  
+  if(!of->err)
+    tm_bytes(len);
+  return !of->err;
+}
+
+int out_puts(OUTFILE *of, char *s)
+{
+  return out_write(of, s, strlen(s));
+}
+
+/* finish and close, return 0 if everything was written */
+int out_close(OUTFILE *of)
+{
+  int err = of->err;
+  
+  switch(of->zformat)
+  {
+#ifdef HAVE_ZLIB
+    case Z_GZIP:
+      if(gzclose(of->gz) != Z_OK) err = 1;
+      break;
+#endif
+#ifdef HAVE_ZSTD
+    case Z_ZSTD:
+      if(!err && !zstd_stream(of, "", 0, 1)) err = 1;
+      if(fclose(of->fp)) err = 1;
+      ZSTD_freeCCtx(of->zc);
+      free(of->zbuf);
+      break;
+#endif
+    default:
+      if(fclose(of->fp)) err = 1;
+      break;
+  }
+  
+  free(of);
+  return err;
 }
+
@@ -0,0 +1,764 @@
+/* network.c
+ *
+ * Compile the SBML model nemo2sbml has built for a network into a NETWORK
+ * (see network.h), and evaluate its reaction rates and species derivatives.
+ * Each kinetic law formula is parsed with libsbml's formula parser and turned
+ * into a postfix stack program; parameters and species are resolved to array
+ * indices once, at compile time, so evaluation does no name lookups.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sbml/SBMLTypes.h>
+#include <sbml/math/FormulaParser.h>
+#include "network.h"
+
+/* open addressing hash of names to indices */
+typedef struct nametab
+{
+  char **name;
+  int   *index;
+  int    sz;
+  struct nametab *up; /* where a name not here is looked for: a law's parameters, then the model's */
+} NAMETAB;
+
+static int nt_init(NAMETAB *, int);
+static void nt_free(NAMETAB *);
+static void nt_put(NAMETAB *, char *, int);
+static int nt_get(NAMETAB *, const char *);
+static int list_items(ListOf_t *, void ***);
+static int list_collect(const void *, const void *);
+static int emit(NETWORK *, int, int);
+static int emit_const(NETWORK *, double);
+static int compile_node(NETWORK *, ASTNode_t *, NAMETAB *, NAMETAB *, int, int *, int *);
+static int hill_match(HILLSET *, ASTNode_t *, NAMETAB *, NAMETAB *, int);
+static int hill_sum(HILLSET *, ASTNode_t *, NAMETAB *, NAMETAB *, int);
+static int hill_monomial(HILLSET *, ASTNode_t *, NAMETAB *, NAMETAB *);
+static int hill_scan(HILLSET *, ASTNode_t *, NAMETAB *, NAMETAB *, double *, int *, int);
+static int hill_value(ASTNode_t *, NAMETAB *, double *, int *);
+
+/* the items of a list so far, see list_items() */
+typedef struct
+{
+  void **item;
+  int    num;
+} COLLECTED;
+
+/*
+ libsbml 2.3.5 lists only have get(n), which walks the list from the head,
+ so fetch all the items in one pass through ListOf_find(), whose comparator
+ is handed the collection as it goes
+*/
+static int list_items(ListOf_t *lo, void ***items)
+{
+  COLLECTED c;
+
+  c.item = (void **) malloc((ListOf_getNumItems(lo)+1)*sizeof(void *));
+  if(c.item == NULL)
+    return -1;
+
+  c.num = 0;
+  ListOf_find(lo, &c, list_collect);
+  *items = c.item;
+  return c.num;
+}
+
+static int list_collect(const void *arg, const void *item)
+{
+  COLLECTED *c = (COLLECTED *) arg;
+
+  c->item[c->num++] = (void *) item;
+  return 1; /* on to the next */
+}
+
+static unsigned int nt_hash(const char *s)
+{
+  unsigned int h = 2166136261u;
+
+  while(*s)
+    h = (h ^ (unsigned char)*s++) * 16777619u;
+  return h;
+}
+
+static int nt_init(NAMETAB *nt, int n)
+{
+  nt->up = NULL;
+  nt->sz = 16;
+  while(nt->sz < 2*n)
+    nt->sz <<= 1;
+
+  nt->name  = (char **) calloc(nt->sz, sizeof(char *));
+  nt->index = (int *) malloc(nt->sz*sizeof(int));
+  return nt->name && nt->index;
+}
+
+static void nt_free(NAMETAB *nt)
+{
+  free(nt->name);
+  free(nt->index);
+}
+
+/* the first entry of a name wins, later ones are ignored */
+static void nt_put(NAMETAB *nt, char *name, int index)
+{
+  unsigned int i = nt_hash(name) & (nt->sz-1);
+
+  while(nt->name[i])
+  {
+    if(!strcmp(nt->name[i], name))
+      return;
+    i = (i+1) & (nt->sz-1);
+  }
+  nt->name[i]  = name;
+  nt->index[i] = index;
+}
+
+static int nt_get(NAMETAB *nt, const char *name)
+{
+  unsigned int i = nt_hash(name) & (nt->sz-1);
+
+  while(nt->name[i])
+  {
+    if(!strcmp(nt->name[i], name))
+      return nt->index[i];
+    i = (i+1) & (nt->sz-1);
+  }
+  return nt->up ? nt_get(nt->up, name) : -1;
+}
+
+static int emit(NETWORK *net, int op, int arg)
+{
+  NETOP *code;
+
+  if(net->ncode == net->codeSz)
+  {
+    code = (NETOP *) realloc(net->code, (2*net->codeSz+1024)*sizeof(NETOP));
+    if(code == NULL)
+      return 0;
+    net->code = code;
+    net->codeSz = 2*net->codeSz+1024;
+  }
+
+  net->code[net->ncode].op  = op;
+  net->code[net->ncode].arg = arg;
+  net->ncode++;
+  return 1;
+}
+
+static int emit_const(NETWORK *net, double value)
+{
+  double *consts;
+
+  if(net->nconsts == net->constsSz)
+  {
+    consts = (double *) realloc(net->consts, (2*net->constsSz+64)*sizeof(double));
+    if(consts == NULL)
+      return 0;
+    net->consts = consts;
+    net->constsSz = 2*net->constsSz+64;
+  }
+
+  net->consts[net->nconsts] = value;
+  return emit(net, OP_CONST, net->nconsts++);
+}
+
+/*
+ Append the postfix program for node, resolving names first to the law's own
+ parameters, then to species. depth is the stack depth before node is pushed.
+ Returns 0, with a message, for anything nemo2sbml would not have written.
+*/
+static int compile_node(NETWORK *net, ASTNode_t *node, NAMETAB *local, NAMETAB *spec, int depth, int *maxdepth, int *err)
+{
+  int i, n, f=-1, idx, type;
+  const char *name;
+
+  if(depth+1 > *maxdepth)
+    *maxdepth = depth+1;
+
+  type = ASTNode_getType(node);
+  n = ASTNode_getNumChildren(node);
+
+  switch(type)
+  {
+    case AST_INTEGER:
+      return emit_const(net, (double)ASTNode_getInteger(node));
+
+    case AST_REAL:
+    case AST_REAL_E:
+    case AST_RATIONAL:
+      return emit_const(net, ASTNode_getReal(node));
+
+    case AST_CONSTANT_E:
+      return emit_const(net, M_E);
+
+    case AST_CONSTANT_PI:
+      return emit_const(net, M_PI);
+
+    case AST_NAME_TIME:
+      return emit(net, OP_TIME, 0);
+
+    case AST_NAME:
+      name = ASTNode_getName(node);
+      if((idx = nt_get(local, name)) >= 0)
+        return emit(net, OP_PARAM, idx);
+      if((idx = nt_get(spec, name)) >= 0)
+        return emit(net, OP_SPECIES, idx);
+
+      fprintf(stderr, "net_compile: unknown name \"%s\" in kinetic law, returning NULL...\n", name);
+      *err = 1;
+      return 0;
+
+    case AST_PLUS:
+    case AST_TIMES:
+      if(n == 0)
+        return emit_const(net, type == AST_PLUS ? 0.0 : 1.0);
+
+      for(i=0; i<n; i++)
+      {
+        if(!compile_node(net, ASTNode_getChild(node, i), local, spec, depth + (i>0), maxdepth, err))
+          return 0;
+        if(i > 0 && !emit(net, type == AST_PLUS ? OP_ADD : OP_MUL, 0))
+          return 0;
+      }
+      return 1;
+
+    case AST_MINUS:
+      if(n == 1)
+        return compile_node(net, ASTNode_getChild(node, 0), local, spec, depth, maxdepth, err)
+               && emit(net, OP_NEG, 0);
+      /* fall through, binary */
+    case AST_DIVIDE:
+    case AST_POWER:
+    case AST_FUNCTION_POWER:
+    case AST_FUNCTION_LOG:
+    case AST_FUNCTION_ROOT:
+      if(n == 1 && (type == AST_FUNCTION_LOG || type == AST_FUNCTION_ROOT))
+      {
+        f = type == AST_FUNCTION_LOG ? F_LOG10 : F_SQRT;
+        break;
+      }
+      if(n != 2)
+        break;
+
+      if(!compile_node(net, ASTNode_getChild(node, 0), local, spec, depth, maxdepth, err) ||
+         !compile_node(net, ASTNode_getChild(node, 1), local, spec, depth+1, maxdepth, err))
+        return 0;
+
+      switch(type)
+      {
+        case AST_MINUS:         return emit(net, OP_SUB, 0);
+        case AST_DIVIDE:        return emit(net, OP_DIV, 0);
+        case AST_FUNCTION_LOG:  return emit(net, OP_LOGB, 0);
+        case AST_FUNCTION_ROOT: return emit(net, OP_ROOT, 0);
+        default:                return emit(net, OP_POW, 0);
+      }
+
+    case AST_FUNCTION_ABS:     f = F_ABS;     break;
+    case AST_FUNCTION_ARCCOS:  f = F_ARCCOS;  break;
+    case AST_FUNCTION_ARCSIN:  f = F_ARCSIN;  break;
+    case AST_FUNCTION_ARCTAN:  f = F_ARCTAN;  break;
+    case AST_FUNCTION_CEILING: f = F_CEILING; break;
+    case AST_FUNCTION_COS:     f = F_COS;     break;
+    case AST_FUNCTION_COSH:    f = F_COSH;    break;
+    case AST_FUNCTION_EXP:     f = F_EXP;     break;
+    case AST_FUNCTION_FLOOR:   f = F_FLOOR;   break;
+    case AST_FUNCTION_LN:      f = F_LN;      break;
+    case AST_FUNCTION_SIN:     f = F_SIN;     break;
+    case AST_FUNCTION_SINH:    f = F_SINH;    break;
+    case AST_FUNCTION_TAN:     f = F_TAN;     break;
+    case AST_FUNCTION_TANH:    f = F_TANH;    break;
+
+    default:
+      break;
+  }
+
+  if(f >= 0 && n == 1)
+    return compile_node(net, ASTNode_getChild(node, n-1), local, spec, depth, maxdepth, err)
+           && emit(net, OP_FUNC, f);
+
+  fprintf(stderr, "net_compile: unsupported kinetic law term (AST type %d, %d arguments), returning NULL...\n", type, n);
+  *err = 1;
+  return 0;
+}
+
+/*
+ Compile the species, parameters, kinetic laws and stoichiometry of model.
+ Returns NULL, with a message, if anything can't be compiled.
+*/
+NETWORK * net_compile(Model_t *model)
+{
+  int i, j, k, n, nr, np, maxdepth, err=0;
+  void **sp=0x0, **rx=0x0, **items=0x0;
+  const char *formula;
+  ASTNode_t *math;
+  KineticLaw_t *kl;
+  NAMETAB glob, spec, local;
+  NETWORK *net;
+  Reaction_t *r;
+  Species_t *s;
+  SpeciesReference_t *sr;
+
+  net = (NETWORK *) calloc(1, sizeof(NETWORK));
+  if(net == NULL)
+  {
+    fprintf(stderr, "net_compile: malloc error, returning NULL...\n");
+    return NULL;
+  }
+  glob.name = spec.name = local.name = NULL;
+  glob.index = spec.index = local.index = NULL;
+
+  /* species */
+  net->nspecies = list_items(Model_getListOfSpecies(model), &sp);
+  net->nreactions = nr = list_items(Model_getListOfReactions(model), &rx);
+  if(net->nspecies < 0 || nr < 0)
+    goto malloc_error;
+
+  net->species = (char **) malloc((net->nspecies+1)*sizeof(char *));
+  net->init    = (double *) malloc((net->nspecies+1)*sizeof(double));
+  net->fixed   = (char *) malloc(net->nspecies+1);
+  if(!net->species || !net->init || !net->fixed || !nt_init(&spec, net->nspecies))
+    goto malloc_error;
+
+  for(i=0; i<net->nspecies; i++)
+  {
+    s = (Species_t *) sp[i];
+    net->species[i] = (char *) Species_getId(s);
+    net->init[i]    = Species_isSetInitialConcentration(s) ? Species_getInitialConcentration(s) : Species_getInitialAmount(s);
+    net->fixed[i]   = Species_getBoundaryCondition(s) || Species_getConstant(s);
+    nt_put(&spec, net->species[i], i);
+  }
+
+  /* parameters, counted first so they can be held in one array: the model's (-g), then each law's */
+  np = Model_getNumParameters(model);
+  for(i=0; i<nr; i++)
+    if((kl = Reaction_getKineticLaw((Reaction_t *) rx[i])))
+      np += KineticLaw_getNumParameters(kl);
+
+  net->reactions = (char **) malloc((nr+1)*sizeof(char *));
+  net->laws      = (char **) malloc((nr+1)*sizeof(char *));
+  net->code_off  = (int *) malloc((nr+1)*sizeof(int));
+  net->st_off    = (int *) malloc((nr+1)*sizeof(int));
+  net->params    = (char **) malloc((np+1)*sizeof(char *));
+  net->param     = (double *) malloc((np+1)*sizeof(double));
+  if(!net->reactions || !net->laws || !net->code_off || !net->st_off || !net->params || !net->param)
+    goto malloc_error;
+
+  n = list_items(Model_getListOfParameters(model), &items);
+  if(n < 0 || !nt_init(&glob, n))
+    goto malloc_error;
+  for(j=0; j<n; j++)
+  {
+    net->params[net->nparams] = (char *) Parameter_getId((Parameter_t *) items[j]);
+    net->param[net->nparams]  = Parameter_getValue((Parameter_t *) items[j]);
+    nt_put(&glob, net->params[net->nparams], net->nparams);
+    net->nparams++;
+  }
+  free(items);
+  items = NULL;
+
+  net->hill    = hill_create(net->nspecies);
+  net->is_hill = (char *) calloc(nr+1, 1);
+  if(!net->hill || !net->is_hill)
+    goto malloc_error;
+
+  /* kinetic laws */
+  for(i=0; i<nr; i++)
+  {
+    r  = (Reaction_t *) rx[i];
+    kl = Reaction_getKineticLaw(r);
+    net->reactions[i] = (char *) Reaction_getId(r);
+    net->code_off[i]  = net->ncode;
+
+    if(kl == NULL || (formula = KineticLaw_getFormula(kl)) == NULL)
+    {
+      fprintf(stderr, "net_compile: reaction %s has no kinetic law, returning NULL...\n", net->reactions[i]);
+      goto error;
+    }
+    net->laws[i] = (char *) formula;
+
+    n = list_items(KineticLaw_getListOfParameters(kl), &items);
+    if(n < 0 || !nt_init(&local, n))
+      goto malloc_error;
+    local.up = &glob;
+
+    for(j=0; j<n; j++)
+    {
+      net->params[net->nparams] = (char *) Parameter_getId((Parameter_t *) items[j]);
+      net->param[net->nparams]  = Parameter_getValue((Parameter_t *) items[j]);
+      nt_put(&local, net->params[net->nparams], net->nparams);
+      net->nparams++;
+    }
+    free(items);
+    items = NULL;
+
+    math = SBML_parseFormula(formula);
+    if(math == NULL)
+    {
+      fprintf(stderr, "net_compile: can't parse kinetic law %s of %s, returning NULL...\n", formula, net->reactions[i]);
+      goto error;
+    }
+
+    maxdepth = 0;
+    k = compile_node(net, math, &local, &spec, 0, &maxdepth, &err);
+    if(k && net->hill)
+      net->is_hill[i] = hill_match(net->hill, math, &local, &spec, i);
+    ASTNode_free(math);
+    nt_free(&local);
+    local.name = NULL;
+    local.index = NULL;
+    if(!k)
+    {
+      if(err)
+        fprintf(stderr, "net_compile: in kinetic law %s of %s\n", formula, net->reactions[i]);
+      else
+        goto malloc_error;
+      goto error;
+    }
+
+    if(maxdepth > net->maxstack)
+      net->maxstack = maxdepth;
+  }
+  net->code_off[nr] = net->ncode;
+  hill_set_params(net->hill, net->param);
+  net->worksz = net->maxstack + hill_worksize(net->hill);
+
+  /* stoichiometry */
+  for(i=0, n=0; i<nr; i++)
+    n += Reaction_getNumReactants((Reaction_t *) rx[i]) + Reaction_getNumProducts((Reaction_t *) rx[i]);
+
+  net->st_species = (int *) malloc((n+1)*sizeof(int));
+  net->st_coef    = (double *) malloc((n+1)*sizeof(double));
+  if(!net->st_species || !net->st_coef)
+    goto malloc_error;
+
+  for(i=0, n=0; i<nr; i++)
+  {
+    r = (Reaction_t *) rx[i];
+    net->st_off[i] = n;
+
+    for(j=0; j<Reaction_getNumReactants(r) + Reaction_getNumProducts(r); j++)
+    {
+      if(j < Reaction_getNumReactants(r))
+        sr = Reaction_getReactant(r, j);
+      else
+        sr = Reaction_getProduct(r, j - Reaction_getNumReactants(r));
+
+      k = nt_get(&spec, SimpleSpeciesReference_getSpecies((SimpleSpeciesReference_t *) sr));
+      if(k < 0)
+      {
+        fprintf(stderr, "net_compile: reaction %s refers to unknown species %s, returning NULL...\n",
+                net->reactions[i], SimpleSpeciesReference_getSpecies((SimpleSpeciesReference_t *) sr));
+        goto error;
+      }
+
+      net->st_species[n] = k;
+      net->st_coef[n]    = j < Reaction_getNumReactants(r) ? -SpeciesReference_getStoichiometry(sr)
+                                                           :  SpeciesReference_getStoichiometry(sr);
+      n++;
+    }
+  }
+  net->st_off[nr] = n;
+
+  nt_free(&glob);
+  nt_free(&spec);
+  free(sp);
+  free(rx);
+  return net;
+
+malloc_error:
+  fprintf(stderr, "net_compile: malloc error, returning NULL...\n");
+error:
+  nt_free(&glob);
+  nt_free(&spec);
+  nt_free(&local);
+  free(items);
+  free(sp);
+  free(rx);
+  net_free(net);
+  return NULL;
+}
+
+/*
+ Hand the law of reaction r to the batch evaluator if it has the generalized
+ Hill form (see hill.h): a sum of terms, or a sum of terms over a constant
+ plus a sum of terms, each term a literal times at most one parameter times
+ power(species/K, n) or species factors. Returns 1 if it was taken.
+*/
+static int hill_match(HILLSET *hs, ASTNode_t *law, NAMETAB *local, NAMETAB *spec, int r)
+{
+  int ok;
+  ASTNode_t *sub=0x0;
+
+  if(!hill_reaction(hs, r))
+    return 0;
+
+  /* -n: synthesis less degradation */
+  if(ASTNode_getType(law) == AST_MINUS && ASTNode_getNumChildren(law) == 2)
+  {
+    sub = ASTNode_getChild(law, 1);
+    law = ASTNode_getChild(law, 0);
+  }
+
+  if(ASTNode_getType(law) == AST_DIVIDE && ASTNode_getNumChildren(law) == 2)
+  {
+    ok = hill_sum(hs, ASTNode_getChild(law, 0), local, spec, 0);
+    if(ok)
+    {
+      hill_denominator(hs, 0.0);
+      ok = hill_sum(hs, ASTNode_getChild(law, 1), local, spec, 1);
+    }
+  }
+  else
+    ok = hill_sum(hs, law, local, spec, 0);
+
+  if(ok && sub)
+  {
+    hill_subtract(hs);
+    ok = hill_sum(hs, sub, local, spec, 0);
+  }
+
+  if(!ok)
+    hill_drop(hs);
+  return ok;
+}
+
+/* the terms of a sum; in a denominator, literal terms add to its constant */
+static int hill_sum(HILLSET *hs, ASTNode_t *node, NAMETAB *local, NAMETAB *spec, int den)
+{
+  int i, cp;
+  double c;
+
+  if(ASTNode_getType(node) == AST_PLUS)
+  {
+    for(i=0; i<ASTNode_getNumChildren(node); i++)
+      if(!hill_sum(hs, ASTNode_getChild(node, i), local, spec, den))
+        return 0;
+    return 1;
+  }
+
+  if(den && hill_value(node, NULL, &c, &cp))
+  {
+    hs->r_c0[hs->nreactions-1] += c;
+    return 1;
+  }
+
+  return hill_monomial(hs, node, local, spec);
+}
+
+/* a term: check it and find its coefficient, then add it and its factors */
+static int hill_monomial(HILLSET *hs, ASTNode_t *node, NAMETAB *local, NAMETAB *spec)
+{
+  int cp = -1;
+  double c = 1.0;
+
+  if(!hill_scan(hs, node, local, spec, &c, &cp, 0))
+    return 0;
+
+  return hill_term(hs, c, cp) && hill_scan(hs, node, local, spec, &c, &cp, 1);
+}
+
+/*
+ Walk the product node. With add == 0 only check it fits, multiplying
+ literals into *c and noting the one parameter allowed in *cp; with add != 0
+ add its factors to the current term.
+*/
+static int hill_scan(HILLSET *hs, ASTNode_t *node, NAMETAB *local, NAMETAB *spec, double *c, int *cp, int add)
+{
+  int i, sp, Kp=-1, np=-1, type;
+  double K=1.0, n=1.0, value;
+  ASTNode_t *base;
+
+  type = ASTNode_getType(node);
+
+  if(type == AST_TIMES)
+  {
+    for(i=0; i<ASTNode_getNumChildren(node); i++)
+      if(!hill_scan(hs, ASTNode_getChild(node, i), local, spec, c, cp, add))
+        return 0;
+    return 1;
+  }
+
+  /* a literal or a parameter, part of the coefficient */
+  if(hill_value(node, local, &value, &i))
+  {
+    if(add)
+      return 1;
+    if(i < 0)
+      *c *= value;
+    else if(*cp < 0)
+      *cp = i;
+    else
+      return 0;
+    return 1;
+  }
+
+  /* species, or power(species, n), or power(species/K, n) */
+  base = node;
+  if((type == AST_POWER || type == AST_FUNCTION_POWER) && ASTNode_getNumChildren(node) == 2)
+  {
+    if(!hill_value(ASTNode_getChild(node, 1), local, &n, &np))
+      return 0;
+    base = ASTNode_getChild(node, 0);
+
+    if(ASTNode_getType(base) == AST_DIVIDE && ASTNode_getNumChildren(base) == 2)
+    {
+      if(!hill_value(ASTNode_getChild(base, 1), local, &K, &Kp))
+        return 0;
+      base = ASTNode_getChild(base, 0);
+    }
+  }
+
+  if(ASTNode_getType(base) != AST_NAME || nt_get(local, ASTNode_getName(base)) >= 0 ||
+     (sp = nt_get(spec, ASTNode_getName(base))) < 0)
+    return 0;
+
+  return add ? hill_factor(hs, sp, K, Kp, n, np) : 1;
+}
+
+/* a number (*p = -1), or with local given, a parameter of the law (*p its index) */
+static int hill_value(ASTNode_t *node, NAMETAB *local, double *value, int *p)
+{
+  *p = -1;
+  switch(ASTNode_getType(node))
+  {
+    case AST_INTEGER:
+      *value = (double)ASTNode_getInteger(node);
+      return 1;
+
+    case AST_REAL:
+    case AST_REAL_E:
+    case AST_RATIONAL:
+      *value = ASTNode_getReal(node);
+      return 1;
+
+    case AST_NAME:
+      if(local && (*p = nt_get(local, ASTNode_getName(node))) >= 0)
+      {
+        *value = 1.0;
+        return 1;
+      }
+      *p = -1;
+      return 0;
+
+    default:
+      return 0;
+  }
+}
+
+void net_free(NETWORK *net)
+{
+  if(net == NULL)
+    return;
+
+  free(net->species);
+  free(net->init);
+  free(net->fixed);
+  free(net->params);
+  free(net->param);
+  free(net->reactions);
+  free(net->laws);
+  free(net->code_off);
+  free(net->code);
+  free(net->consts);
+  free(net->st_off);
+  free(net->st_species);
+  free(net->st_coef);
+  hill_free(net->hill);
+  free(net->is_hill);
+  free(net);
+}
+
+/*
+ Rate of reaction r at time t and state y, with parameter values param
+ (net->param, or a sample of them). stack must hold net->maxstack doubles.
+ A Hill law reads its concentrations clamped below at DBL_MIN, as
+ hill_rates() does, so the two give the same rate.
+*/
+double net_rate(const NETWORK *net, int r, const double *param, double t, const double *y, double *stack)
+{
+  int clamp, sp = -1;
+  const NETOP *op, *end;
+
+  clamp = net->is_hill[r];
+
+  end = net->code + net->code_off[r+1];
+  for(op = net->code + net->code_off[r]; op < end; op++)
+  {
+    switch(op->op)
+    {
+      case OP_CONST:   stack[++sp] = net->consts[op->arg]; break;
+      case OP_PARAM:   stack[++sp] = param[op->arg];       break;
+      case OP_SPECIES: stack[++sp] = !clamp || y[op->arg] > DBL_MIN ? y[op->arg] : DBL_MIN; break;
+      case OP_TIME:    stack[++sp] = t;                    break;
+      case OP_ADD:     sp--; stack[sp] += stack[sp+1];     break;
+      case OP_SUB:     sp--; stack[sp] -= stack[sp+1];     break;
+      case OP_MUL:     sp--; stack[sp] *= stack[sp+1];     break;
+      case OP_DIV:     sp--; stack[sp] /= stack[sp+1];     break;
+      case OP_POW:     sp--; stack[sp] = pow(stack[sp], stack[sp+1]);               break;
+      case OP_LOGB:    sp--; stack[sp] = log(stack[sp+1])/log(stack[sp]);           break;
+      case OP_ROOT:    sp--; stack[sp] = pow(stack[sp+1], 1.0/stack[sp]);           break;
+      case OP_NEG:     stack[sp] = -stack[sp]; break;
+      case OP_FUNC:
+        switch(op->arg)
+        {
+          case F_ABS:     stack[sp] = fabs(stack[sp]);  break;
+          case F_ARCCOS:  stack[sp] = acos(stack[sp]);  break;
+          case F_ARCSIN:  stack[sp] = asin(stack[sp]);  break;
+          case F_ARCTAN:  stack[sp] = atan(stack[sp]);  break;
+          case F_CEILING: stack[sp] = ceil(stack[sp]);  break;
+          case F_COS:     stack[sp] = cos(stack[sp]);   break;
+          case F_COSH:    stack[sp] = cosh(stack[sp]);  break;
+          case F_EXP:     stack[sp] = exp(stack[sp]);   break;
+          case F_FLOOR:   stack[sp] = floor(stack[sp]); break;
+          case F_LN:      stack[sp] = log(stack[sp]);   break;
+          case F_LOG10:   stack[sp] = log10(stack[sp]); break;
+          case F_SIN:     stack[sp] = sin(stack[sp]);   break;
+          case F_SINH:    stack[sp] = sinh(stack[sp]);  break;
+          case F_SQRT:    stack[sp] = sqrt(stack[sp]);  break;
+          case F_TAN:     stack[sp] = tan(stack[sp]);   break;
+          case F_TANH:    stack[sp] = tanh(stack[sp]);  break;
+        }
+        break;
+    }
+  }
+
+  return stack[0];
+}
+
+/*
+ dy/dt at (t, y): the rates go to v (nreactions), the derivatives to dydt
+ (nspecies); fixed species get 0. work must hold net->worksz doubles.
+ hs, if not NULL, is net->hill or a hill_copy() of it loaded with param by
+ hill_set_params(), and gives the rates of the Hill laws.
+*/
+void net_deriv(const NETWORK *net, const HILLSET *hs, const double *param, double t, const double *y, double *v, double *dydt, double *work)
+{
+  int i, r, batch;
+
+  for(i=0; i<net->nspecies; i++)
+    dydt[i] = 0.0;
+
+  batch = hs != NULL;
+  if(batch)
+    hill_rates(hs, y, v, work + net->maxstack);
+
+  for(r=0; r<net->nreactions; r++)
+  {
+    if(!batch || !net->is_hill[r])
+      v[r] = net_rate(net, r, param, t, y, work);
+    for(i=net->st_off[r]; i<net->st_off[r+1]; i++)
+      dydt[net->st_species[i]] += net->st_coef[i] * v[r];
+  }
+
+  for(i=0; i<net->nspecies; i++)
+    if(net->fixed[i])
+      dydt[i] = 0.0;
+}
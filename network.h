@@ -0,0 +1,122 @@
+/* network.h
+ *
+ * A compiled, in-memory form of the network nemo2sbml has just built: the
+ * species, and every reaction's kinetic law compiled to a small stack program
+ * with its stoichiometry, so the model can be evaluated and simulated without
+ * writing SBML and re-reading it elsewhere.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <sbml/SBMLTypes.h>
+#include "hill.h"
+
+/* stack program operations */
+#define OP_CONST   0 /* push consts[arg] */
+#define OP_PARAM   1 /* push param[arg] */
+#define OP_SPECIES 2 /* push y[arg] */
+#define OP_TIME    3
+#define OP_ADD     4
+#define OP_SUB     5
+#define OP_MUL     6
+#define OP_DIV     7
+#define OP_POW     8
+#define OP_NEG     9
+#define OP_LOGB   10 /* log(base, x) */
+#define OP_ROOT   11 /* root(degree, x) */
+#define OP_FUNC   12 /* one argument function, arg is one of the F_ below */
+
+#define F_ABS      0
+#define F_ARCCOS   1
+#define F_ARCSIN   2
+#define F_ARCTAN   3
+#define F_CEILING  4
+#define F_COS      5
+#define F_COSH     6
+#define F_EXP      7
+#define F_FLOOR    8
+#define F_LN       9
+#define F_LOG10   10
+#define F_SIN     11
+#define F_SINH    12
+#define F_SQRT    13
+#define F_TAN     14
+#define F_TANH    15
+
+typedef struct
+{
+  int op, arg;
+} NETOP;
+
+typedef struct
+{
+  int      nspecies;
+  char   **species;    /* ids, in model order */
+  double  *init;       /* initial concentrations */
+  char    *fixed;      /* boundary or constant species, never change */
+
+  int      nparams;
+  char   **params;     /* parameter ids, the model's, then each kinetic law's */
+  double  *param;      /* their values in the model */
+
+  int      nreactions;
+  char   **reactions;  /* ids */
+  char   **laws;       /* kinetic law formulas */
+  int     *code_off;   /* law of reaction r is code[code_off[r]] .. code[code_off[r+1]-1] */
+  NETOP   *code;
+  int      ncode, codeSz;
+  double  *consts;
+  int      nconsts, constsSz;
+  int      maxstack;   /* deepest stack any law needs */
+  int      worksz;     /* doubles of work space for net_rate() and net_deriv() */
+
+  HILLSET *hill;       /* the generalized Hill laws, evaluated in a batch */
+  char    *is_hill;    /* reaction r's law is in hill */
+
+  int     *st_off;     /* stoichiometry of reaction r is st_*[st_off[r]] .. st_*[st_off[r+1]-1] */
+  int     *st_species;
+  double  *st_coef;    /* + for products, - for reactants */
+} NETWORK;
+
+/* called with each output row of net_simulate(), y has nspecies entries */
+typedef int (*NETROW)(void *, double, const double *);
+
+NETWORK * net_compile(Model_t *);
+void net_free(NETWORK *);
+double net_rate(const NETWORK *, int, const double *, double, const double *, double *);
+void net_deriv(const NETWORK *, const HILLSET *, const double *, double, const double *, double *, double *, double *);
+int net_simulate(const NETWORK *, const HILLSET *, const double *, double, double, NETROW, void *);
+
+/* fills the parameter vector (nparams) of ensemble sample k */
+typedef void (*NETSAMPLE)(void *, int, double *);
+
+int net_ensemble(const NETWORK *, int, int, double, double, NETSAMPLE, void *, double **, double **, int *);
+
+/* called with each output row of trajectory k of net_ssa(), x has nspecies entries, in molecules */
+typedef int (*NETSSAROW)(void *, int, double, const double *);
+
+int net_ssa(const NETWORK *, const double *, int, int, double, double, double, long, NETSSAROW, void *, int *);
+
+/* how net_steady() went */
+typedef struct
+{
+  int    converged;
+  int    iterations;  /* Newton iterations, all tries */
+  double tIntegrated; /* time integrated to before the last try, 0 if none */
+  double residual;    /* max |dy/dt| at the result */
+} NETSTEADY;
+
+int net_steady(const NETWORK *, const HILLSET *, const double *, double *, NETSTEADY *);
+
+/* writes a string for net_jacobian(), returns 0 on success */
+typedef int (*NETPUTS)(void *, const char *);
+
+int net_jacobian(const NETWORK *, int, NETPUTS, void *);
+
+#endif
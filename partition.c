@@ -0,0 +1,543 @@
+/* partition.c
+ *
+ * Partition of a network into submodels, see partition.h.
+ *
+ * A regulation is a species read by a reaction (as a modifier, or reactant or
+ * product) that changes another species; each reaction belongs to the part of
+ * the species it changes. The species are first ordered breadth first from
+ * the most connected one, which for a range.c network is the master
+ * regulator, so that a DOR and the TMLISTs hung on it stay together, and the
+ * order is cut into K equal blocks. The blocks are then refined by moving
+ * species on a part boundary to the neighboring part they have the most
+ * regulations with, as long as the cut gets smaller and no part grows more
+ * than 5% past an even share, or shrinks more than 5% below it; each pass
+ * is O(regulations).
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sbml/math/FormulaParser.h>
+#include "partition.h"
+
+#define PASSES 8 /* of refinement, at most */
+
+static int list_items(ListOf_t *, void ***);
+static int list_collect(const void *);
+static int name_index(const char **, int *, int, const char *);
+static void mark_names(ASTNode_t *, const char **, int *, int, char *);
+static int add_edge(int, int);
+static int cmp_id(const void *, const void *);
+static int cmp_degree(const void *, const void *);
+static int cmp_long(const void *, const void *);
+
+/* process-wide, so one partition at a time: only nemo2sbml -P makes them, see nemo.h */
+static void **collected;
+static int    numCollected;
+
+static const char **ids; /* the names cmp_id() compares, ids[n] the one looked up */
+static int *byId, nspecies;
+static int *esrc, *edst, numEdges, edgesSz;
+static int *deg;
+
+/* the partition of model's variable species into k parts, NULL on a malloc error */
+PARTITION * part_compute(Model_t *model, int k)
+{
+  int a, b, best, cap, gain, h, head, i, j, lo, moved, n, nr, nt, pass, tail, u, v;
+  int *adj=0x0, *adjOff=0x0, *conn=0x0, *byDeg=0x0, *order=0x0, *touched=0x0, *var=0x0, *vpart=0x0, *rhome=0x0;
+  long *pairs=0x0;
+  void **sp=0x0, **rx=0x0;
+  PARTITION *pt;
+  Reaction_t *r;
+  Species_t *s;
+  SimpleSpeciesReference_t *sr;
+
+  pt = (PARTITION *) calloc(1, sizeof(PARTITION));
+  if(!pt)
+    return NULL;
+  ids = 0x0;
+  byId = deg = esrc = edst = 0x0;
+  numEdges = edgesSz = 0;
+
+  nspecies = list_items(Model_getListOfSpecies(model), &sp);
+  nr = list_items(Model_getListOfReactions(model), &rx);
+  if(nspecies < 0 || nr < 0)
+    goto malloc_error;
+  pt->nspecies   = nspecies;
+  pt->nreactions = nr;
+
+  /* the variable species, and the species by id */
+  ids       = pt->species = (const char **) malloc((nspecies+1)*sizeof(char *));
+  byId      = (int *) malloc((nspecies+1)*sizeof(int));
+  var       = (int *) malloc((nspecies+1)*sizeof(int));
+  pt->part  = (int *) malloc((nspecies+1)*sizeof(int));
+  pt->rpart = (int *) malloc((nr+1)*sizeof(int));
+  rhome     = (int *) malloc((nr+1)*sizeof(int));
+  if(!ids || !byId || !var || !pt->part || !pt->rpart || !rhome)
+    goto malloc_error;
+
+  for(i=n=0; i<nspecies; i++)
+  {
+    s = (Species_t *) sp[i];
+    ids[i]  = Species_getId(s);
+    byId[i] = i;
+    if(Species_getBoundaryCondition(s) || Species_getConstant(s))
+      var[i] = -1;
+    else
+      var[i] = n++;
+  }
+  qsort(byId, nspecies, sizeof(int), cmp_id); /* ids is the species' */
+  pt->nvariable = n;
+
+  /* the regulations, read species -> changed species */
+  for(i=0; i<nr; i++)
+  {
+    r = (Reaction_t *) rx[i];
+    rhome[i] = -1;
+    for(j=0; rhome[i] < 0 && j<Reaction_getNumProducts(r) + Reaction_getNumReactants(r); j++)
+    {
+      sr = (SimpleSpeciesReference_t *) (j < Reaction_getNumProducts(r) ? Reaction_getProduct(r, j)
+                                                                          : Reaction_getReactant(r, j - Reaction_getNumProducts(r)));
+      if((h = name_index(pt->species, byId, nspecies, SimpleSpeciesReference_getSpecies(sr))) >= 0 && var[h] >= 0)
+        rhome[i] = h;
+    }
+    if((h = rhome[i]) < 0)
+      continue;
+
+    for(j=0; j<Reaction_getNumModifiers(r) + Reaction_getNumProducts(r) + Reaction_getNumReactants(r); j++)
+    {
+      if(j < Reaction_getNumModifiers(r))
+        sr = (SimpleSpeciesReference_t *) Reaction_getModifier(r, j);
+      else if(j < Reaction_getNumModifiers(r) + Reaction_getNumProducts(r))
+        sr = (SimpleSpeciesReference_t *) Reaction_getProduct(r, j - Reaction_getNumModifiers(r));
+      else
+        sr = (SimpleSpeciesReference_t *) Reaction_getReactant(r, j - Reaction_getNumModifiers(r) - Reaction_getNumProducts(r));
+      if((u = name_index(pt->species, byId, nspecies, SimpleSpeciesReference_getSpecies(sr))) >= 0 && var[u] >= 0 && u != h)
+        if(!add_edge(u, h))
+          goto malloc_error;
+    }
+  }
+  pt->edges = numEdges;
+
+  /* the undirected graph of the variable species */
+  pt->k = k < n ? k : (n > 0 ? n : 1);
+  k = pt->k;
+  adjOff  = (int *) calloc(n+2, sizeof(int));
+  adj     = (int *) malloc((2*numEdges+1)*sizeof(int));
+  deg     = (int *) calloc(n+1, sizeof(int));
+  order   = (int *) malloc((n+1)*sizeof(int));
+  byDeg   = (int *) malloc((n+1)*sizeof(int));
+  vpart   = (int *) malloc((n+1)*sizeof(int));
+  conn    = (int *) calloc(k, sizeof(int));
+  touched = (int *) malloc(k*sizeof(int));
+  pt->size      = (int *) calloc(k, sizeof(int));
+  pt->boundary  = (int *) calloc(k, sizeof(int));
+  pt->reactions = (int *) calloc(k, sizeof(int));
+  if(!adjOff || !adj || !deg || !order || !byDeg || !vpart || !conn || !touched || !pt->size || !pt->boundary || !pt->reactions)
+    goto malloc_error;
+
+  for(i=0; i<numEdges; i++)
+  {
+    adjOff[var[esrc[i]]+2]++;
+    adjOff[var[edst[i]]+2]++;
+  }
+  for(u=0; u<n; u++)
+  {
+    deg[u] = adjOff[u+2];
+    adjOff[u+2] += adjOff[u+1];
+  }
+  for(i=0; i<numEdges; i++)
+  {
+    u = var[esrc[i]];
+    v = var[edst[i]];
+    adj[adjOff[u+1]++] = v;
+    adj[adjOff[v+1]++] = u;
+  }
+
+  /* breadth first from the most connected species not yet reached, cut into k blocks */
+  for(u=0; u<n; u++)
+  {
+    order[u] = u;
+    vpart[u] = -1;
+  }
+  qsort(order, n, sizeof(int), cmp_degree);
+  memcpy(byDeg, order, n*sizeof(int));
+  for(i=head=tail=0; i<n; i++)
+  {
+    if(vpart[byDeg[i]] >= 0)
+      continue;
+    vpart[byDeg[i]] = 0;
+    order[tail++] = byDeg[i];
+    while(head < tail)
+    {
+      u = order[head++];
+      for(j=adjOff[u]; j<adjOff[u+1]; j++)
+        if(vpart[adj[j]] < 0)
+        {
+          vpart[adj[j]] = 0;
+          order[tail++] = adj[j];
+        }
+    }
+  }
+  for(i=0; i<n; i++)
+  {
+    vpart[order[i]] = (int)((long) i*k/n);
+    pt->size[vpart[order[i]]]++;
+  }
+
+  /* move boundary species while the cut shrinks */
+  cap = (int)((21L*n + 20*k - 1)/(20*k));
+  if(cap < (n+k-1)/k)
+    cap = (n+k-1)/k;
+  lo = (int)(19L*n/(20*k));
+  if(lo < 1)
+    lo = 1;
+  for(pass=0; pass<PASSES; pass++)
+  {
+    for(i=moved=0; i<n; i++)
+    {
+      v = order[i];
+      a = vpart[v];
+      if(pt->size[a] <= lo)
+        continue;
+
+      for(j=adjOff[v], nt=0; j<adjOff[v+1]; j++)
+        if(!conn[b = vpart[adj[j]]]++)
+          touched[nt++] = b;
+      for(j=0, best=a, gain=0; j<nt; j++)
+      {
+        b = touched[j];
+        if(b != a && pt->size[b] < cap &&
+           (conn[b]-conn[a] > gain || (gain > 0 && conn[b]-conn[a] == gain && pt->size[b] < pt->size[best])))
+        {
+          best = b;
+          gain = conn[b]-conn[a];
+        }
+      }
+      for(j=0; j<nt; j++)
+        conn[touched[j]] = 0;
+
+      if(best != a)
+      {
+        vpart[v] = best;
+        pt->size[a]--;
+        pt->size[best]++;
+        moved++;
+      }
+    }
+    if(!moved)
+      break;
+  }
+
+  for(i=0; i<nspecies; i++)
+    pt->part[i] = var[i] >= 0 ? vpart[var[i]] : -1;
+  for(i=0; i<nr; i++)
+  {
+    pt->rpart[i] = rhome[i] >= 0 ? pt->part[rhome[i]] : 0;
+    pt->reactions[pt->rpart[i]]++;
+  }
+
+  /* the cut, and who reads what across it */
+  pairs = (long *) malloc((numEdges+1)*sizeof(long));
+  pt->readOff = (int *) calloc(nspecies+1, sizeof(int));
+  if(!pairs || !pt->readOff)
+    goto malloc_error;
+  for(i=j=0; i<numEdges; i++)
+    if(pt->part[esrc[i]] != pt->part[edst[i]])
+    {
+      pt->cut++;
+      pairs[j++] = (long) esrc[i]*k + pt->part[edst[i]];
+    }
+  qsort(pairs, j, sizeof(long), cmp_long);
+  for(i=nt=0; i<j; i++)
+    if(nt == 0 || pairs[nt-1] != pairs[i])
+      pairs[nt++] = pairs[i];
+
+  pt->readers = (int *) malloc((nt+1)*sizeof(int));
+  if(!pt->readers)
+    goto malloc_error;
+  for(i=0; i<nt; i++)
+  {
+    pt->readOff[pairs[i]/k + 1]++;
+    pt->readers[i] = (int)(pairs[i]%k);
+    pt->boundary[pt->readers[i]]++;
+  }
+  for(i=0; i<nspecies; i++)
+    pt->readOff[i+1] += pt->readOff[i];
+
+  free(sp); free(rx); free(byId); free(var); free(rhome); free(esrc); free(edst);
+  free(adjOff); free(adj); free(deg); free(order); free(byDeg); free(vpart); free(conn); free(touched); free(pairs);
+  return pt;
+
+malloc_error:
+  free(sp); free(rx); free(byId); free(var); free(rhome); free(esrc); free(edst);
+  free(adjOff); free(adj); free(deg); free(order); free(byDeg); free(vpart); free(conn); free(touched); free(pairs);
+  part_free(pt);
+  return NULL;
+}
+
+/* part p of doc's model, as a document of its own; NULL on a malloc error */
+SBMLDocument_t * part_document(SBMLDocument_t *doc, const PARTITION *pt, int p)
+{
+  char *name, *used=0x0;
+  const char **pids=0x0;
+  int i, j, np, reads, *byPid=0x0;
+  void **sp=0x0, **rx=0x0, **pp=0x0;
+  ASTNode_t *law;
+  Compartment_t *c, *nc;
+  KineticLaw_t *kl, *nkl;
+  Model_t *model, *sub;
+  Parameter_t *prm, *nprm;
+  Reaction_t *r, *nr;
+  SBMLDocument_t *part;
+  Species_t *s, *ns;
+  SpeciesReference_t *sr;
+  Unit_t *u;
+  UnitDefinition_t *ud, *nud;
+
+  model = SBMLDocument_getModel(doc);
+  np = list_items(Model_getListOfParameters(model), &pp);
+  name = (char *) malloc(strlen(Model_getId(model)) + (Model_isSetName(model) ? strlen(Model_getName(model)) : 0) + 64);
+  pids  = (const char **) malloc((np+1)*sizeof(char *));
+  byPid = (int *) malloc((np+1)*sizeof(int));
+  used  = (char *) calloc(np+1, 1);
+  if(list_items(Model_getListOfSpecies(model), &sp) != pt->nspecies ||
+     list_items(Model_getListOfReactions(model), &rx) != pt->nreactions || np < 0 || !name || !pids || !byPid || !used)
+  {
+    free(sp); free(rx); free(pp); free(name); free(pids); free(byPid); free(used);
+    return NULL;
+  }
+
+  part = SBMLDocument_createWith(SBMLDocument_getLevel(doc), SBMLDocument_getVersion(doc));
+  sub  = SBMLDocument_createModel(part);
+  sprintf(name, "%s_part%d", Model_getId(model), p);
+  Model_setId(sub, name);
+  sprintf(name, "%s, part %d of %d", Model_isSetName(model) ? Model_getName(model) : Model_getId(model), p, pt->k);
+  Model_setName(sub, name);
+  free(name);
+
+  /* compartments and units, as they are */
+  for(i=0; i<Model_getNumCompartments(model); i++)
+  {
+    c  = Model_getCompartment(model, i);
+    nc = Model_createCompartment(sub);
+    Compartment_setId(nc, Compartment_getId(c));
+    if(Compartment_isSetName(c))
+      Compartment_setName(nc, Compartment_getName(c));
+    Compartment_setVolume(nc, Compartment_getVolume(c));
+  }
+  for(i=0; i<Model_getNumUnitDefinitions(model); i++)
+  {
+    ud  = Model_getUnitDefinition(model, i);
+    nud = Model_createUnitDefinition(sub);
+    UnitDefinition_setId(nud, UnitDefinition_getId(ud));
+    if(UnitDefinition_isSetName(ud))
+      UnitDefinition_setName(nud, UnitDefinition_getName(ud));
+    for(j=0; j<UnitDefinition_getNumUnits(ud); j++)
+    {
+      u = UnitDefinition_getUnit(ud, j);
+      UnitDefinition_addUnit(nud, Unit_createWith(Unit_getKind(u), Unit_getExponent(u), Unit_getScale(u)));
+    }
+  }
+
+  /* the model's parameters (-g) that the part's laws use */
+  for(i=0; i<np; i++)
+  {
+    pids[i]  = Parameter_getId((Parameter_t *) pp[i]);
+    byPid[i] = i;
+  }
+  ids = pids;
+  qsort(byPid, np, sizeof(int), cmp_id);
+  for(i=0; np && i<pt->nreactions; i++)
+    if(pt->rpart[i] == p && (kl = Reaction_getKineticLaw((Reaction_t *) rx[i])) && KineticLaw_getFormula(kl) &&
+       (law = SBML_parseFormula(KineticLaw_getFormula(kl))))
+    {
+      mark_names(law, pids, byPid, np, used);
+      ASTNode_free(law);
+    }
+  for(i=0; i<np; i++)
+  {
+    if(!used[i])
+      continue;
+    prm  = (Parameter_t *) pp[i];
+    nprm = Model_createParameter(sub);
+    Parameter_setId(nprm, Parameter_getId(prm));
+    Parameter_setValue(nprm, Parameter_getValue(prm));
+    if(Parameter_isSetUnits(prm))
+      Parameter_setUnits(nprm, Parameter_getUnits(prm));
+  }
+
+  /* the part's species, the fixed ones, and those of other parts it reads, as boundary species */
+  for(i=0; i<pt->nspecies; i++)
+  {
+    for(j=pt->readOff[i], reads=0; j<pt->readOff[i+1]; j++)
+      if(pt->readers[j] == p)
+        reads = 1;
+    if(pt->part[i] >= 0 && pt->part[i] != p && !reads)
+      continue;
+
+    s  = (Species_t *) sp[i];
+    ns = Model_createSpecies(sub);
+    Species_setId(ns, Species_getId(s));
+    if(Species_isSetName(s))
+      Species_setName(ns, Species_getName(s));
+    Species_setCompartment(ns, Species_getCompartment(s));
+    if(Species_isSetInitialConcentration(s))
+      Species_setInitialConcentration(ns, Species_getInitialConcentration(s));
+    else if(Species_isSetInitialAmount(s))
+      Species_setInitialAmount(ns, Species_getInitialAmount(s));
+    Species_setBoundaryCondition(ns, reads || Species_getBoundaryCondition(s));
+    Species_setConstant(ns, !reads && Species_getConstant(s));
+  }
+
+  /* the part's reactions */
+  for(i=0; i<pt->nreactions; i++)
+  {
+    if(pt->rpart[i] != p)
+      continue;
+
+    r  = (Reaction_t *) rx[i];
+    nr = Model_createReaction(sub);
+    Reaction_setId(nr, Reaction_getId(r));
+    if(Reaction_isSetName(r))
+      Reaction_setName(nr, Reaction_getName(r));
+    Reaction_setReversible(nr, Reaction_getReversible(r));
+
+    for(j=0; j<Reaction_getNumReactants(r); j++)
+    {
+      sr = Reaction_getReactant(r, j);
+      Reaction_addReactant(nr, SpeciesReference_createWith(SimpleSpeciesReference_getSpecies((SimpleSpeciesReference_t *) sr),
+                                                           SpeciesReference_getStoichiometry(sr), SpeciesReference_getDenominator(sr)));
+    }
+    for(j=0; j<Reaction_getNumProducts(r); j++)
+    {
+      sr = Reaction_getProduct(r, j);
+      Reaction_addProduct(nr, SpeciesReference_createWith(SimpleSpeciesReference_getSpecies((SimpleSpeciesReference_t *) sr),
+                                                          SpeciesReference_getStoichiometry(sr), SpeciesReference_getDenominator(sr)));
+    }
+    for(j=0; j<Reaction_getNumModifiers(r); j++)
+      Reaction_addModifier(nr, ModifierSpeciesReference_createWith(
+                                 SimpleSpeciesReference_getSpecies((SimpleSpeciesReference_t *) Reaction_getModifier(r, j))));
+
+    if((kl = Reaction_getKineticLaw(r)))
+    {
+      nkl = KineticLaw_create();
+      KineticLaw_setFormula(nkl, KineticLaw_getFormula(kl));
+      for(j=0; j<KineticLaw_getNumParameters(kl); j++)
+      {
+        prm  = KineticLaw_getParameter(kl, j);
+        nprm = Parameter_create();
+        Parameter_setId(nprm, Parameter_getId(prm));
+        Parameter_setValue(nprm, Parameter_getValue(prm));
+        if(Parameter_isSetUnits(prm))
+          Parameter_setUnits(nprm, Parameter_getUnits(prm));
+        KineticLaw_addParameter(nkl, nprm);
+      }
+      Reaction_setKineticLaw(nr, nkl);
+    }
+  }
+
+  free(sp); free(rx); free(pp); free(pids); free(byPid); free(used);
+  return part;
+}
+
+void part_free(PARTITION *pt)
+{
+  if(!pt)
+    return;
+  free((void *) pt->species); free(pt->part); free(pt->rpart); free(pt->readOff); free(pt->readers);
+  free(pt->size); free(pt->boundary); free(pt->reactions);
+  free(pt);
+}
+
+/* libsbml 2.3.5 lists only have get(n), which walks the list from the head; see network.c */
+static int list_items(ListOf_t *lo, void ***items)
+{
+  collected = (void **) malloc((ListOf_getNumItems(lo)+1)*sizeof(void *));
+  *items = collected;
+  if(collected == NULL)
+    return -1;
+
+  numCollected = 0;
+  ListOf_countIf(lo, list_collect);
+  return numCollected;
+}
+
+static int list_collect(const void *item)
+{
+  collected[numCollected++] = (void *) item;
+  return 0;
+}
+
+/* the index of id in names[0..n-1] (with room for one more), sorted by cmp_id() in sorted; -1 if it is not there */
+static int name_index(const char **names, int *sorted, int n, const char *id)
+{
+  int key = n, *q;
+
+  if(!id)
+    return -1;
+  ids = names;
+  ids[n] = id;
+  q = (int *) bsearch(&key, sorted, n, sizeof(int), cmp_id);
+  return q ? *q : -1;
+}
+
+/* mark in used the names of law that are in names */
+static void mark_names(ASTNode_t *law, const char **names, int *sorted, int n, char *used)
+{
+  int i;
+
+  if(ASTNode_getType(law) == AST_NAME && (i = name_index(names, sorted, n, ASTNode_getName(law))) >= 0)
+    used[i] = 1;
+  for(i=0; i<ASTNode_getNumChildren(law); i++)
+    mark_names(ASTNode_getChild(law, i), names, sorted, n, used);
+}
+
+/* the regulation src -> dst, return 0 on a realloc error */
+static int add_edge(int src, int dst)
+{
+  int *s, *d;
+
+  if(numEdges == edgesSz)
+  {
+    s = (int *) realloc(esrc, (edgesSz+4096)*sizeof(int));
+    if(s)
+      esrc = s;
+    d = (int *) realloc(edst, (edgesSz+4096)*sizeof(int));
+    if(d)
+      edst = d;
+    if(!s || !d)
+      return 0;
+    edgesSz += 4096;
+  }
+  esrc[numEdges]   = src;
+  edst[numEdges++] = dst;
+  return 1;
+}
+
+static int cmp_id(const void *a, const void *b)
+{
+  return strcmp(ids[*(const int *) a], ids[*(const int *) b]);
+}
+
+/* most connected first, then in model order */
+static int cmp_degree(const void *a, const void *b)
+{
+  int x = *(const int *) a, y = *(const int *) b;
+
+  if(deg[x] != deg[y])
+    return deg[x] > deg[y] ? -1 : 1;
+  return x - y;
+}
+
+static int cmp_long(const void *a, const void *b)
+{
+  long x = *(const long *) a, y = *(const long *) b;
+
+  return x < y ? -1 : x > y;
+}
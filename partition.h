@@ -0,0 +1,41 @@
+/* partition.h
+ *
+ * Partition of a network into submodels, -P: the species that change are
+ * split into parts of about the same size with as few regulations between
+ * them as can be found, and each part is made a model of its own, reading
+ * the species of the other parts it depends on as boundary species, so the
+ * parts can be simulated apart and coupled through those species.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <sbml/SBMLTypes.h>
+
+typedef struct
+{
+  int    k;          /* parts */
+  int    nspecies;   /* of the model, in model order */
+  int    nvariable;  /* not boundary or constant */
+  int    nreactions;
+  const char **species; /* ids, the model's own */
+  int   *part;       /* of each species, -1 for the fixed ones */
+  int   *rpart;      /* of each reaction, the part of the species it changes */
+  int   *readOff;    /* species i is read as a boundary species by parts readers[readOff[i]] .. readers[readOff[i+1]-1] */
+  int   *readers;
+  int   *size;       /* species, boundary species and reactions of each part */
+  int   *boundary;
+  int   *reactions;
+  long   edges, cut; /* regulations, and those between parts */
+} PARTITION;
+
+PARTITION * part_compute(Model_t *, int);
+SBMLDocument_t * part_document(SBMLDocument_t *, const PARTITION *, int);
+void part_free(PARTITION *);
+
+#endif
@@ -0,0 +1,376 @@
+/* server.c
+ *
+ * nemo2sbml -d <socket>[,<dir>]: serve nemo_compile() on a Unix socket, so that many
+ * small networks are compiled by one warm process instead of a process each.
+ * Each client is served on a thread of its own, and their compiles run in
+ * parallel, see nemo.h.
+ *
+ * A request is header lines, an empty line, then the NEMO text:
+ *   seed <seedval>    -s, default 123456789
+ *   threads <n>       -j, default and at most the server's -j
+ *   legacy            -l
+ *   kinetic           -k, the laws come back in an info reply
+ *   xgmml             -x
+ *   net               -n
+ *   layout <kind>     -L force or tree, with xgmml
+ *   prefix <prefix>   model ids are <prefix>_<n>; no / or ..
+ *   dir               write <dir>/<id>.xml (and .xgmml) instead of returning
+ *                     them, <dir> the server's own, from -d; clients can't
+ *                     name a directory, so they can't write anywhere else
+ *   length <bytes>    the length of the text; without it the text runs to
+ *                     the end of the connection (shutdown(SHUT_WR) it)
+ * and is answered, for each network, by
+ *   sbml <network> <id> <bytes>\n<the SBML>
+ *   xgmml <network> <id> <bytes>\n<the XGMML>
+ * or, with dir, by
+ *   written <network> <path>\n
+ * then
+ *   info <bytes>\n<the -k laws>            if asked for
+ *   done <errors> <bytes>\n<the errors>    errors is -1 if nothing was compiled
+ * A connection carries any number of requests that have a length.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "nemo.h"
+
+#define BUFSZ    256
+#define MAX_TEXT (1L<<30) /* bytes of NEMO text in a request */
+
+/* a request being compiled, the arg of its sinks */
+typedef struct
+{
+  int   fd;
+  const char *dir;
+  int   err; /* a reply could not be sent */
+} REQUEST;
+
+static void bad_header(char **, size_t *, const char *, const char *);
+static int send_all(int, const char *, size_t);
+static int reply(int, char *, const char *, size_t);
+static int put_doc(REQUEST *, char *, char *, int, const char *, const char *);
+static int put_sbml(void *, int, const char *, const char *);
+static int put_xgmml(void *, int, const char *, const char *);
+static char * read_text(FILE *, long, size_t *);
+static void * serve_client(void *);
+
+static int defaultThreads=1;
+static const char *outDir=0x0; /* of the dir header, -d <socket>,<dir> */
+
+/* listen on path, serving each client on a thread; returns only on failure */
+int nemo_serve(const char *path, const char *dir, int threads)
+{
+  int fd, cfd;
+  struct sockaddr_un addr;
+  struct stat st;
+  pthread_t tid;
+
+  if(strlen(path) >= sizeof(addr.sun_path))
+  {
+    fprintf(stderr, "nemo2sbml: -d: socket name \"%s\" too long, returning...\n", path);
+    return 1;
+  }
+
+  signal(SIGPIPE, SIG_IGN); /* a client that goes away is a failed write, not the end of the server */
+  defaultThreads = threads;
+  outDir = dir;
+
+  if(!lstat(path, &st) && S_ISSOCK(st.st_mode)) /* left by an earlier server */
+    unlink(path);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || listen(fd, 64))
+  {
+    fprintf(stderr, "nemo2sbml: -d: unable to listen on %s (%s), returning...\n", path, strerror(errno));
+    return 1;
+  }
+  printf("nemo2sbml: serving on %s\n", path);
+  fflush(stdout);
+
+  for(;;)
+  {
+    cfd = accept(fd, NULL, NULL);
+    if(cfd < 0)
+    {
+      if(errno == EINTR || errno == ECONNABORTED)
+        continue;
+      fprintf(stderr, "nemo2sbml: -d: accept error (%s), returning...\n", strerror(errno));
+      break;
+    }
+
+    if(pthread_create(&tid, NULL, serve_client, (void *)(long) cfd))
+    {
+      fprintf(stderr, "nemo2sbml: -d: can't create a thread for a client, continuing...\n");
+      close(cfd);
+      continue;
+    }
+    pthread_detach(tid);
+  }
+
+  close(fd);
+  return 1;
+}
+
+/* the requests of one connection, see above */
+static void * serve_client(void *arg)
+{
+  int dir, errors, fd = (int)(long) arg, header;
+  char *errs, head[BUFSZ], *info, *line=0x0, *prefix, *text, *v;
+  long length;
+  size_t errsLen, infoLen, lineSz=0, textLen;
+  FILE *errFp, *in, *infoFp;
+  NEMO_OPTIONS opts;
+  NEMO_SINKS sinks;
+  REQUEST req;
+
+  in = fdopen(fd, "r");
+  if(!in)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  for(;;)
+  {
+    memset(&opts, 0, sizeof(opts));
+    opts.seed    = NEMO_SEED;
+    opts.threads = defaultThreads;
+    dir = 0;
+    prefix = 0x0;
+    length = -1;
+    header = 0;
+    errors = 0;
+    errs = 0x0;
+    errsLen = 0;
+
+    /* the header */
+    while(getline(&line, &lineSz, in) > 0)
+    {
+      header = 1;
+      line[strcspn(line, "\r\n")] = 0x0;
+      if(!line[0])
+        break;
+      if((v = strchr(line, ' ')))
+        *v++ = 0x0;
+      else
+        v = "";
+
+      if(!strcmp(line, "seed"))
+        opts.seed = atol(v);
+      else if(!strcmp(line, "threads"))
+        opts.threads = atoi(v) < 1 ? 1 : atoi(v) > defaultThreads ? defaultThreads : atoi(v);
+      else if(!strcmp(line, "legacy"))
+        opts.legacyRand = 1;
+      else if(!strcmp(line, "kinetic"))
+        opts.kineticLawInfo = 1;
+      else if(!strcmp(line, "xgmml"))
+        opts.xgmml = 1;
+      else if(!strcmp(line, "net"))
+        opts.netReactions = 1;
+      else if(!strcmp(line, "layout") && (!strcmp(v, "force") || !strcmp(v, "tree")))
+        opts.layout = !strcmp(v, "force") ? 1 : 2;
+      else if(!strcmp(line, "prefix") && !prefix && !strchr(v, '/') && !strstr(v, ".."))
+        opts.prefix = prefix = strdup(v);
+      else if(!strcmp(line, "dir") && outDir)
+        dir = 1;
+      else if(!strcmp(line, "length"))
+        length = atol(v);
+      else
+      {
+        bad_header(&errs, &errsLen, line, v);
+        errors = -1;
+      }
+    }
+    if(!header) /* the client is done */
+      break;
+
+    /* the text, then the compile, its replies sent by the sinks */
+    text = 0x0;
+    if(errors == 0 && (length > MAX_TEXT || !(text = read_text(in, length, &textLen))))
+    {
+      errs = strdup("unable to read the NEMO text\n");
+      errsLen = errs ? strlen(errs) : 0;
+      errors = -1;
+    }
+
+    info = 0x0;
+    infoLen = 0;
+    if(errors == 0)
+    {
+      req.fd  = fd;
+      req.dir = dir ? outDir : 0x0;
+      req.err = 0;
+      errFp  = open_memstream(&errs, &errsLen);
+      infoFp = opts.kineticLawInfo ? open_memstream(&info, &infoLen) : 0x0;
+
+      sinks.sbml  = put_sbml;
+      sinks.xgmml = put_xgmml;
+      sinks.arg   = &req;
+      sinks.err   = errFp;
+      sinks.info  = infoFp;
+      errors = nemo_compile(text, textLen, &opts, &sinks);
+
+      if(errFp)
+        fclose(errFp);
+      if(infoFp)
+        fclose(infoFp);
+      if(req.err)
+        length = -1; /* the client is gone */
+    }
+
+    if(infoLen)
+    {
+      sprintf(head, "info %lu\n", (unsigned long) infoLen);
+      reply(fd, head, info, infoLen);
+    }
+    sprintf(head, "done %d %lu\n", errors, (unsigned long) errsLen);
+    if(!reply(fd, head, errs ? errs : "", errsLen))
+      length = -1;
+
+    free(text);
+    free(info);
+    free(errs);
+    free(prefix);
+
+    /* without a length the text ran to the end, and a bad header leaves the stream unknown */
+    if(length < 0 || errors < 0)
+      break;
+  }
+
+  free(line);
+  fclose(in);
+  return NULL;
+}
+
+/* add "bad header ..." to the errors of a request */
+static void bad_header(char **errs, size_t *len, const char *name, const char *v)
+{
+  char *t;
+
+  t = (char *) realloc(*errs, *len + strlen(name) + strlen(v) + 32);
+  if(!t)
+    return;
+  *errs = t;
+  *len += sprintf(t + *len, "bad header \"%s%s%s\"\n", name, *v ? " " : "", v);
+}
+
+/* length bytes of in, or all of it if length < 0; NULL on failure */
+static char * read_text(FILE *in, long length, size_t *len)
+{
+  char *s, *t;
+  size_t n, sz;
+
+  sz = length >= 0 ? length + 1 : 65536;
+  s = (char *) malloc(sz);
+  if(!s)
+    return NULL;
+
+  *len = 0;
+  while((length < 0 || *len < length) && (n = fread(s + *len, 1, (length >= 0 ? length : sz-1) - *len, in)) > 0)
+  {
+    *len += n;
+    if(length < 0 && *len == sz-1)
+    {
+      if(sz > MAX_TEXT || !(t = (char *) realloc(s, 2*sz)))
+      {
+        free(s);
+        return NULL;
+      }
+      s = t;
+      sz *= 2;
+    }
+  }
+
+  if(length >= 0 && *len < length)
+  {
+    free(s);
+    return NULL;
+  }
+  s[*len] = 0x0;
+  return s;
+}
+
+/* write all of s to fd, return 0 on failure */
+static int send_all(int fd, const char *s, size_t len)
+{
+  ssize_t n;
+
+  while(len > 0)
+  {
+    n = write(fd, s, len);
+    if(n < 0)
+    {
+      if(errno == EINTR)
+        continue;
+      return 0;
+    }
+    s   += n;
+    len -= n;
+  }
+  return 1;
+}
+
+/* a reply line, then len bytes of text */
+static int reply(int fd, char *head, const char *text, size_t len)
+{
+  return send_all(fd, head, strlen(head)) && send_all(fd, text, len);
+}
+
+/* send a document to the client, or write it to req->dir and say so */
+static int put_doc(REQUEST *req, char *kind, char *suffix, int network, const char *id, const char *text)
+{
+  char head[2*BUFSZ], *path;
+  int ok;
+  FILE *fp;
+
+  if(req->dir)
+  {
+    path = (char *) malloc(strlen(req->dir) + strlen(id) + 16);
+    if(!path)
+      return 0;
+    sprintf(path, "%s/%s.%s", req->dir, id, suffix);
+
+    ok = (fp = fopen(path, "w")) && fputs(text, fp) >= 0;
+    if(fp && fclose(fp))
+      ok = 0;
+    if(ok)
+    {
+      snprintf(head, sizeof(head), "written %d %s\n", network, path);
+      if(!send_all(req->fd, head, strlen(head)))
+        req->err = 1;
+    }
+    free(path);
+    return ok;
+  }
+
+  snprintf(head, sizeof(head), "%s %d %s %lu\n", kind, network, id, (unsigned long) strlen(text));
+  if(!reply(req->fd, head, text, strlen(text)))
+    req->err = 1;
+  return !req->err;
+}
+
+static int put_sbml(void *arg, int network, const char *id, const char *text)
+{
+  return put_doc((REQUEST *) arg, "sbml", "xml", network, id, text);
+}
+
+static int put_xgmml(void *arg, int network, const char *id, const char *text)
+{
+  return put_doc((REQUEST *) arg, "xgmml", "xgmml", network, id, text);
+}
@@ -0,0 +1,139 @@
+/* simulate.c
+ *
+ * Integrate a compiled network (see network.h) with the Dormand-Prince 5(4)
+ * embedded Runge-Kutta pair, with adaptive step size control, reporting the
+ * state at every multiple of dt from 0 to tEnd.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "network.h"
+
+#define ATOL     1e-9
+#define RTOL     1e-6
+#define MAXSTEPS 1000000 /* per output interval */
+
+/* Dormand-Prince coefficients */
+static const double c2=1.0/5, c3=3.0/10, c4=4.0/5, c5=8.0/9;
+static const double a21=1.0/5;
+static const double a31=3.0/40, a32=9.0/40;
+static const double a41=44.0/45, a42=-56.0/15, a43=32.0/9;
+static const double a51=19372.0/6561, a52=-25360.0/2187, a53=64448.0/6561, a54=-212.0/729;
+static const double a61=9017.0/3168, a62=-355.0/33, a63=46732.0/5247, a64=49.0/176, a65=-5103.0/18656;
+static const double a71=35.0/384, a73=500.0/1113, a74=125.0/192, a75=-2187.0/6784, a76=11.0/84;
+static const double e1=71.0/57600, e3=-71.0/16695, e4=71.0/1920, e5=-17253.0/339200, e6=22.0/525, e7=-1.0/40;
+
+/*
+ Simulate net with parameter values param (and Hill laws hs, see net_deriv())
+ from t = 0 to tEnd, calling row with the state at t = 0, dt, 2dt, ...
+ Returns 0 on success, -1 if the step size underflows or the state stops
+ being finite, and row's return value if that is non-zero.
+*/
+int net_simulate(const NETWORK *net, const HILLSET *hs, const double *param, double tEnd, double dt, NETROW row, void *arg)
+{
+  int i, n, ret=0, steps;
+  long k, nout;
+  double err, h, hmax, sc, t, tout, *k1, *k2, *k3, *k4, *k5, *k6, *k7, *stack, *v, *work, *y, *ytmp, *ynew;
+
+  n = net->nspecies;
+  work = (double *) malloc(((10*n) + net->nreactions + net->worksz + 1)*sizeof(double));
+  if(work == NULL)
+  {
+    fprintf(stderr, "net_simulate: malloc error, returning...\n");
+    return -1;
+  }
+  y  = work;       k1 = y  + n; k2 = k1 + n; k3 = k2 + n; k4 = k3 + n;
+  k5 = k4 + n;     k6 = k5 + n; k7 = k6 + n; ytmp = k7 + n; ynew = ytmp + n;
+  v  = ynew + n;   stack = v + net->nreactions;
+
+  for(i=0; i<n; i++)
+    y[i] = net->init[i];
+
+  t = 0.0;
+  h = hmax = dt;
+  nout = (long) floor(tEnd/dt + 1e-9);
+  net_deriv(net, hs, param, t, y, v, k1, stack);
+
+  if((ret = row(arg, t, y)))
+    goto done;
+
+  for(k=1; k<=nout; k++)
+  {
+    tout = k*dt;
+    for(steps=0; t < tout; steps++)
+    {
+      if(steps == MAXSTEPS || h < 1e-12*(fabs(t)+dt))
+      {
+        fprintf(stderr, "net_simulate: step size too small at t = %g, stopping...\n", t);
+        ret = -1;
+        goto done;
+      }
+      if(t + h > tout)
+        h = tout - t;
+
+      for(i=0; i<n; i++) ytmp[i] = y[i] + h*a21*k1[i];
+      net_deriv(net, hs, param, t + c2*h, ytmp, v, k2, stack);
+      for(i=0; i<n; i++) ytmp[i] = y[i] + h*(a31*k1[i] + a32*k2[i]);
+      net_deriv(net, hs, param, t + c3*h, ytmp, v, k3, stack);
+      for(i=0; i<n; i++) ytmp[i] = y[i] + h*(a41*k1[i] + a42*k2[i] + a43*k3[i]);
+      net_deriv(net, hs, param, t + c4*h, ytmp, v, k4, stack);
+      for(i=0; i<n; i++) ytmp[i] = y[i] + h*(a51*k1[i] + a52*k2[i] + a53*k3[i] + a54*k4[i]);
+      net_deriv(net, hs, param, t + c5*h, ytmp, v, k5, stack);
+      for(i=0; i<n; i++) ytmp[i] = y[i] + h*(a61*k1[i] + a62*k2[i] + a63*k3[i] + a64*k4[i] + a65*k5[i]);
+      net_deriv(net, hs, param, t + h, ytmp, v, k6, stack);
+      for(i=0; i<n; i++) ynew[i] = y[i] + h*(a71*k1[i] + a73*k3[i] + a74*k4[i] + a75*k5[i] + a76*k6[i]);
+      net_deriv(net, hs, param, t + h, ynew, v, k7, stack);
+
+      /* error estimate, as an rms over the species */
+      err = 0.0;
+      for(i=0; i<n; i++)
+      {
+        sc = ATOL + RTOL*fmax(fabs(y[i]), fabs(ynew[i]));
+        sc = h*(e1*k1[i] + e3*k3[i] + e4*k4[i] + e5*k5[i] + e6*k6[i] + e7*k7[i]) / sc;
+        err += sc*sc;
+      }
+      err = n ? sqrt(err/n) : 0.0;
+
+      if(!isfinite(err))
+      {
+        if(h < 1e-12*(fabs(t)+dt))
+        {
+          fprintf(stderr, "net_simulate: state not finite at t = %g, stopping...\n", t);
+          ret = -1;
+          goto done;
+        }
+        h *= 0.1;
+        continue;
+      }
+
+      if(err <= 1.0) /* accept, k7 is k1 of the next step */
+      {
+        t += h;
+        for(i=0; i<n; i++)
+        {
+          y[i]  = ynew[i];
+          k1[i] = k7[i];
+        }
+        if(tout - t < 1e-12*tout)
+          t = tout;
+      }
+
+      h *= err > 0.0 ? fmin(5.0, fmax(0.2, 0.9*pow(err, -0.2))) : 5.0;
+      if(h > hmax)
+        h = hmax;
+    }
+
+    if((ret = row(arg, tout, y)))
+      goto done;
+  }
+
+done:
+  free(work);
+  return ret;
+}
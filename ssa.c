@@ -0,0 +1,427 @@
+/* ssa.c
+ *
+ * Stochastic simulation of a compiled network (see network.h) by Gillespie's
+ * algorithm, in the next reaction form of Gibson and Bruck: each reaction
+ * keeps the time it next fires, in an indexed heap, and an event recomputes
+ * only the propensities of the reactions whose laws read a species it
+ * changed. Those are found from the laws' compiled code, so for the networks
+ * nemo2sbml writes they are the regulation edges: the synthesis of each gene
+ * the protein regulates, and its own degradation.
+ *
+ * The state is in molecules, omega of them to a unit of concentration, and
+ * the propensity of a reaction is omega times its kinetic law at the
+ * concentrations. A law that goes negative, as the net reactions of -n do
+ * when degradation wins, fires its reaction backwards.
+ *
+ * Trajectories run on a pool of threads. Trajectory k draws its random
+ * numbers from a splitmix64 stream seeded by hashing (seed, k), and they are
+ * reported strictly in order, so the output does not depend on the number of
+ * threads, and any one trajectory can be run again alone.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "network.h"
+
+#define SSA_MAX_EVENTS 100000000 /* of a trajectory, past which it is taken to have blown up */
+
+typedef struct
+{
+  const NETWORK  *net;
+  const double   *param;
+  int             runs, nout;
+  double          tEnd, dt, omega;
+  unsigned long long seed;
+  NETSSAROW       row;
+  void           *arg;
+
+  int            *depOff;   /* firing reaction r changes the propensities of deps[depOff[r]] .. deps[depOff[r+1]-1] */
+  int            *deps;
+
+  int             next;     /* next trajectory to run */
+  int             merged;   /* trajectories reported so far, in order */
+  int             failed;
+  int             err;
+  pthread_mutex_t lock;
+  pthread_cond_t  done;
+} SSA;
+
+/* a trajectory's state, one to a thread */
+typedef struct
+{
+  SSA      *ssa;
+  unsigned long long rng;
+  double   *x, *y;          /* molecules, and concentrations for the laws */
+  double   *a, *tNext;      /* propensity and next firing time of each reaction */
+  signed char *dir;         /* the way each reaction fires, -1 if its law is negative */
+  int      *heap, *pos;     /* reactions by tNext, and the place of each in heap */
+  double   *stack;
+  double   *traj;           /* nout rows of nspecies */
+  int       rows;
+} SSATHREAD;
+
+static int ssa_deps(SSA *);
+static int ssa_run(SSATHREAD *, int);
+static int ssa_propensity(SSATHREAD *, int, double);
+static void heap_down(SSATHREAD *, int);
+static void heap_up(SSATHREAD *, int);
+static void heap_swap(SSATHREAD *, int, int);
+static double ssa_exp(SSATHREAD *);
+static unsigned long long splitmix(unsigned long long *);
+static void * ssa_worker(void *);
+
+/* the dependency graph: for each reaction, the reactions reading a species it changes, itself included */
+static int ssa_deps(SSA *ssa)
+{
+  const NETWORK *net = ssa->net;
+  int i, j, k, n, r, s, *readOff, *readers, *mark;
+  const NETOP *op;
+
+  readOff = (int *) calloc(net->nspecies+2, sizeof(int));
+  mark    = (int *) malloc((net->nreactions+net->nspecies+1)*sizeof(int));
+  if(!readOff || !mark)
+  {
+    free(readOff); free(mark);
+    return 0;
+  }
+
+  /* the readers of each species, each reaction once */
+  for(s=0; s<net->nspecies; s++)
+    mark[s] = -1;
+  for(r=0; r<net->nreactions; r++)
+    for(op = net->code + net->code_off[r]; op < net->code + net->code_off[r+1]; op++)
+      if(op->op == OP_SPECIES && mark[op->arg] != r)
+      {
+        mark[op->arg] = r;
+        readOff[op->arg+2]++;
+      }
+  for(s=0; s<net->nspecies; s++)
+    readOff[s+2] += readOff[s+1];
+  readers = (int *) malloc((readOff[net->nspecies+1]+1)*sizeof(int));
+  if(!readers)
+  {
+    free(readOff); free(mark);
+    return 0;
+  }
+  for(s=0; s<net->nspecies; s++)
+    mark[s] = -1;
+  for(r=0; r<net->nreactions; r++)
+    for(op = net->code + net->code_off[r]; op < net->code + net->code_off[r+1]; op++)
+      if(op->op == OP_SPECIES && mark[op->arg] != r)
+      {
+        mark[op->arg] = r;
+        readers[readOff[op->arg+1]++] = r;
+      }
+
+  /* then the reactions each reaction's firing reaches; counted, then filled */
+  ssa->depOff = (int *) calloc(net->nreactions+1, sizeof(int));
+  if(!ssa->depOff)
+  {
+    free(readOff); free(readers); free(mark);
+    return 0;
+  }
+  for(k=0; k<2; k++)
+  {
+    for(r=0; r<net->nreactions; r++)
+      mark[r] = -1;
+    for(r=n=0; r<net->nreactions; r++)
+    {
+      if(k)
+        ssa->deps[n] = r;
+      n++;
+      mark[r] = r;
+      for(i=net->st_off[r]; i<net->st_off[r+1]; i++)
+      {
+        s = net->st_species[i];
+        if(net->fixed[s])
+          continue;
+        for(j=readOff[s]; j<readOff[s+1]; j++)
+          if(mark[readers[j]] != r)
+          {
+            mark[readers[j]] = r;
+            if(k)
+              ssa->deps[n] = readers[j];
+            n++;
+          }
+      }
+      if(!k)
+        ssa->depOff[r+1] = n;
+    }
+    if(!k && !(ssa->deps = (int *) malloc((n+1)*sizeof(int))))
+    {
+      free(readOff); free(readers); free(mark); free(ssa->depOff);
+      return 0;
+    }
+  }
+
+  free(readOff); free(readers); free(mark);
+  return 1;
+}
+
+/* reaction r's propensity, at the state at time t; return 0 if its law is not finite */
+static int ssa_propensity(SSATHREAD *th, int r, double t)
+{
+  double v;
+  SSA *ssa = th->ssa;
+
+  v = net_rate(ssa->net, r, ssa->param, t, th->y, th->stack);
+  if(!isfinite(v))
+    return 0;
+  th->dir[r] = v < 0.0 ? -1 : 1;
+  th->a[r]   = ssa->omega*fabs(v);
+  return 1;
+}
+
+/* run trajectory k into th->traj, return 0 if it stopped early */
+static int ssa_run(SSATHREAD *th, int k)
+{
+  int i, j, mu, r, s;
+  long events;
+  double aOld, t, tn;
+  unsigned long long seed;
+  SSA *ssa = th->ssa;
+  const NETWORK *net = ssa->net;
+
+  seed = ssa->seed ^ (unsigned long long)k * 0x9e3779b97f4a7c15ULL;
+  th->rng = splitmix(&seed);
+
+  for(s=0; s<net->nspecies; s++)
+  {
+    th->x[s] = floor(net->init[s]*ssa->omega + 0.5);
+    th->y[s] = th->x[s]/ssa->omega;
+  }
+
+  t = 0.0;
+  for(r=0; r<net->nreactions; r++)
+  {
+    if(!ssa_propensity(th, r, t))
+      return 0;
+    th->tNext[r] = th->a[r] > 0.0 ? t + ssa_exp(th)/th->a[r] : INFINITY;
+    th->heap[r]  = r;
+    th->pos[r]   = r;
+  }
+  for(i=net->nreactions/2-1; i>=0; i--)
+    heap_down(th, i);
+
+  th->rows = 0;
+  for(events=0; ; events++)
+  {
+    /* the state holds until the next event; report the output times before it */
+    tn = net->nreactions ? th->tNext[th->heap[0]] : INFINITY;
+    while(th->rows < ssa->nout && th->rows*ssa->dt < tn)
+    {
+      for(s=0; s<net->nspecies; s++)
+        th->traj[(size_t)th->rows*net->nspecies + s] = th->x[s];
+      th->rows++;
+    }
+    if(th->rows == ssa->nout)
+      return 1;
+    if(events == SSA_MAX_EVENTS)
+      return 0;
+
+    /* fire the first reaction, and move the times of those it reaches */
+    t  = tn;
+    mu = th->heap[0];
+    for(i=net->st_off[mu]; i<net->st_off[mu+1]; i++)
+    {
+      s = net->st_species[i];
+      if(!net->fixed[s])
+      {
+        th->x[s] += th->dir[mu]*net->st_coef[i];
+        th->y[s]  = th->x[s]/ssa->omega;
+      }
+    }
+
+    for(j=ssa->depOff[mu]; j<ssa->depOff[mu+1]; j++)
+    {
+      r = ssa->deps[j];
+      aOld = th->a[r];
+      if(!ssa_propensity(th, r, t))
+        return 0;
+      if(th->a[r] <= 0.0)
+        th->tNext[r] = INFINITY;
+      else if(r != mu && aOld > 0.0)
+        th->tNext[r] = t + aOld/th->a[r]*(th->tNext[r] - t); /* the same exponential, rescaled */
+      else
+        th->tNext[r] = t + ssa_exp(th)/th->a[r];
+      heap_up(th, th->pos[r]);
+      heap_down(th, th->pos[r]);
+    }
+  }
+}
+
+static void heap_swap(SSATHREAD *th, int i, int j)
+{
+  int r = th->heap[i];
+
+  th->heap[i] = th->heap[j];
+  th->heap[j] = r;
+  th->pos[th->heap[i]] = i;
+  th->pos[th->heap[j]] = j;
+}
+
+static void heap_up(SSATHREAD *th, int i)
+{
+  while(i > 0 && th->tNext[th->heap[i]] < th->tNext[th->heap[(i-1)/2]])
+  {
+    heap_swap(th, i, (i-1)/2);
+    i = (i-1)/2;
+  }
+}
+
+static void heap_down(SSATHREAD *th, int i)
+{
+  int c, n = th->ssa->net->nreactions;
+
+  while((c = 2*i+1) < n)
+  {
+    if(c+1 < n && th->tNext[th->heap[c+1]] < th->tNext[th->heap[c]])
+      c++;
+    if(th->tNext[th->heap[c]] >= th->tNext[th->heap[i]])
+      break;
+    heap_swap(th, i, c);
+    i = c;
+  }
+}
+
+/* a standard exponential random number */
+static double ssa_exp(SSATHREAD *th)
+{
+  return -log(1.0 - (splitmix(&th->rng) >> 11) * (1.0/9007199254740992.0));
+}
+
+/* the next number of the splitmix64 stream at *state */
+static unsigned long long splitmix(unsigned long long *state)
+{
+  unsigned long long z = (*state += 0x9e3779b97f4a7c15ULL);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/*
+ Take trajectories in turn, run each, and report its rows strictly in
+ trajectory order, as net_ensemble() merges its samples.
+*/
+static void * ssa_worker(void *arg)
+{
+  int i, k, ok, ret;
+  SSA *ssa = (SSA *) arg;
+  const NETWORK *net = ssa->net;
+  SSATHREAD th;
+
+  th.ssa   = ssa;
+  th.x     = (double *) malloc((net->nspecies+1)*sizeof(double));
+  th.y     = (double *) malloc((net->nspecies+1)*sizeof(double));
+  th.a     = (double *) malloc((net->nreactions+1)*sizeof(double));
+  th.tNext = (double *) malloc((net->nreactions+1)*sizeof(double));
+  th.dir   = (signed char *) malloc(net->nreactions+1);
+  th.heap  = (int *) malloc((net->nreactions+1)*sizeof(int));
+  th.pos   = (int *) malloc((net->nreactions+1)*sizeof(int));
+  th.stack = (double *) malloc((net->maxstack+1)*sizeof(double));
+  th.traj  = (double *) malloc(((size_t)ssa->nout*net->nspecies+1)*sizeof(double));
+
+  if(!th.x || !th.y || !th.a || !th.tNext || !th.dir || !th.heap || !th.pos || !th.stack || !th.traj)
+  {
+    fprintf(stderr, "net_ssa: malloc error, returning...\n");
+    pthread_mutex_lock(&ssa->lock);
+    ssa->err = -1;
+    pthread_cond_broadcast(&ssa->done);
+    pthread_mutex_unlock(&ssa->lock);
+    goto done;
+  }
+
+  for(;;)
+  {
+    pthread_mutex_lock(&ssa->lock);
+    k = ssa->err ? ssa->runs : ssa->next++;
+    pthread_mutex_unlock(&ssa->lock);
+    if(k >= ssa->runs)
+      break;
+
+    ok = ssa_run(&th, k);
+
+    pthread_mutex_lock(&ssa->lock);
+    while(ssa->merged != k && !ssa->err)
+      pthread_cond_wait(&ssa->done, &ssa->lock);
+    if(!ok)
+      ssa->failed++;
+    for(i=0; ok && !ssa->err && i<ssa->nout; i++)
+      if((ret = ssa->row(ssa->arg, k, i*ssa->dt, th.traj + (size_t)i*net->nspecies)))
+        ssa->err = ret;
+    ssa->merged++;
+    pthread_cond_broadcast(&ssa->done);
+    pthread_mutex_unlock(&ssa->lock);
+  }
+
+done:
+  free(th.x); free(th.y); free(th.a); free(th.tNext); free(th.dir);
+  free(th.heap); free(th.pos); free(th.stack); free(th.traj);
+  return NULL;
+}
+
+/*
+ Run runs stochastic trajectories of net, with parameter values param, from
+ t = 0 to tEnd, omega molecules to a unit of concentration, on nthreads
+ threads. row(arg, k, t, x) gets the molecules of each species of trajectory
+ k at t = 0, dt, 2dt, ..., trajectory by trajectory in order; a trajectory
+ whose propensities stop being finite, or that takes more than
+ SSA_MAX_EVENTS events, is left out and counted in *failed.
+ Returns 0 on success, -1 on error, and row's return value if that is
+ non-zero.
+*/
+int net_ssa(const NETWORK *net, const double *param, int runs, int nthreads, double tEnd, double dt,
+            double omega, long seed, NETSSAROW row, void *arg, int *failed)
+{
+  int i, nt;
+  SSA ssa;
+  pthread_t *tid;
+
+  ssa.net    = net;
+  ssa.param  = param;
+  ssa.runs   = runs;
+  ssa.nout   = (int) floor(tEnd/dt + 1e-9) + 1;
+  ssa.tEnd   = tEnd;
+  ssa.dt     = dt;
+  ssa.omega  = omega;
+  ssa.seed   = (unsigned long long) seed;
+  ssa.row    = row;
+  ssa.arg    = arg;
+  ssa.next = ssa.merged = ssa.failed = ssa.err = 0;
+
+  tid = (pthread_t *) malloc(nthreads*sizeof(pthread_t));
+  if(!tid || !ssa_deps(&ssa))
+  {
+    fprintf(stderr, "net_ssa: malloc error, returning...\n");
+    free(tid);
+    return -1;
+  }
+  pthread_mutex_init(&ssa.lock, NULL);
+  pthread_cond_init(&ssa.done, NULL);
+
+  if(nthreads > runs)
+    nthreads = runs;
+
+  /* this thread is one of the pool */
+  for(nt=0; nt<nthreads-1; nt++)
+    if(pthread_create(&tid[nt], NULL, ssa_worker, &ssa))
+      break;
+  ssa_worker(&ssa);
+  for(i=0; i<nt; i++)
+    pthread_join(tid[i], NULL);
+
+  pthread_cond_destroy(&ssa.done);
+  pthread_mutex_destroy(&ssa.lock);
+  free(tid); free(ssa.depOff); free(ssa.deps);
+
+  *failed = ssa.failed;
+  return ssa.err;
+}
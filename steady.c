@@ -0,0 +1,559 @@
+/* steady.c
+ *
+ * Steady states of a compiled network (see network.h): damped Newton on
+ * dy/dt = 0, with the Jacobian built column by column over the regulation
+ * structure (a species' column only has the reactions whose laws read it)
+ * and factored by a sparse LU. If Newton does not converge from the initial
+ * state, the network is integrated for a while and Newton tried again from
+ * there.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "network.h"
+
+#define FTOL        1e-9  /* converged when every |dy/dt| <= FTOL */
+#define MAXIT       50    /* Newton iterations per try */
+#define MINLAMBDA   1e-4  /* smallest damping of a Newton step */
+#define PIVTOL      0.1   /* keep the diagonal pivot if within this of the largest */
+
+/* sparse LU of a square matrix in compressed columns, L*U = P*A*Q */
+typedef struct
+{
+  int     n;
+  int    *Lp, *Li, *Up, *Ui; /* L unit lower, diagonal first in each column; U diagonal last */
+  double *Lx, *Ux;
+  int     Lsz, Usz;
+  int    *pinv;              /* row i of A is row pinv[i] of L*U */
+  int    *q;                 /* column k of L*U is column q[k] of A */
+  int    *xi, *stack, *pstack, *mark;
+  double *x;
+} SPLU;
+
+/* the Jacobian's pattern and values, and what building it needs */
+typedef struct
+{
+  const NETWORK *net;
+  const HILLSET *hs;
+  const double  *param;
+  int            n;
+  char          *inert;      /* species nothing changes: fixed, or in no reaction */
+  int           *rs_off, *rs; /* the reactions reading species j are rs[rs_off[j]] .. rs[rs_off[j+1]-1] */
+  int           *Ap, *Ai;
+  double        *Ax;
+  int            Asz;
+  double        *v, *dydt, *acc, *work, *dy, *ytry, *ftry, *ysave;
+  int           *seen;
+  SPLU           lu;
+} STEADY;
+
+static int grow(int **, double **, int *, int);
+static int splu_init(SPLU *, int);
+static void splu_free(SPLU *);
+static int splu_reach(SPLU *, const int *, const int *, int, int);
+static int splu_factor(SPLU *, const int *, const int *, const double *);
+static void splu_solve(const SPLU *, const double *, double *, double *);
+static int st_init(STEADY *, const NETWORK *, const HILLSET *, const double *);
+static void st_free(STEADY *);
+static int st_jacobian(STEADY *, double *);
+static double st_resid(STEADY *, const double *, double *, double *);
+static int st_newton(STEADY *, double *, int *, double *);
+static int st_row(void *, double, const double *);
+
+/* make room for need entries in the index and value arrays *i, *x of size *sz */
+static int grow(int **i, double **x, int *sz, int need)
+{
+  void *t;
+
+  if(need <= *sz)
+    return 1;
+
+  *sz = 2*(*sz) + need;
+  if(!(t = realloc(*i, *sz*sizeof(int))))
+    return 0;
+  *i = t;
+  if(!(t = realloc(*x, *sz*sizeof(double))))
+    return 0;
+  *x = t;
+  return 1;
+}
+
+static int splu_init(SPLU *lu, int n)
+{
+  memset(lu, 0, sizeof(SPLU));
+  lu->n      = n;
+  lu->Lsz    = lu->Usz = 4*n + 16;
+  lu->Lp     = (int *) malloc((n+1)*sizeof(int));
+  lu->Up     = (int *) malloc((n+1)*sizeof(int));
+  lu->Li     = (int *) malloc(lu->Lsz*sizeof(int));
+  lu->Ui     = (int *) malloc(lu->Usz*sizeof(int));
+  lu->Lx     = (double *) malloc(lu->Lsz*sizeof(double));
+  lu->Ux     = (double *) malloc(lu->Usz*sizeof(double));
+  lu->pinv   = (int *) malloc((n+1)*sizeof(int));
+  lu->q      = (int *) malloc((n+1)*sizeof(int));
+  lu->xi     = (int *) malloc((n+1)*sizeof(int));
+  lu->stack  = (int *) malloc((n+1)*sizeof(int));
+  lu->pstack = (int *) malloc((n+1)*sizeof(int));
+  lu->mark   = (int *) calloc(n+1, sizeof(int));
+  lu->x      = (double *) malloc((n+1)*sizeof(double));
+
+  return lu->Lp && lu->Up && lu->Li && lu->Ui && lu->Lx && lu->Ux && lu->pinv && lu->q &&
+         lu->xi && lu->stack && lu->pstack && lu->mark && lu->x;
+}
+
+static void splu_free(SPLU *lu)
+{
+  free(lu->Lp); free(lu->Li); free(lu->Lx);
+  free(lu->Up); free(lu->Ui); free(lu->Ux);
+  free(lu->pinv); free(lu->q);
+  free(lu->xi); free(lu->stack); free(lu->pstack); free(lu->mark); free(lu->x);
+}
+
+/*
+ The rows of L*U column k that are non-zero, given the pattern of column col
+ of A: the rows reachable from A's through the columns of L done so far, into
+ lu->xi[top .. n-1] in topological order. Returns top.
+*/
+static int splu_reach(SPLU *lu, const int *Ap, const int *Ai, int col, int k)
+{
+  int done, head, i, j, J, p, end, top = lu->n;
+
+  for(p=Ap[col]; p<Ap[col+1]; p++)
+  {
+    if(lu->mark[Ai[p]] == k+1)
+      continue;
+
+    /* depth first from Ai[p] */
+    head = 0;
+    lu->stack[0] = Ai[p];
+    while(head >= 0)
+    {
+      j = lu->stack[head];
+      J = lu->pinv[j];
+      if(lu->mark[j] != k+1)
+      {
+        lu->mark[j] = k+1;
+        lu->pstack[head] = J < 0 ? 0 : lu->Lp[J]+1; /* past the diagonal */
+      }
+
+      done = 1;
+      end  = J < 0 ? 0 : lu->Lp[J+1];
+      for(i=lu->pstack[head]; i<end; i++)
+      {
+        if(lu->mark[lu->Li[i]] == k+1)
+          continue;
+        lu->pstack[head] = i+1;
+        lu->stack[++head] = lu->Li[i];
+        done = 0;
+        break;
+      }
+
+      if(done)
+      {
+        head--;
+        lu->xi[--top] = j;
+      }
+    }
+  }
+
+  return top;
+}
+
+/*
+ Left-looking LU with threshold partial pivoting (Gilbert-Peierls) of the
+ n x n matrix Ap, Ai, Ax (compressed columns, each with its diagonal), in the
+ column order lu->q. Returns 0 if the matrix is singular or out of memory.
+*/
+static int splu_factor(SPLU *lu, const int *Ap, const int *Ai, const double *Ax)
+{
+  int col, i, ipiv, j, J, k, lnz=0, n = lu->n, p, pp, top, unz=0;
+  double amax, pivot, *x = lu->x;
+
+  for(i=0; i<n; i++)
+  {
+    lu->pinv[i] = -1;
+    lu->mark[i] = 0;
+  }
+
+  for(k=0; k<n; k++)
+  {
+    lu->Lp[k] = lnz;
+    lu->Up[k] = unz;
+
+    if(!grow(&lu->Li, &lu->Lx, &lu->Lsz, lnz+n) || !grow(&lu->Ui, &lu->Ux, &lu->Usz, unz+n))
+      return 0;
+
+    /* x = L \ A(:,col) */
+    col = lu->q[k];
+    top = splu_reach(lu, Ap, Ai, col, k);
+    for(p=top; p<n; p++)
+      x[lu->xi[p]] = 0.0;
+    for(p=Ap[col]; p<Ap[col+1]; p++)
+      x[Ai[p]] = Ax[p];
+
+    for(p=top; p<n; p++)
+    {
+      j = lu->xi[p];
+      if((J = lu->pinv[j]) < 0)
+        continue;
+      for(pp=lu->Lp[J]+1; pp<lu->Lp[J+1]; pp++)
+        x[lu->Li[pp]] -= lu->Lx[pp]*x[j];
+    }
+
+    /* the pivot, the diagonal if it is big enough */
+    ipiv = -1;
+    amax = 0.0;
+    for(p=top; p<n; p++)
+    {
+      i = lu->xi[p];
+      if(lu->pinv[i] < 0)
+      {
+        if(fabs(x[i]) > amax)
+        {
+          amax = fabs(x[i]);
+          ipiv = i;
+        }
+      }
+      else
+      {
+        lu->Ui[unz]   = lu->pinv[i];
+        lu->Ux[unz++] = x[i];
+      }
+    }
+    if(ipiv < 0 || !isfinite(amax))
+      return 0;
+    if(lu->pinv[col] < 0 && fabs(x[col]) >= PIVTOL*amax)
+      ipiv = col;
+
+    pivot = x[ipiv];
+    lu->Ui[unz]   = k;
+    lu->Ux[unz++] = pivot;
+    lu->pinv[ipiv] = k;
+    lu->Li[lnz]   = ipiv;
+    lu->Lx[lnz++] = 1.0;
+    for(p=top; p<n; p++)
+    {
+      i = lu->xi[p];
+      if(lu->pinv[i] < 0)
+      {
+        lu->Li[lnz]   = i;
+        lu->Lx[lnz++] = x[i]/pivot;
+      }
+    }
+  }
+
+  lu->Lp[n] = lnz;
+  lu->Up[n] = unz;
+  for(p=0; p<lnz; p++)
+    lu->Li[p] = lu->pinv[lu->Li[p]];
+  return 1;
+}
+
+/* x = A \ b, w is n doubles of work space */
+static void splu_solve(const SPLU *lu, const double *b, double *x, double *w)
+{
+  int i, k, p;
+
+  for(i=0; i<lu->n; i++)
+    w[lu->pinv[i]] = b[i];
+
+  for(k=0; k<lu->n; k++)
+    for(p=lu->Lp[k]+1; p<lu->Lp[k+1]; p++)
+      w[lu->Li[p]] -= lu->Lx[p]*w[k];
+
+  for(k=lu->n-1; k>=0; k--)
+  {
+    w[k] /= lu->Ux[lu->Up[k+1]-1];
+    for(p=lu->Up[k]; p<lu->Up[k+1]-1; p++)
+      w[lu->Ui[p]] -= lu->Ux[p]*w[k];
+  }
+
+  for(k=0; k<lu->n; k++)
+    x[lu->q[k]] = w[k];
+}
+
+/* which reactions read which species, and a column order: the sparsest columns first */
+static int st_init(STEADY *st, const NETWORK *net, const HILLSET *hs, const double *param)
+{
+  int i, j, k, n = net->nspecies, nr = net->nreactions, p, r, *cnt;
+  const NETOP *op;
+
+  memset(st, 0, sizeof(STEADY));
+  st->net   = net;
+  st->hs    = hs;
+  st->param = param;
+  st->n     = n;
+  st->Asz   = 4*n + 16;
+
+  st->inert  = (char *) malloc(n+1);
+  st->rs_off = (int *) calloc(n+2, sizeof(int));
+  st->Ap     = (int *) malloc((n+1)*sizeof(int));
+  st->Ai     = (int *) malloc(st->Asz*sizeof(int));
+  st->Ax     = (double *) malloc(st->Asz*sizeof(double));
+  st->v      = (double *) malloc((nr+1)*sizeof(double));
+  st->dydt   = (double *) malloc((n+1)*sizeof(double));
+  st->acc    = (double *) calloc(n+1, sizeof(double));
+  st->dy     = (double *) malloc((n+1)*sizeof(double));
+  st->ytry   = (double *) malloc((n+1)*sizeof(double));
+  st->ftry   = (double *) malloc((n+1)*sizeof(double));
+  st->ysave  = (double *) malloc((n+1)*sizeof(double));
+  st->work   = (double *) malloc((net->worksz + n + 1)*sizeof(double));
+  st->seen   = (int *) malloc((n+1)*sizeof(int));
+  cnt        = (int *) calloc(n+2, sizeof(int));
+  if(!splu_init(&st->lu, n) || !st->inert || !st->rs_off || !st->Ap || !st->Ai || !st->Ax || !st->v ||
+     !st->dydt || !st->acc || !st->dy || !st->ytry || !st->ftry || !st->ysave || !st->work || !st->seen || !cnt)
+  {
+    free(cnt);
+    return 0;
+  }
+
+  for(i=0; i<n; i++)
+  {
+    st->inert[i] = 1;
+    st->seen[i]  = -1;
+  }
+  for(p=0; p<net->st_off[nr]; p++)
+    if(!net->fixed[net->st_species[p]])
+      st->inert[net->st_species[p]] = 0;
+
+  /* the species each law reads, counted once a reaction (seen[] holds the last reaction) */
+  for(k=0; k<2; k++)
+  {
+    for(i=0; i<n; i++)
+      st->seen[i] = -1;
+    for(r=0; r<nr; r++)
+    {
+      for(op=net->code+net->code_off[r]; op<net->code+net->code_off[r+1]; op++)
+      {
+        if(op->op != OP_SPECIES || st->seen[op->arg] == r)
+          continue;
+        st->seen[op->arg] = r;
+        if(k == 0)
+          st->rs_off[op->arg+1]++;
+        else
+          st->rs[st->rs_off[op->arg] + cnt[op->arg]++] = r;
+      }
+    }
+    if(k == 0)
+    {
+      for(i=0; i<n; i++)
+        st->rs_off[i+1] += st->rs_off[i];
+      if(!(st->rs = (int *) malloc((st->rs_off[n]+1)*sizeof(int))))
+      {
+        free(cnt);
+        return 0;
+      }
+    }
+  }
+
+  /* columns by how many reactions read them, a cheap fill reducing order */
+  memset(cnt, 0, (n+2)*sizeof(int));
+  for(j=0; j<n; j++)
+  {
+    k = st->rs_off[j+1] - st->rs_off[j];
+    cnt[(k < n ? k : n-1) + 1]++;
+  }
+  for(i=0; i<n; i++)
+    cnt[i+1] += cnt[i];
+  for(j=0; j<n; j++)
+  {
+    k = st->rs_off[j+1] - st->rs_off[j];
+    st->lu.q[cnt[k < n ? k : n-1]++] = j;
+  }
+
+  free(cnt);
+  return 1;
+}
+
+static void st_free(STEADY *st)
+{
+  splu_free(&st->lu);
+  free(st->inert); free(st->rs_off); free(st->rs);
+  free(st->Ap); free(st->Ai); free(st->Ax);
+  free(st->v); free(st->dydt); free(st->acc); free(st->dy);
+  free(st->ytry); free(st->ftry); free(st->ysave); free(st->work); free(st->seen);
+}
+
+/*
+ The Jacobian of dy/dt at y into Ap, Ai, Ax, by forward differences of the
+ laws that read each species; an inert species' row and column are the
+ identity, so its value stays put.
+*/
+static int st_jacobian(STEADY *st, double *y)
+{
+  const NETWORK *net = st->net;
+  int i, j, nz=0, p, r, s;
+  double dv, h, yj;
+
+  for(r=0; r<net->nreactions; r++)
+    st->v[r] = net_rate(net, r, st->param, 0.0, y, st->work);
+  for(i=0; i<st->n; i++)
+    st->seen[i] = -1;
+
+  for(j=0; j<st->n; j++)
+  {
+    st->Ap[j] = nz;
+    if(!grow(&st->Ai, &st->Ax, &st->Asz, nz + st->n + 1))
+      return 0;
+
+    /* the diagonal is always there, for the pivoting */
+    st->seen[j]  = j;
+    st->acc[j]   = st->inert[j] ? 1.0 : 0.0;
+    st->Ai[nz++] = j;
+
+    if(!st->inert[j])
+    {
+      yj = y[j];
+      h  = 1e-7*(fabs(yj) > 1e-3 ? fabs(yj) : 1e-3);
+      y[j] = yj + h;
+      for(p=st->rs_off[j]; p<st->rs_off[j+1]; p++)
+      {
+        r  = st->rs[p];
+        dv = (net_rate(net, r, st->param, 0.0, y, st->work) - st->v[r])/h;
+        for(s=net->st_off[r]; s<net->st_off[r+1]; s++)
+        {
+          i = net->st_species[s];
+          if(st->inert[i])
+            continue;
+          if(st->seen[i] != j)
+          {
+            st->seen[i]  = j;
+            st->acc[i]   = 0.0;
+            st->Ai[nz++] = i;
+          }
+          st->acc[i] += net->st_coef[s]*dv;
+        }
+      }
+      y[j] = yj;
+    }
+
+    for(p=st->Ap[j]; p<nz; p++)
+      st->Ax[p] = st->acc[st->Ai[p]];
+  }
+  st->Ap[st->n] = nz;
+  return 1;
+}
+
+/*
+ dy/dt at y into f, and max |dy/dt| into *max; returns the 2-norm, which the
+ line search reduces. The rates come from net_rate(), as the Jacobian's do,
+ so the Newton step is taken on the function it was linearized from.
+*/
+static double st_resid(STEADY *st, const double *y, double *f, double *max)
+{
+  int i;
+  double ss = 0.0;
+
+  net_deriv(st->net, NULL, st->param, 0.0, y, st->v, f, st->work);
+  *max = 0.0;
+  for(i=0; i<st->n; i++)
+  {
+    if(!isfinite(f[i]))
+      return *max = HUGE_VAL;
+    if(fabs(f[i]) > *max)
+      *max = fabs(f[i]);
+    ss += f[i]*f[i];
+  }
+  return sqrt(ss);
+}
+
+/*
+ Damped Newton from y: each step is cut in half until it reduces |dy/dt|,
+ and concentrations are kept >= 0. Returns 1 if it converged, y then the
+ steady state; *it gets the iterations, *res the max |dy/dt| at y.
+*/
+static int st_newton(STEADY *st, double *y, int *it, double *res)
+{
+  int i, n = st->n;
+  double lambda, max, mtry, norm, ntry, *tmp;
+
+  norm = st_resid(st, y, st->dydt, &max);
+  for(*it=0; *it<MAXIT && max > FTOL; ++*it)
+  {
+    if(!st_jacobian(st, y) || !splu_factor(&st->lu, st->Ap, st->Ai, st->Ax))
+      break;
+    for(i=0; i<n; i++)
+      st->ftry[i] = -st->dydt[i];
+    splu_solve(&st->lu, st->ftry, st->dy, st->work);
+
+    for(lambda=1.0; lambda>=MINLAMBDA; lambda*=0.5)
+    {
+      for(i=0; i<n; i++)
+      {
+        st->ytry[i] = y[i] + lambda*st->dy[i];
+        if(st->ytry[i] < 0.0)
+          st->ytry[i] = 0.0;
+      }
+      ntry = st_resid(st, st->ytry, st->ftry, &mtry);
+      if(ntry < (1.0 - 1e-4*lambda)*norm)
+        break;
+    }
+    if(lambda < MINLAMBDA)
+      break;
+
+    norm = ntry;
+    max  = mtry;
+    memcpy(y, st->ytry, n*sizeof(double));
+    tmp = st->dydt; st->dydt = st->ftry; st->ftry = tmp;
+  }
+
+  *res = max;
+  return max <= FTOL;
+}
+
+/* keep the last state of an integration, see net_steady() */
+static int st_row(void *arg, double t, const double *y)
+{
+  STEADY *st = (STEADY *) arg;
+
+  memcpy(st->ysave, y, st->n*sizeof(double));
+  return 0;
+}
+
+/*
+ A steady state of net with parameter values param, into y (nspecies); the
+ integrations use the Hill laws hs, see net_deriv(). Newton is tried from the initial state,
+ then from the state the network reaches by t = 10^3, 10^4 and 10^5.
+ *info gets how it went. Returns 0 if a steady state was found, 1 if not,
+ -1 on error.
+*/
+int net_steady(const NETWORK *net, const HILLSET *hs, const double *param, double *y, NETSTEADY *info)
+{
+  int it;
+  double res, tEnd;
+  STEADY st;
+
+  memset(info, 0, sizeof(NETSTEADY));
+  if(!st_init(&st, net, hs, param))
+  {
+    fprintf(stderr, "net_steady: malloc error, returning...\n");
+    st_free(&st);
+    return -1;
+  }
+
+  memcpy(y, net->init, net->nspecies*sizeof(double));
+  info->converged = st_newton(&st, y, &it, &res);
+  info->iterations = it;
+  info->residual   = res;
+
+  for(tEnd=1e3; !info->converged && tEnd<=1e5; tEnd*=10)
+  {
+    if(net_simulate(net, hs, param, tEnd, tEnd, st_row, &st))
+      break;
+    memcpy(y, st.ysave, net->nspecies*sizeof(double));
+    info->tIntegrated = tEnd;
+    info->converged   = st_newton(&st, y, &it, &res);
+    info->iterations += it;
+    info->residual    = res;
+  }
+
+  st_free(&st);
+  return !info->converged;
+}
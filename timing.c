@@ -0,0 +1,118 @@
+/* timing.c
+ *
+ * Per-phase wall time and call counts of nemo2sbml, for -T; see timing.h.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "timing.h"
+
+#define T_DEPTH 16 /* phases running at once, deeper ones are still counted */
+
+int timing=0; /* -T; the state below is process-wide, so nemo_compile() leaves it alone */
+
+static const char *phaseName[T_PHASES] = {"lex", "genes", "parse", "check_dor", "hill", "hill_formula",
+                                          "sbml_model", "write_sbml", "analysis", "xgmml"};
+static double seconds[T_PHASES];
+static long calls[T_PHASES];
+static int stack[T_DEPTH], depth=0;
+static size_t bytes=0;
+static pthread_mutex_t bytesLock = PTHREAD_MUTEX_INITIALIZER; /* the -K variants are written on several threads */
+static struct timespec last;
+
+/* charge the time since the last switch to the running phase */
+static void tm_charge(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if(depth > 0 && depth <= T_DEPTH)
+    seconds[stack[depth-1]] += (now.tv_sec - last.tv_sec) + 1e-9*(now.tv_nsec - last.tv_nsec);
+  last = now;
+}
+
+/* start phase, pausing the one running until tm_leave() */
+void tm_enter(int phase)
+{
+  if(!timing) return;
+
+  tm_charge();
+  if(depth < T_DEPTH)
+    stack[depth] = phase;
+  depth++;
+  calls[phase]++;
+}
+
+/* end the phase last entered, resuming the one it paused */
+void tm_leave(void)
+{
+  if(!timing || depth == 0) return;
+
+  tm_charge();
+  depth--;
+}
+
+/* output written, uncompressed */
+void tm_bytes(size_t n)
+{
+  if(timing)
+  {
+    pthread_mutex_lock(&bytesLock);
+    bytes += n;
+    pthread_mutex_unlock(&bytesLock);
+  }
+}
+
+/* report network's phases on fp, in the -T format; id is its model id */
+void tm_report(FILE *fp, int network, char *id)
+{
+  int i;
+  double total=0.0;
+  long rss=0;
+  struct rusage usage;
+
+  tm_charge();
+  for(i=0; i<T_PHASES; i++)
+    total += seconds[i];
+  if(!getrusage(RUSAGE_SELF, &usage))
+    rss = usage.ru_maxrss;
+
+  if(timing == T_JSON)
+  {
+    fprintf(fp, "{\n  \"network\": %d,\n  \"id\": \"%s\",\n  \"phases\": {\n", network, id);
+    for(i=0; i<T_PHASES; i++)
+      fprintf(fp, "    \"%s\": {\"seconds\": %.6f, \"calls\": %ld}%s\n", phaseName[i], seconds[i], calls[i], i < T_PHASES-1 ? "," : "");
+    fprintf(fp, "  },\n  \"total_seconds\": %.6f,\n  \"peak_rss_kb\": %ld,\n  \"bytes_written\": %lu\n}\n", total, rss, (unsigned long)bytes);
+  }
+  else
+  {
+    fprintf(fp, "network %d (%s) timing:\n", network, id);
+    for(i=0; i<T_PHASES; i++)
+      fprintf(fp, "  %-14s %12.6f s %10ld calls\n", phaseName[i], seconds[i], calls[i]);
+    fprintf(fp, "  %-14s %12.6f s\n", "total", total);
+    fprintf(fp, "  peak RSS %ld kB, %lu bytes written\n", rss, (unsigned long)bytes);
+  }
+}
+
+/* start counting the next network; the phases still running count as called once */
+void tm_reset(void)
+{
+  int i;
+
+  tm_charge();
+  for(i=0; i<T_PHASES; i++)
+  {
+    seconds[i] = 0.0;
+    calls[i]   = 0;
+  }
+  for(i=0; i<depth && i<T_DEPTH; i++)
+    calls[stack[i]] = 1;
+  bytes = 0;
+}
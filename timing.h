@@ -0,0 +1,41 @@
+/* timing.h
+ *
+ * Per-phase wall time and call counts of nemo2sbml, for -T. A phase entered
+ * while another is running pauses it, so the times of the phases of a network
+ * add up to the time spent on it, each counted once.
+ *
+ * Copyright (C) 2007, University of Alaska Fairbanks
+ * Biotechnology Computing Research Group
+ * Author: James Long
+ * See nemo.y for the NEMO BSD and GPL licenses, which also cover this file.
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdio.h>
+
+#define T_LEX      0 /* the scanner, less the gene/protein checks */
+#define T_GENES    1 /* add_GENE(), add_PROTEIN(), proteinsOK() */
+#define T_PARSE    2 /* the grammar actions not in another phase */
+#define T_DOR      3 /* check_dor(), through the cache if there is one */
+#define T_HILL     4 /* randomGeneralizedHill(), queueing the laws */
+#define T_FORMULA  5 /* hill_formula() and insertNonLinearTerms(), on all threads */
+#define T_SBML     6 /* libsbml model construction */
+#define T_WRITE    7 /* writeSBML() */
+#define T_ANALYSIS 8 /* -S, -E, -G, -e and -J */
+#define T_XGMML    9
+#define T_PHASES  10
+
+#define T_TEXT     1 /* report formats, see -T */
+#define T_JSON     2
+
+extern int timing;
+
+void tm_enter(int);
+void tm_leave(void);
+void tm_bytes(size_t);
+void tm_report(FILE *, int, char *);
+void tm_reset(void);
+
+#endif